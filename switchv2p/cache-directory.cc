@@ -0,0 +1,67 @@
+#include "include/cache-directory.h"
+#include "include/hit-tag.h"
+#include "include/ip-utils.h"
+
+CacheDirectory::CacheDirectory (uint32_t podCount)
+    : m_podCount (podCount), m_bytes (0), m_peakBytes (0)
+{
+}
+
+void
+CacheDirectory::RecordResolution (uint32_t vip, Ipv4Address gateway, Ipv4Address source,
+                                  Ipv4Address destination, Ptr<const Packet> packet)
+{
+  Record (vip, GetLeaf (gateway));
+  Record (vip, GetLeaf (source));
+  Record (vip, GetLeaf (destination));
+  HitTag hitTag;
+  if (packet->PeekPacketTag (hitTag))
+    {
+      Record (vip, hitTag.GetAddress ());
+    }
+}
+
+void
+CacheDirectory::Record (uint32_t vip, Ipv4Address switchAddress)
+{
+  auto it = m_switches.find (vip);
+  if (it == m_switches.end ())
+    {
+      it = m_switches.emplace (vip, set<uint32_t> ()).first;
+      m_bytes += sizeof (uint32_t);
+    }
+  if (it->second.insert (switchAddress.Get ()).second)
+    {
+      m_bytes += sizeof (uint32_t);
+      m_peakBytes = std::max (m_peakBytes, m_bytes);
+    }
+}
+
+set<uint32_t>
+CacheDirectory::Take (uint32_t vip)
+{
+  auto it = m_switches.find (vip);
+  if (it == m_switches.end ())
+    {
+      return set<uint32_t> ();
+    }
+
+  set<uint32_t> switches = std::move (it->second);
+  m_switches.erase (it);
+  m_bytes -= sizeof (uint32_t) * (switches.size () + 1);
+  return switches;
+}
+
+uint64_t
+CacheDirectory::GetPeakBytes () const
+{
+  return m_peakBytes;
+}
+
+Ipv4Address
+CacheDirectory::GetLeaf (Ipv4Address host) const
+{
+  uint32_t podId = (host.Get () >> 24) - 1;
+  uint32_t leafOffset = (host.Get () >> 16) & 0xff;
+  return IpUtils::GetLeafAddress (m_podCount, podId, 0, leafOffset);
+}
@@ -0,0 +1,228 @@
+#include "include/cache-replay.h"
+#include "include/ip-utils.h"
+#include <sstream>
+
+NS_LOG_COMPONENT_DEFINE ("CacheReplay");
+
+const uint8_t CacheReplay::DEFAULT_TTL = 64;
+
+CacheReplay::CacheReplay (uint32_t podCount, uint32_t podWidth, uint32_t coreCount,
+                          bool randomRouting)
+    : m_podCount (podCount),
+      m_podWidth (podWidth),
+      m_coresPerSpine (coreCount / podWidth),
+      m_randomRouting (randomRouting),
+      m_draining (false),
+      m_random (CreateObject<UniformRandomVariable> ())
+{
+}
+
+void
+CacheReplay::AddSwitch (Ptr<P4SwitchApp> app, enum Tier tier, uint32_t index)
+{
+  vector<Ptr<P4SwitchApp>> &switches =
+      tier == LEAF ? m_leaves : (tier == SPINE ? m_spines : m_cores);
+  if (switches.size () <= index)
+    {
+      switches.resize (index + 1);
+    }
+  switches[index] = app;
+  Hop hop = {tier, index};
+  m_switchAddresses[GetAddress (hop).Get ()] = hop;
+}
+
+void
+CacheReplay::SetHostRxCallback (Callback<void, Ptr<Packet>, Ipv4Header, uint32_t, uint32_t> hostRx)
+{
+  m_hostRx = hostRx;
+}
+
+void
+CacheReplay::SendFromHost (Ptr<Packet> packet, Ipv4Address src, Ipv4Address dst)
+{
+  Ipv4Header header;
+  header.SetSource (src);
+  header.SetDestination (dst);
+  header.SetProtocol (UdpL4Protocol::PROT_NUMBER);
+  header.SetTtl (DEFAULT_TTL);
+  header.SetPayloadSize (packet->GetSize ());
+  SendWithHeader (packet, header);
+}
+
+void
+CacheReplay::SendWithHeader (Ptr<Packet> packet, Ipv4Header header)
+{
+  Forward (packet, header, {LEAF, GetLeaf (header.GetSource ())});
+  Drain ();
+}
+
+void
+CacheReplay::SendFromSwitch (Ptr<Packet> packet, Ipv4Address src, Ipv4Address dst)
+{
+  Ipv4Header header;
+  header.SetSource (src);
+  header.SetDestination (dst);
+  header.SetProtocol (UdpL4Protocol::PROT_NUMBER);
+  header.SetTtl (DEFAULT_TTL);
+  header.SetPayloadSize (packet->GetSize ());
+  m_pending.push_back ({packet, header, m_switchAddresses.at (src.Get ())});
+}
+
+uint32_t
+CacheReplay::GetLeaf (Ipv4Address nodeAddress)
+{
+  uint32_t address = nodeAddress.Get ();
+  return ((address >> 24) - 1) * m_podWidth + ((address >> 16) & 0xff);
+}
+
+uint32_t
+CacheReplay::GetHost (Ipv4Address nodeAddress)
+{
+  return (nodeAddress.Get () >> 8) & 0xff;
+}
+
+void
+CacheReplay::Forward (Ptr<Packet> packet, Ipv4Header &header, Hop hop)
+{
+  while (GetSwitch (hop)->ReceivePacket (packet, header))
+    {
+      header.SetTtl (header.GetTtl () - 1);
+      if (header.GetTtl () == 0 || !Route (packet, header, hop, hop))
+        {
+          return;
+        }
+    }
+}
+
+bool
+CacheReplay::Route (Ptr<Packet> packet, Ipv4Header &header, Hop hop, Hop &next)
+{
+  Ipv4Address dst = header.GetDestination ();
+  auto it = m_switchAddresses.find (dst.Get ());
+  bool toHost = it == m_switchAddresses.end ();
+  Hop target = toHost ? Hop{LEAF, GetLeaf (dst)} : it->second;
+  if (!toHost && target.tier == hop.tier && target.index == hop.index)
+    {
+      return false;
+    }
+
+  uint32_t pod = hop.index / m_podWidth;
+  uint32_t targetPod = target.index / m_podWidth;
+  switch (hop.tier)
+    {
+    case LEAF:
+      if (toHost && target.index == hop.index)
+        {
+          m_hostRx (packet, header, hop.index, GetHost (dst));
+          return false;
+        }
+      if (target.tier == CORE)
+        {
+          // Only the spine wired to that core leads there
+          next = {SPINE, pod * m_podWidth + target.index / m_coresPerSpine};
+        }
+      else if (target.tier == SPINE && targetPod == pod)
+        {
+          next = target;
+        }
+      else
+        {
+          next = {SPINE, pod * m_podWidth + SelectRoute (packet, header, m_podWidth)};
+        }
+      return true;
+    case SPINE:
+      if (target.tier == CORE && target.index / m_coresPerSpine == hop.index % m_podWidth)
+        {
+          next = target;
+        }
+      else if (target.tier == CORE)
+        {
+          // Another group of cores, through a leaf and the spine wired to it
+          next = {LEAF, pod * m_podWidth + SelectRoute (packet, header, m_podWidth)};
+        }
+      else if (targetPod == pod)
+        {
+          next = target.tier == LEAF
+                     ? target
+                     : Hop{LEAF, pod * m_podWidth + SelectRoute (packet, header, m_podWidth)};
+        }
+      else
+        {
+          next = {CORE, (hop.index % m_podWidth) * m_coresPerSpine +
+                            SelectRoute (packet, header, m_coresPerSpine)};
+        }
+      return true;
+    case CORE:
+      if (target.tier == CORE)
+        {
+          targetPod = SelectRoute (packet, header, m_podCount);
+        }
+      next = {SPINE, targetPod * m_podWidth + hop.index / m_coresPerSpine};
+      return true;
+    }
+
+  return false;
+}
+
+uint32_t
+CacheReplay::SelectRoute (Ptr<Packet> packet, const Ipv4Header &header, uint32_t routes)
+{
+  if (m_randomRouting)
+    {
+      return m_random->GetInteger (0, routes - 1);
+    }
+
+  // Same key as Ipv4GlobalRouting::GetFlowHash, so flows take the paths they take in the
+  // packet-level simulation
+  m_hasher.clear ();
+  std::ostringstream oss;
+  oss << header.GetSource () << header.GetDestination () << header.GetProtocol ();
+  UdpHeader udpHeader;
+  packet->PeekHeader (udpHeader);
+  oss << udpHeader.GetSourcePort () << udpHeader.GetDestinationPort ();
+  return m_hasher.GetHash64 (oss.str ()) % routes;
+}
+
+Ptr<P4SwitchApp>
+CacheReplay::GetSwitch (Hop hop)
+{
+  return hop.tier == LEAF ? m_leaves[hop.index]
+                          : (hop.tier == SPINE ? m_spines[hop.index] : m_cores[hop.index]);
+}
+
+Ipv4Address
+CacheReplay::GetAddress (Hop hop)
+{
+  uint32_t pod = hop.index / m_podWidth, offset = hop.index % m_podWidth;
+  switch (hop.tier)
+    {
+    case LEAF:
+      return IpUtils::GetLeafAddress (m_podCount, pod, 0, offset);
+    case SPINE:
+      return IpUtils::GetSpineFromLeafAddress (m_podCount, pod, offset, 0);
+    default:
+      return IpUtils::GetCoreAddress (0, hop.index);
+    }
+}
+
+void
+CacheReplay::Drain ()
+{
+  if (m_draining)
+    {
+      return;
+    }
+
+  m_draining = true;
+  while (!m_pending.empty ())
+    {
+      PendingPacket pending = m_pending.front ();
+      m_pending.pop_front ();
+      Hop next;
+      if (Route (pending.packet, pending.header, pending.from, next))
+        {
+          Forward (pending.packet, pending.header, next);
+        }
+    }
+  m_draining = false;
+}
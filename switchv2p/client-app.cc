@@ -10,7 +10,12 @@ NS_LOG_COMPONENT_DEFINE ("ClientApp");
 const uint16_t CLIENT_PORT = 9;
 
 ClientApp::ClientApp ()
-    : m_socket (0), m_sendEvent (), m_running (false), m_currentIdx (0), m_basePort (CLIENT_PORT)
+    : m_socket (0),
+      m_sendEvent (),
+      m_running (false),
+      m_currentIdx (0),
+      m_resumed (false),
+      m_basePort (CLIENT_PORT)
 {
 }
 
@@ -53,6 +58,24 @@ ClientApp::Setup (vector<Flow> *flows, Ipv4Address address, Ipv4Address physical
   m_udpMode = udpMode;
 }
 
+size_t
+ClientApp::Detach (void)
+{
+  m_running = false;
+  if (m_sendEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_sendEvent);
+    }
+  return m_currentIdx;
+}
+
+void
+ClientApp::SetNextFlow (size_t nextFlow)
+{
+  m_currentIdx = nextFlow;
+  m_resumed = true;
+}
+
 void
 ClientApp::StartApplication (void)
 {
@@ -66,8 +89,11 @@ ClientApp::StartApplication (void)
     {
       m_socket->Bind (InetSocketAddress (m_address));
     }
-  NS_LOG_DEBUG ("Running client with " << m_flows->size () << " flows");
-  ScheduleNext ();
+  NS_LOG_DEBUG ("Running client with " << m_flows->size () - m_currentIdx << " flows");
+  if (m_currentIdx < m_flows->size ())
+    {
+      ScheduleNext ();
+    }
 }
 
 void
@@ -76,6 +102,13 @@ ClientApp::ScheduleNext ()
   uint64_t dt = m_currentIdx == 0
                     ? m_flows->at (0).ts
                     : m_flows->at (m_currentIdx).ts - m_flows->at (m_currentIdx - 1).ts;
+  if (m_resumed)
+    {
+      // A client that took over a VM sends its first packet at the trace time, from time 0
+      m_resumed = false;
+      uint64_t now = Simulator::Now ().ToInteger (Time::NS);
+      dt = m_flows->at (m_currentIdx).ts > now ? m_flows->at (m_currentIdx).ts - now : 0;
+    }
   m_sendEvent = Simulator::Schedule (NanoSeconds (dt), &ClientApp::SendPacket, this);
 }
 
@@ -0,0 +1,113 @@
+#include "include/control-tag.h"
+
+ControlTag::ControlTag () : m_learning (false), m_victimHops (0)
+{
+}
+
+TypeId
+ControlTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ControlTag")
+                          .SetParent<Tag> ()
+                          .SetGroupName ("Sim")
+                          .AddConstructor<ControlTag> ();
+  return tid;
+}
+
+TypeId
+ControlTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+ControlTag::GetSerializedSize (void) const
+{
+  return 1 + 1 + 4 + m_mappings.size () * 2 * sizeof (uint32_t);
+}
+
+void
+ControlTag::Serialize (TagBuffer i) const
+{
+  i.WriteU8 (m_learning);
+  i.WriteU8 (m_victimHops);
+  i.WriteU32 (m_mappings.size ());
+  for (const pair<uint32_t, uint32_t> &mapping : m_mappings)
+    {
+      i.WriteU32 (mapping.first);
+      i.WriteU32 (mapping.second);
+    }
+}
+
+void
+ControlTag::Deserialize (TagBuffer i)
+{
+  m_learning = i.ReadU8 ();
+  m_victimHops = i.ReadU8 ();
+  m_mappings.resize (i.ReadU32 ());
+  for (pair<uint32_t, uint32_t> &mapping : m_mappings)
+    {
+      mapping.first = i.ReadU32 ();
+      mapping.second = i.ReadU32 ();
+    }
+}
+
+void
+ControlTag::Print (std::ostream &os) const
+{
+  os << (m_victimHops ? "Victim" : m_learning ? "Learning" : "Invalidation");
+  for (const pair<uint32_t, uint32_t> &mapping : m_mappings)
+    {
+      os << " key=" << mapping.first << ", val=" << mapping.second << ";";
+    }
+}
+
+bool
+ControlTag::IsLearning (void) const
+{
+  return m_learning;
+}
+
+void
+ControlTag::SetLearning (bool learning)
+{
+  m_learning = learning;
+}
+
+uint8_t
+ControlTag::GetVictimHops (void) const
+{
+  return m_victimHops;
+}
+
+void
+ControlTag::SetVictimHops (uint8_t hops)
+{
+  m_victimHops = hops;
+}
+
+uint32_t
+ControlTag::GetCount (void) const
+{
+  return m_mappings.size ();
+}
+
+pair<uint32_t, uint32_t>
+ControlTag::GetMapping (uint32_t index) const
+{
+  return m_mappings.at (index);
+}
+
+void
+ControlTag::AddMapping (pair<uint32_t, uint32_t> mapping)
+{
+  for (pair<uint32_t, uint32_t> &older : m_mappings)
+    {
+      if (older.first == mapping.first && (m_learning || older.second == mapping.second))
+        {
+          older.second = mapping.second;
+          return;
+        }
+    }
+  m_mappings.push_back (mapping);
+}
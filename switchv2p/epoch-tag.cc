@@ -0,0 +1,69 @@
+#include "include/epoch-tag.h"
+
+EpochTag::EpochTag () : m_sourceEpoch (0), m_destinationEpoch (0)
+{
+}
+
+TypeId
+EpochTag::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("EpochTag").SetParent<Tag> ().SetGroupName ("Sim").AddConstructor<EpochTag> ();
+  return tid;
+}
+
+TypeId
+EpochTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+EpochTag::GetSerializedSize (void) const
+{
+  return 2;
+}
+
+void
+EpochTag::Serialize (TagBuffer i) const
+{
+  i.WriteU8 (m_sourceEpoch);
+  i.WriteU8 (m_destinationEpoch);
+}
+
+void
+EpochTag::Deserialize (TagBuffer i)
+{
+  m_sourceEpoch = i.ReadU8 ();
+  m_destinationEpoch = i.ReadU8 ();
+}
+
+void
+EpochTag::Print (std::ostream &os) const
+{
+  os << "src epoch=" << (uint32_t) m_sourceEpoch << ", dst epoch=" << (uint32_t) m_destinationEpoch;
+}
+
+void
+EpochTag::SetSourceEpoch (uint8_t epoch)
+{
+  m_sourceEpoch = epoch;
+}
+
+uint8_t
+EpochTag::GetSourceEpoch (void) const
+{
+  return m_sourceEpoch;
+}
+
+void
+EpochTag::SetDestinationEpoch (uint8_t epoch)
+{
+  m_destinationEpoch = epoch;
+}
+
+uint8_t
+EpochTag::GetDestinationEpoch (void) const
+{
+  return m_destinationEpoch;
+}
@@ -1,20 +1,16 @@
 #include "include/eviction-tag.h"
 
-EvictionTag::EvictionTag ()
+EvictionTag::EvictionTag () : m_count (0)
 {
 }
 
 TypeId
 EvictionTag::GetTypeId (void)
 {
-  static TypeId tid =
-      TypeId ("EvictionTag")
-          .SetParent<Tag> ()
-          .SetGroupName ("Sim")
-          .AddConstructor<EvictionTag> ()
-          .AddAttribute ("Freqeuncy", "The time at which the timestamp was created",
-                         UintegerValue (0), MakeUintegerAccessor (&EvictionTag::m_key),
-                         MakeUintegerChecker<uint32_t> ());
+  static TypeId tid = TypeId ("EvictionTag")
+                          .SetParent<Tag> ()
+                          .SetGroupName ("Sim")
+                          .AddConstructor<EvictionTag> ();
   return tid;
 }
 
@@ -27,40 +23,127 @@ EvictionTag::GetInstanceTypeId (void) const
 uint32_t
 EvictionTag::GetSerializedSize (void) const
 {
-  return 4 * 2;
+  return 1 + m_count * 3 * sizeof (uint32_t);
 }
 
 void
 EvictionTag::Serialize (TagBuffer i) const
 {
-  uint32_t val[2] = {m_key, m_val};
-  i.Write ((uint8_t *) val, 2 * sizeof (uint32_t));
+  i.WriteU8 (m_count);
+  for (uint32_t index = 0; index < m_count; ++index)
+    {
+      i.WriteU32 (m_entries[index].key);
+      i.WriteU32 (m_entries[index].val);
+      i.WriteU32 (m_entries[index].last);
+    }
 }
 
 void
 EvictionTag::Deserialize (TagBuffer i)
 {
-  uint32_t val[2] = {0};
-  i.Read ((uint8_t *) val, 2 * sizeof (uint32_t));
-  m_key = val[0];
-  m_val = val[1];
+  m_count = std::min<uint32_t> (i.ReadU8 (), MAX_ENTRIES);
+  for (uint32_t index = 0; index < m_count; ++index)
+    {
+      m_entries[index].key = i.ReadU32 ();
+      m_entries[index].val = i.ReadU32 ();
+      m_entries[index].last = i.ReadU32 ();
+    }
 }
 
 void
 EvictionTag::Print (std::ostream &os) const
 {
-  os << "Evicted key=" << m_key << ", evicted val=" << m_val;
+  for (uint32_t index = 0; index < m_count; ++index)
+    {
+      const Entry &entry = m_entries[index];
+      os << (index ? "; " : "") << "Evicted key=" << entry.key
+         << ", evicted last key=" << entry.last << ", evicted val=" << entry.val;
+    }
+}
+
+uint32_t
+EvictionTag::GetCount (void) const
+{
+  return m_count;
 }
 
 pair<uint32_t, uint32_t>
-EvictionTag::GetEvicted (void) const
+EvictionTag::GetEvicted (uint32_t index) const
+{
+  NS_ASSERT (index < m_count);
+  return std::make_pair (m_entries[index].key, m_entries[index].val);
+}
+
+uint32_t
+EvictionTag::GetEvictedLast (uint32_t index) const
 {
-  return std::make_pair (m_key, m_val);
+  NS_ASSERT (index < m_count);
+  return m_entries[index].last;
+}
+
+uint32_t
+EvictionTag::FindEvicted (uint32_t key) const
+{
+  uint32_t index = 0;
+  while (index < m_count && (key < m_entries[index].key || key > m_entries[index].last))
+    {
+      ++index;
+    }
+  return index;
+}
+
+uint32_t
+EvictionTag::FindObsolete (void) const
+{
+  uint32_t index = 0;
+  while (index < m_count && (m_entries[index].key != 0 || m_entries[index].val != 0))
+    {
+      ++index;
+    }
+  return index;
 }
 
 void
 EvictionTag::SetEvicted (pair<uint32_t, uint32_t> val)
 {
-  m_key = val.first;
-  m_val = val.second;
+  SetEvicted (val, val.first);
+}
+
+void
+EvictionTag::SetEvicted (pair<uint32_t, uint32_t> val, uint32_t last)
+{
+  m_count = 0;
+  AddEvicted (val, last, 1);
+}
+
+void
+EvictionTag::AddEvicted (pair<uint32_t, uint32_t> val, uint32_t last, uint32_t capacity)
+{
+  uint32_t index = 0;
+  while (index < m_count)
+    {
+      if (m_entries[index].key <= last && val.first <= m_entries[index].last)
+        {
+          RemoveEvicted (index);
+        }
+      else
+        {
+          ++index;
+        }
+    }
+
+  capacity = std::max<uint32_t> (std::min (capacity, MAX_ENTRIES), 1);
+  while (m_count >= capacity)
+    {
+      RemoveEvicted (0);
+    }
+  m_entries[m_count++] = {val.first, val.second, last};
+}
+
+void
+EvictionTag::RemoveEvicted (uint32_t index)
+{
+  NS_ASSERT (index < m_count);
+  std::copy (m_entries + index + 1, m_entries + m_count, m_entries + index);
+  --m_count;
 }
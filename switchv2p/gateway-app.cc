@@ -4,7 +4,7 @@
 
 NS_LOG_COMPONENT_DEFINE ("GatewayApp");
 
-GatewayApp::GatewayApp () : m_socket (0)
+GatewayApp::GatewayApp () : m_socket (0), m_controlSocket (0), m_directory (nullptr)
 {
 }
 
@@ -26,9 +26,11 @@ GatewayApp::GetTypeId (void)
 }
 
 void
-GatewayApp::Setup (unordered_map<uint32_t, uint32_t> *virtualToPhysical)
+GatewayApp::Setup (unordered_map<uint32_t, uint32_t> *virtualToPhysical,
+                   CacheDirectory *directory)
 {
   m_virtualToPhysical = virtualToPhysical;
+  m_directory = directory;
 }
 
 void
@@ -43,6 +45,12 @@ GatewayApp::StartApplication (void)
       m_socket->BindToNetDevice (GetNode ()->GetDevice (1));
       m_socket->SetRecvCallback (MakeCallback (&GatewayApp::ReceivePacket, this));
     }
+
+  if (m_controlSocket == 0 && m_directory)
+    {
+      m_controlSocket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+      m_controlSocket->Bind ();
+    }
 }
 void
 GatewayApp::StopApplication (void)
@@ -53,6 +61,18 @@ GatewayApp::StopApplication (void)
       m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
       m_socket = 0;
     }
+
+  if (m_controlSocket)
+    {
+      m_controlSocket->Close ();
+      m_controlSocket = 0;
+    }
+}
+
+void
+GatewayApp::SendTo (Ptr<Packet> packet, InetSocketAddress address)
+{
+  m_controlSocket->SendTo (packet, 0, address);
 }
 
 void
@@ -81,15 +101,23 @@ GatewayApp::ReceivePacket (Ptr<Socket> socket)
       packet->RemoveHeader (innerHeader);
       if (m_virtualToPhysical->count (innerHeader.GetDestination ().Get ()) == 0)
         {
+          // The VM was destroyed, see MigrationEvent
           NS_LOG_ERROR ("Failed to find vip: " << innerHeader.GetDestination ().Get ());
+          continue;
         }
 
       uint32_t physical_addr_int = m_virtualToPhysical->at (innerHeader.GetDestination ().Get ());
+      if (m_directory)
+        {
+          m_directory->RecordResolution (innerHeader.GetDestination ().Get (),
+                                         outterHeader.GetDestination (), outterHeader.GetSource (),
+                                         Ipv4Address (physical_addr_int), packet);
+        }
       outterHeader.SetDestination (Ipv4Address (physical_addr_int));
       packet->AddHeader (innerHeader);
       packet->AddHeader (udpHeader);
       packet->AddHeader (outterHeader);
-      Simulator::Schedule (MicroSeconds (40), &GatewayApp::SendPacket, this, socket, packet,
+      Simulator::Schedule (MicroSeconds (PROCESSING_US), &GatewayApp::SendPacket, this, socket, packet,
                            innerHeader);
     }
 }
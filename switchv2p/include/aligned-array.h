@@ -0,0 +1,118 @@
+#ifndef ALIGNED_ARRAY_H
+#define ALIGNED_ARRAY_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/**
+ * Fixed-size, zero-initialized, cache-line aligned array for cache tables.
+ *
+ * The storage is allocated once at full size. With huge pages requested,
+ * tables of at least one huge page are aligned to 2 MiB and advised for
+ * transparent huge page backing, which cuts TLB misses on large tables.
+ */
+template <typename T>
+class AlignedArray
+{
+public:
+  static constexpr size_t CACHE_LINE = 64;
+  static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+  AlignedArray () : m_data (nullptr), m_size (0)
+  {
+  }
+
+  ~AlignedArray ()
+  {
+    std::free (m_data);
+  }
+
+  AlignedArray (const AlignedArray &) = delete;
+  AlignedArray &operator= (const AlignedArray &) = delete;
+
+  AlignedArray (AlignedArray &&other) noexcept : m_data (other.m_data), m_size (other.m_size)
+  {
+    other.m_data = nullptr;
+    other.m_size = 0;
+  }
+
+  AlignedArray &
+  operator= (AlignedArray &&other) noexcept
+  {
+    std::swap (m_data, other.m_data);
+    std::swap (m_size, other.m_size);
+    return *this;
+  }
+
+  void
+  Allocate (size_t size, bool hugePages = false)
+  {
+    std::free (m_data);
+    m_data = nullptr;
+    m_size = size;
+    if (size == 0)
+      {
+        return;
+      }
+
+    size_t bytes = size * sizeof (T);
+    size_t alignment = hugePages && bytes >= HUGE_PAGE ? HUGE_PAGE : CACHE_LINE;
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+    m_data = static_cast<T *> (std::aligned_alloc (alignment, bytes));
+    if (m_data == nullptr)
+      {
+        throw std::bad_alloc ();
+      }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (alignment == HUGE_PAGE)
+      {
+        madvise (m_data, bytes, MADV_HUGEPAGE);
+      }
+#endif
+    std::memset (static_cast<void *> (m_data), 0, bytes);
+  }
+
+  /// Zeroes \p count elements starting at \p start.
+  void
+  Clear (size_t start, size_t count)
+  {
+    std::memset (static_cast<void *> (m_data + start), 0, count * sizeof (T));
+  }
+
+  T &
+  operator[] (size_t i)
+  {
+    return m_data[i];
+  }
+
+  const T &
+  operator[] (size_t i) const
+  {
+    return m_data[i];
+  }
+
+  T *
+  Data ()
+  {
+    return m_data;
+  }
+
+  size_t
+  Size () const
+  {
+    return m_size;
+  }
+
+private:
+  T *m_data;
+  size_t m_size;
+};
+
+#endif /* ALIGNED_ARRAY_H */
@@ -0,0 +1,280 @@
+#ifndef ARC_CACHE_H
+#define ARC_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include "lru-cache.h"
+
+using std::pair;
+
+/**
+ * Adaptive Replacement Cache (Megiddo and Modha, FAST '03).
+ *
+ * T1 holds keys seen once recently and T2 keys seen at least twice. B1 and B2
+ * are ghost lists remembering keys recently evicted from T1 and T2. A learn
+ * that hits a ghost list moves the T1 target size p towards the list that
+ * would have kept the key. Learning a cached key counts as a second reference.
+ * The four lists are LRUCache instances, so every operation is O(1).
+ */
+template <typename K, typename V>
+class ArcCache
+{
+public:
+  ArcCache () : m_cacheSize (0), m_target (0)
+  {
+  }
+
+  void
+  Setup (int capacity)
+  {
+    m_cacheSize = std::max (capacity, 1);
+    m_target = 0;
+    // Capacities are enforced here, the lists only need to hold them
+    m_t1.SetCapacity (m_cacheSize);
+    m_t2.SetCapacity (m_cacheSize);
+    m_b1.SetCapacity (m_cacheSize);
+    m_b2.SetCapacity (m_cacheSize);
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    uint8_t bit;
+    return Get (key, value, bit);
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    if (m_t2.Get (key, value, bit))
+      {
+        return true;
+      }
+    V *cached = m_t1.Peek (key);
+    if (cached == nullptr)
+      {
+        return false;
+      }
+
+    value = *cached;
+    bit = m_t1.GetBit (key);
+    m_t1.Remove (key);
+    m_t2.Put (key, value);
+    m_t2.Get (key, value);
+    return true;
+  }
+
+  /// The bit of the key, or for an absent key the bit of the entry Replace would evict.
+  uint8_t
+  GetBit (K key)
+  {
+    if (m_t1.Find (key))
+      {
+        return m_t1.GetBit (key);
+      }
+    if (m_t2.Find (key))
+      {
+        return m_t2.GetBit (key);
+      }
+    if (GetSize () < m_cacheSize)
+      {
+        return 0;
+      }
+
+    LRUCache<K, V> &victims = EvictFromT1 (false) ? m_t1 : m_t2;
+    return victims.GetBit (victims.GetEvictionCandidate ());
+  }
+
+  bool
+  Find (K key)
+  {
+    return m_t1.Find (key) || m_t2.Find (key);
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    if (GetSize () == m_cacheSize && !Find (key))
+      {
+        return false;
+      }
+    Put (key, value);
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    Put (key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    if (m_t1.Find (key) || m_t2.Find (key))
+      {
+        m_t1.Remove (key);
+        m_t2.Put (key, value);
+        return false;
+      }
+
+    bool eviction = false;
+    if (m_b1.Find (key))
+      {
+        m_target = GetTarget (true, false);
+        eviction = Replace (false, evicted);
+        m_b1.Remove (key);
+        m_t2.Put (key, value);
+        return eviction;
+      }
+    if (m_b2.Find (key))
+      {
+        m_target = GetTarget (false, true);
+        eviction = Replace (true, evicted);
+        m_b2.Remove (key);
+        m_t2.Put (key, value);
+        return eviction;
+      }
+
+    if (m_t1.GetSize () + m_b1.GetSize () >= m_cacheSize)
+      {
+        if (m_t1.GetSize () < m_cacheSize)
+          {
+            m_b1.Remove (m_b1.GetEvictionCandidate ());
+            eviction = Replace (false, evicted);
+          }
+        else
+          {
+            // B1 is empty and T1 fills the cache, drop the LRU entry of T1 outright
+            K victim = m_t1.GetEvictionCandidate ();
+            evicted = std::make_pair (victim, *m_t1.Peek (victim));
+            m_t1.Remove (victim);
+            eviction = true;
+          }
+      }
+    else
+      {
+        size_t total = GetSize () + m_b1.GetSize () + m_b2.GetSize ();
+        if (total >= 2 * m_cacheSize)
+          {
+            m_b2.Remove (m_b2.GetEvictionCandidate ());
+          }
+        eviction = Replace (false, evicted);
+      }
+
+    m_t1.Put (key, value);
+    return eviction;
+  }
+
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    if (GetSize () < m_cacheSize || Find (key))
+      {
+        return false;
+      }
+
+    bool inB1 = m_b1.Find (key), inB2 = m_b2.Find (key);
+    bool fromT1 = EvictFromT1 (inB2, GetTarget (inB1, inB2)) ||
+                  (!inB1 && !inB2 && m_t1.GetSize () == m_cacheSize);
+    victim = fromT1 ? m_t1.GetEvictionCandidate () : m_t2.GetEvictionCandidate ();
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    m_t1.Remove (key);
+    m_t2.Remove (key);
+  }
+
+  size_t
+  GetSize ()
+  {
+    return m_t1.GetSize () + m_t2.GetSize ();
+  }
+
+  /// The slots of T1 followed by the slots of T2.
+  size_t
+  GetSlots () const
+  {
+    return m_t1.GetSlots () + m_t2.GetSlots ();
+  }
+
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    size_t split = m_t1.GetSlots ();
+    if (first < split)
+      {
+        size_t head = std::min (count, split - first);
+        m_t1.ClearBits (first, head);
+        first += head;
+        count -= head;
+      }
+    m_t2.ClearBits (first - split, count);
+  }
+
+private:
+  /// The T1 target size after a learn that hit B1 or B2.
+  size_t
+  GetTarget (bool inB1, bool inB2)
+  {
+    if (inB1)
+      {
+        size_t delta = std::max<size_t> (m_b2.GetSize () / m_b1.GetSize (), 1);
+        return std::min (m_target + delta, m_cacheSize);
+      }
+    if (inB2)
+      {
+        size_t delta = std::max<size_t> (m_b1.GetSize () / m_b2.GetSize (), 1);
+        return m_target > delta ? m_target - delta : 0;
+      }
+    return m_target;
+  }
+
+  bool
+  EvictFromT1 (bool inB2)
+  {
+    return EvictFromT1 (inB2, m_target);
+  }
+
+  bool
+  EvictFromT1 (bool inB2, size_t target)
+  {
+    return m_t1.GetSize () > 0 &&
+           (m_t1.GetSize () > target || (inB2 && m_t1.GetSize () == target) ||
+            m_t2.GetSize () == 0);
+  }
+
+  /// Makes room for one entry if the cache is full, moving the victim to its ghost list.
+  bool
+  Replace (bool inB2, pair<K, V> &evicted)
+  {
+    if (GetSize () < m_cacheSize)
+      {
+        return false;
+      }
+
+    bool fromT1 = EvictFromT1 (inB2);
+    LRUCache<K, V> &list = fromT1 ? m_t1 : m_t2;
+    LRUCache<K, uint8_t> &ghosts = fromT1 ? m_b1 : m_b2;
+    K victim = list.GetEvictionCandidate ();
+    evicted = std::make_pair (victim, *list.Peek (victim));
+    list.Remove (victim);
+    if (ghosts.GetSize () == m_cacheSize)
+      {
+        ghosts.Remove (ghosts.GetEvictionCandidate ());
+      }
+    ghosts.Put (victim, 0);
+    return true;
+  }
+
+  size_t m_cacheSize, m_target;
+  LRUCache<K, V> m_t1, m_t2;
+  LRUCache<K, uint8_t> m_b1, m_b2;
+};
+
+#endif /* ARC_CACHE_H */
@@ -1,61 +1,150 @@
 #ifndef BLOOM_FILTER_H
 #define BLOOM_FILTER_H
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <vector>
-#include "ns3/network-module.h"
-#include "ns3/core-module.h"
+#include "cache-hash.h"
 
-using ns3::CRC32Calculate;
 using std::vector;
 
-template <typename K>
+/**
+ * Bit-packed Bloom filter with k hash functions.
+ *
+ * The k probe positions are derived from two hashes of the key by double
+ * hashing (h1 + i * h2). The filter is either sized directly in bits or from
+ * an expected population and a target false-positive rate.
+ *
+ * In epoch mode the filter keeps two generations. Put inserts into the current
+ * one, Get checks both, and Rotate drops the older generation, so a key is
+ * forgotten one to two rotations after its last Put instead of never.
+ */
+template <typename K, typename Hash = Crc32Hash>
 class BloomFilter
 {
 public:
-  size_t m_size;
-  vector<uint8_t> m_array;
+  static constexpr uint32_t MAX_HASHES = 16;
 
-  BloomFilter ()
+  BloomFilter () : m_size (0), m_hashes (1), m_current (0), m_epochs (false)
   {
   }
 
+  /// The number of bits in one generation.
   size_t
   GetSize ()
   {
     return m_size;
   }
 
+  uint32_t
+  GetHashCount ()
+  {
+    return m_hashes;
+  }
+
+  /// Sizes the filter for \p entries keys at the false-positive rate \p fpr.
+  void
+  Setup (size_t entries, double fpr, bool epochs = false)
+  {
+    assert (fpr > 0 && fpr < 1 && "Invalid bloom filter false-positive rate");
+    entries = std::max<size_t> (entries, 1);
+    double ln2 = std::log (2.0);
+    size_t bits = std::ceil (-(double) entries * std::log (fpr) / (ln2 * ln2));
+    SetupBits (bits, entries, epochs);
+  }
+
+  /// Uses \p bits bits per generation and the optimal hash count for \p entries keys.
   void
-  Setup (int capacity)
+  SetupBits (size_t bits, size_t entries, bool epochs = false)
   {
-    m_size = capacity;
-    m_array.reserve (m_size);
-    for (size_t i = 0; i < m_size; ++i)
+    m_size = std::max<size_t> ((bits + 63) / 64, 1) * 64;
+    double hashes = std::round ((double) m_size / std::max<size_t> (entries, 1) * std::log (2.0));
+    m_hashes = std::min<uint32_t> (std::max (hashes, 1.0), MAX_HASHES);
+    m_index.SetSize (m_size);
+    m_epochs = epochs;
+    m_current = 0;
+    for (vector<uint64_t> &generation : m_generations)
       {
-        m_array[i] = 0;
+        generation.assign (m_size / 64, 0);
       }
   }
 
   bool
   Get (K key)
   {
-    uint32_t idx = GetIndex (key);
-    return m_array[idx] == 1;
+    uint32_t h1, h2;
+    GetHashes (key, h1, h2);
+    if (Test (m_generations[m_current], h1, h2))
+      {
+        return true;
+      }
+    return m_epochs && Test (m_generations[m_current ^ 1], h1, h2);
   }
 
   void
   Put (K key)
   {
-    uint32_t idx = GetIndex (key);
-    m_array[idx] = 1;
+    uint32_t h1, h2;
+    GetHashes (key, h1, h2);
+    vector<uint64_t> &bits = m_generations[m_current];
+    for (uint32_t i = 0; i < m_hashes; ++i)
+      {
+        size_t idx = m_index.Reduce (h1 + i * h2);
+        bits[idx >> 6] |= 1ULL << (idx & 63);
+      }
+  }
+
+  /// Starts a new generation, forgetting keys not Put since the previous rotation.
+  void
+  Rotate ()
+  {
+    m_current ^= 1;
+    std::fill (m_generations[m_current].begin (), m_generations[m_current].end (), 0);
+  }
+
+  void
+  Clear ()
+  {
+    for (vector<uint64_t> &generation : m_generations)
+      {
+        std::fill (generation.begin (), generation.end (), 0);
+      }
   }
 
 private:
-  uint32_t
-  GetIndex (K key)
+  void
+  GetHashes (K key, uint32_t &h1, uint32_t &h2)
   {
-    return key;
+    // CRC hashes under different seeds differ by a constant, so both halves are
+    // taken from one finalized 64-bit value instead
+    uint64_t x = Hash::Hash (key, (K) 0) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 32;
+    h1 = (uint32_t) x;
+    // An odd step visits distinct bits on power-of-two sizes
+    h2 = (uint32_t) (x >> 32) | 1;
   }
+
+  bool
+  Test (const vector<uint64_t> &bits, uint32_t h1, uint32_t h2)
+  {
+    for (uint32_t i = 0; i < m_hashes; ++i)
+      {
+        size_t idx = m_index.Reduce (h1 + i * h2);
+        if (!((bits[idx >> 6] >> (idx & 63)) & 1))
+          {
+            return false;
+          }
+      }
+    return true;
+  }
+
+  size_t m_size;
+  uint32_t m_hashes, m_current;
+  bool m_epochs;
+  vector<uint64_t> m_generations[2];
+  CacheIndex m_index;
 };
 
-#endif /* BLOOM_FILTER_H */
\ No newline at end of file
+#endif /* BLOOM_FILTER_H */
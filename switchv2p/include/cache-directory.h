@@ -0,0 +1,45 @@
+#ifndef CACHE_DIRECTORY_H
+#define CACHE_DIRECTORY_H
+
+#include "ns3/network-module.h"
+#include <set>
+#include <unordered_map>
+
+using namespace ns3;
+using std::set;
+using std::unordered_map;
+
+/**
+ * The switches that likely cache each VIP, kept by the gateways so a mapping
+ * update can invalidate them directly. A resolved packet is learned by the
+ * gateway leaf, the destination leaf and, through a learning packet, the
+ * source leaf, and a misdelivered packet names the switch it hit in its
+ * HitTag. With SourceLearning, the destination leaves of a VIP's packets also
+ * learn it, and are recorded as they do. The spines and cores on the way are
+ * not known, but the invalidation packets to the leaves invalidate the
+ * switches they pass.
+ */
+class CacheDirectory
+{
+public:
+  CacheDirectory (uint32_t podCount = 0);
+
+  /// Records the switches that learn \p vip from a packet of the host \p source that the
+  /// gateway at \p gateway resolved to \p destination.
+  void RecordResolution (uint32_t vip, Ipv4Address gateway, Ipv4Address source,
+                         Ipv4Address destination, Ptr<const Packet> packet);
+  void Record (uint32_t vip, Ipv4Address switchAddress);
+  /// Removes and returns the switches of \p vip.
+  set<uint32_t> Take (uint32_t vip);
+  /// The most memory the directory used, 4 bytes per VIP and per switch of a VIP.
+  uint64_t GetPeakBytes () const;
+
+private:
+  Ipv4Address GetLeaf (Ipv4Address host) const;
+
+  uint32_t m_podCount;
+  unordered_map<uint32_t, set<uint32_t>> m_switches;
+  uint64_t m_bytes, m_peakBytes;
+};
+
+#endif /* CACHE_DIRECTORY_H */
@@ -0,0 +1,172 @@
+#ifndef CACHE_HASH_H
+#define CACHE_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/**
+ * Hash policies for the switch caches.
+ *
+ * A policy is a class with a static Hash (key, seed) returning 32 bits. The
+ * caches take the policy as a template parameter and reduce the result to a
+ * slot with CacheIndex, so swapping the hash costs nothing at run time. The
+ * seed is the per-switch value drawn when RandomHashFunction is enabled and
+ * zero otherwise.
+ */
+
+/// Table-driven reflected CRC-32 for an arbitrary polynomial.
+template <uint32_t Poly>
+class Crc32Table
+{
+public:
+  static uint32_t
+  Calculate (const uint8_t *data, size_t length, uint32_t init = 0xFFFFFFFF)
+  {
+    uint32_t crc = init;
+    for (size_t i = 0; i < length; ++i)
+      {
+        crc = (crc >> 8) ^ s_lut.table[(crc ^ data[i]) & 0xFF];
+      }
+    return ~crc;
+  }
+
+private:
+  struct Lut
+  {
+    uint32_t table[256];
+
+    constexpr Lut () : table ()
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+        {
+          uint32_t c = i;
+          for (int k = 0; k < 8; ++k)
+            {
+              c = (c & 1) ? (c >> 1) ^ Poly : c >> 1;
+            }
+          table[i] = c;
+        }
+    }
+  };
+
+  static constexpr Lut s_lut{};
+};
+
+/// CRC-32 (IEEE 802.3) over the key and seed bytes. Matches ns3::CRC32Calculate.
+class Crc32Hash
+{
+public:
+  template <typename K>
+  static uint32_t
+  Hash (K key, K seed)
+  {
+    K buffer[2] = {key, seed};
+    return Crc32Table<0xEDB88320>::Calculate ((const uint8_t *) buffer, sizeof (buffer));
+  }
+};
+
+/// CRC-32C (Castagnoli). Uses the SSE4.2 crc32 instruction when built with -msse4.2.
+class Crc32cHash
+{
+public:
+  template <typename K>
+  static uint32_t
+  Hash (K key, K seed)
+  {
+#if defined(__SSE4_2__)
+    if (sizeof (K) == sizeof (uint32_t))
+      {
+        return ~_mm_crc32_u32 (_mm_crc32_u32 (0xFFFFFFFF, key), seed);
+      }
+#endif
+    K buffer[2] = {key, seed};
+    return Crc32Table<0x82F63B78>::Calculate ((const uint8_t *) buffer, sizeof (buffer));
+  }
+};
+
+/// Dietzfelbinger multiply-shift with a seed-derived odd multiplier.
+class MultiplyShiftHash
+{
+public:
+  template <typename K>
+  static uint32_t
+  Hash (K key, K seed)
+  {
+    uint64_t a = Mix ((uint64_t) seed ^ 0x2545F4914F6CDD1DULL) | 1;
+    uint64_t b = Mix ((uint64_t) seed + 0x9E3779B97F4A7C15ULL);
+    return (a * (uint64_t) key + b) >> 32;
+  }
+
+private:
+  static uint64_t
+  Mix (uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+};
+
+/**
+ * HashAlgorithm_t.CRC32 as computed by Tofino over a header field: the key is
+ * fed in network byte order, and the seed is folded into the CRC initial value
+ * (a seed of zero gives the default Tofino CRC32).
+ */
+class TofinoCrc32Hash
+{
+public:
+  template <typename K>
+  static uint32_t
+  Hash (K key, K seed)
+  {
+    uint8_t bytes[sizeof (K)];
+    for (size_t i = 0; i < sizeof (K); ++i)
+      {
+        bytes[i] = (uint8_t) (key >> (8 * (sizeof (K) - 1 - i)));
+      }
+    return Crc32Table<0xEDB88320>::Calculate (bytes, sizeof (K), 0xFFFFFFFF ^ (uint32_t) seed);
+  }
+};
+
+/// The key itself, as the original BloomFilter indexing.
+class IdentityHash
+{
+public:
+  template <typename K>
+  static uint32_t
+  Hash (K key, K seed)
+  {
+    return (uint32_t) (key ^ seed);
+  }
+};
+
+/// Reduces a 32-bit hash to a slot, masking instead of dividing for power-of-two sizes.
+class CacheIndex
+{
+public:
+  CacheIndex () : m_size (1), m_mask (0)
+  {
+  }
+
+  void
+  SetSize (size_t size)
+  {
+    m_size = size > 0 ? size : 1;
+    m_mask = (m_size & (m_size - 1)) == 0 ? m_size - 1 : 0;
+  }
+
+  size_t
+  Reduce (uint32_t hash) const
+  {
+    return m_mask || m_size == 1 ? hash & m_mask : hash % m_size;
+  }
+
+private:
+  size_t m_size, m_mask;
+};
+
+#endif /* CACHE_HASH_H */
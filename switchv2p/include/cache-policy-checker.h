@@ -0,0 +1,17 @@
+#ifndef CACHE_POLICY_CHECKER_H
+#define CACHE_POLICY_CHECKER_H
+
+#include "ns3/core-module.h"
+#include "switch-cache.h"
+
+/// The CachePolicy attribute values, kept apart so switch-cache.h builds without ns-3.
+inline ns3::Ptr<const ns3::AttributeChecker>
+MakeCachePolicyChecker ()
+{
+  return ns3::MakeEnumChecker (DEFAULT_POLICY, "Default", DIRECT_MAPPED, "DirectMapped",
+                               SET_ASSOCIATIVE, "SetAssociative", CUCKOO, "Cuckoo", LRU, "LRU",
+                               CLOCK, "CLOCK", ARC, "ARC", S3FIFO, "S3FIFO", RANGE,
+                               "Range");
+}
+
+#endif /* CACHE_POLICY_CHECKER_H */
@@ -0,0 +1,81 @@
+#ifndef CACHE_REPLAY_H
+#define CACHE_REPLAY_H
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "p4-switch-app.h"
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+using namespace ns3;
+using std::deque;
+using std::unordered_map;
+using std::vector;
+
+/**
+ * Walks packets through the fat-tree without links, queues or a network stack.
+ *
+ * Every hop runs P4SwitchApp::ReceivePacket on the outer header, exactly like the
+ * IP interceptor, and the next hop is picked from the routes SimulationBase
+ * installs, with the same per-flow ECMP hash as Ipv4GlobalRouting. Packets leave
+ * the fabric through the host receive callback. Protocol packets the switches
+ * send are walked after the packet that triggered them.
+ */
+class CacheReplay
+{
+public:
+  enum Tier { LEAF, SPINE, CORE };
+
+  CacheReplay (uint32_t podCount, uint32_t podWidth, uint32_t coreCount, bool randomRouting);
+
+  void AddSwitch (Ptr<P4SwitchApp> app, enum Tier tier, uint32_t index);
+  /// Called with the packet, its outer header and the leaf and host index it reached.
+  void SetHostRxCallback (Callback<void, Ptr<Packet>, Ipv4Header, uint32_t, uint32_t> hostRx);
+  /// Sends a packet starting with its UDP header from a host, with an initial TTL.
+  void SendFromHost (Ptr<Packet> packet, Ipv4Address src, Ipv4Address dst);
+  /// Sends a packet starting with its UDP header from a host, keeping \p header as is.
+  void SendWithHeader (Ptr<Packet> packet, Ipv4Header header);
+  /// Sends a packet starting with its UDP header from the switch at \p src.
+  void SendFromSwitch (Ptr<Packet> packet, Ipv4Address src, Ipv4Address dst);
+
+  uint32_t GetLeaf (Ipv4Address nodeAddress);
+  uint32_t GetHost (Ipv4Address nodeAddress);
+
+private:
+  static const uint8_t DEFAULT_TTL;
+
+  struct Hop
+  {
+    enum Tier tier;
+    uint32_t index;
+  };
+
+  struct PendingPacket
+  {
+    Ptr<Packet> packet;
+    Ipv4Header header;
+    Hop from;
+  };
+
+  /// Runs the switches from \p hop on until the packet is consumed, delivered or dropped.
+  void Forward (Ptr<Packet> packet, Ipv4Header &header, Hop hop);
+  /// The next switch from \p hop. Returns false after delivering or dropping the packet.
+  bool Route (Ptr<Packet> packet, Ipv4Header &header, Hop hop, Hop &next);
+  /// Picks one of \p routes equal-cost routes, as Ipv4GlobalRouting does.
+  uint32_t SelectRoute (Ptr<Packet> packet, const Ipv4Header &header, uint32_t routes);
+  Ptr<P4SwitchApp> GetSwitch (Hop hop);
+  Ipv4Address GetAddress (Hop hop);
+  void Drain ();
+
+  uint32_t m_podCount, m_podWidth, m_coresPerSpine;
+  bool m_randomRouting, m_draining;
+  vector<Ptr<P4SwitchApp>> m_leaves, m_spines, m_cores;
+  unordered_map<uint32_t, Hop> m_switchAddresses;
+  Callback<void, Ptr<Packet>, Ipv4Header, uint32_t, uint32_t> m_hostRx;
+  deque<PendingPacket> m_pending;
+  Hasher m_hasher;
+  Ptr<UniformRandomVariable> m_random;
+};
+
+#endif /* CACHE_REPLAY_H */
@@ -24,6 +24,10 @@ public:
   static const uint16_t CLIENT_PORT = 9;
   void Setup (vector<Flow> *flows, Ipv4Address address, Ipv4Address physicalSource,
               bool udpMode);
+  /// Stops sending, for a VM that moved away or was destroyed, and returns its next flow.
+  size_t Detach (void);
+  /// Starts at flow \p nextFlow, at its trace time, for a VM that moved to or started on the node.
+  void SetNextFlow (size_t nextFlow);
 
 private:
   virtual void StartApplication (void);
@@ -46,6 +50,8 @@ private:
       m_disorderTrace;
 
   size_t m_currentIdx;
+  /// Whether the next packet is the first of a client that took over a VM, see SetNextFlow
+  bool m_resumed;
   SourceTag m_sourceTag;
   uint16_t m_packetSize, m_basePort;
   DelayJitterEstimation m_delayEstimation;
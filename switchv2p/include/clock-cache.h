@@ -0,0 +1,209 @@
+#ifndef CLOCK_CACHE_H
+#define CLOCK_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using std::pair;
+using std::unordered_map;
+using std::vector;
+
+/**
+ * Fully associative CLOCK cache.
+ *
+ * Entries sit in a circular array of slots with one access bit each. A hit
+ * sets the bit. When the cache is full, the hand sweeps the slots, clearing
+ * set bits, and evicts the first entry whose bit is already clear.
+ */
+template <typename K, typename V>
+class ClockCache
+{
+public:
+  ClockCache () : m_cacheSize (0), m_hand (0)
+  {
+  }
+
+  void
+  Setup (int capacity)
+  {
+    m_cacheSize = std::max (capacity, 1);
+    m_keys.assign (m_cacheSize, 0);
+    m_values.assign (m_cacheSize, 0);
+    m_bits.assign (m_cacheSize, 0);
+    m_free.clear ();
+    for (size_t slot = m_cacheSize; slot > 0; --slot)
+      {
+        m_free.push_back (slot - 1);
+      }
+    m_index.clear ();
+    m_index.reserve (m_cacheSize);
+    m_hand = 0;
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    auto it = m_index.find (key);
+    if (it == m_index.end ())
+      {
+        return false;
+      }
+
+    value = m_values[it->second];
+    m_bits[it->second] = 1;
+    return true;
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    auto it = m_index.find (key);
+    if (it == m_index.end ())
+      {
+        return false;
+      }
+
+    value = m_values[it->second];
+    bit = m_bits[it->second];
+    m_bits[it->second] = 1;
+    return true;
+  }
+
+  /// The bit of the key, or for an absent key the bit of the slot under the hand.
+  uint8_t
+  GetBit (K key)
+  {
+    auto it = m_index.find (key);
+    if (it != m_index.end ())
+      {
+        return m_bits[it->second];
+      }
+    return m_free.empty () ? m_bits[m_hand] : 0;
+  }
+
+  bool
+  Find (K key)
+  {
+    return m_index.count (key) > 0;
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    if (m_free.empty () && !Find (key))
+      {
+        return false;
+      }
+    Put (key, value);
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    Put (key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    auto it = m_index.find (key);
+    if (it != m_index.end ())
+      {
+        m_values[it->second] = value;
+        m_bits[it->second] = 0;
+        return false;
+      }
+
+    bool eviction = false;
+    size_t slot;
+    if (!m_free.empty ())
+      {
+        slot = m_free.back ();
+        m_free.pop_back ();
+      }
+    else
+      {
+        while (m_bits[m_hand] == 1)
+          {
+            m_bits[m_hand] = 0;
+            m_hand = (m_hand + 1) % m_cacheSize;
+          }
+        slot = m_hand;
+        m_hand = (m_hand + 1) % m_cacheSize;
+        evicted = std::make_pair (m_keys[slot], m_values[slot]);
+        m_index.erase (m_keys[slot]);
+        eviction = true;
+      }
+
+    m_keys[slot] = key;
+    m_values[slot] = value;
+    m_bits[slot] = 0;
+    m_index[key] = slot;
+    return eviction;
+  }
+
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    if (!m_free.empty () || Find (key))
+      {
+        return false;
+      }
+
+    size_t slot = m_hand;
+    for (size_t i = 0; i < m_cacheSize; ++i)
+      {
+        size_t candidate = (m_hand + i) % m_cacheSize;
+        if (m_bits[candidate] == 0)
+          {
+            slot = candidate;
+            break;
+          }
+      }
+    victim = m_keys[slot];
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    auto it = m_index.find (key);
+    if (it == m_index.end ())
+      {
+        return;
+      }
+
+    m_bits[it->second] = 0;
+    m_free.push_back (it->second);
+    m_index.erase (it);
+  }
+
+  /// The number of slots with an access bit.
+  size_t
+  GetSlots () const
+  {
+    return m_cacheSize;
+  }
+
+  /// Clears the access bits of \p count slots starting at slot \p first.
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    std::fill (m_bits.begin () + first, m_bits.begin () + first + count, 0);
+  }
+
+private:
+  size_t m_cacheSize, m_hand;
+  vector<K> m_keys;
+  vector<V> m_values;
+  vector<uint8_t> m_bits;
+  vector<size_t> m_free;
+  unordered_map<K, size_t> m_index;
+};
+
+#endif /* CLOCK_CACHE_H */
@@ -0,0 +1,79 @@
+#ifndef CONSISTENT_HASH_RING_H
+#define CONSISTENT_HASH_RING_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::vector;
+
+/**
+ * Consistent hashing of keys onto nodes 0..n-1. Each node is placed on a 32-bit
+ * ring at \p virtualNodes points, and a key belongs to the node of the first
+ * point at or after the key's hash. Removing a node only moves the keys it
+ * owned, spread over the remaining nodes.
+ */
+class ConsistentHashRing
+{
+public:
+  void
+  Setup (uint32_t nodes, uint32_t virtualNodes, uint32_t seed = 0)
+  {
+    m_seed = seed;
+    m_points.clear ();
+    for (uint32_t node = 0; node < nodes; ++node)
+      {
+        for (uint32_t point = 0; point < virtualNodes; ++point)
+          {
+            uint64_t id = (static_cast<uint64_t> (node) << 32) | point;
+            m_points.push_back (std::make_pair (Mix (id ^ POINT_SALT), node));
+          }
+      }
+    std::sort (m_points.begin (), m_points.end ());
+  }
+
+  void
+  Remove (uint32_t node)
+  {
+    m_points.erase (std::remove_if (m_points.begin (), m_points.end (),
+                                    [node] (const pair<uint32_t, uint32_t> &point) {
+                                      return point.second == node;
+                                    }),
+                    m_points.end ());
+  }
+
+  bool
+  IsEmpty () const
+  {
+    return m_points.empty ();
+  }
+
+  /// The owner of \p key. The ring must not be empty.
+  uint32_t
+  GetOwner (uint32_t key) const
+  {
+    uint32_t hash = Mix ((static_cast<uint64_t> (m_seed) << 32) | key);
+    auto it = std::lower_bound (m_points.begin (), m_points.end (), std::make_pair (hash, 0u));
+    return (it == m_points.end () ? m_points.front () : *it).second;
+  }
+
+private:
+  static const uint64_t POINT_SALT = 0x9E3779B97F4A7C15ULL;
+
+  /// The high half of the splitmix64 finalizer.
+  static uint32_t
+  Mix (uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (x ^ (x >> 31)) >> 32;
+  }
+
+  uint32_t m_seed = 0;
+  /// Points by their position on the ring, with their node
+  vector<pair<uint32_t, uint32_t>> m_points;
+};
+
+#endif /* CONSISTENT_HASH_RING_H */
@@ -0,0 +1,49 @@
+#ifndef CONTROL_TAG_H
+#define CONTROL_TAG_H
+
+#include "ns3/network-module.h"
+#include <vector>
+
+using namespace ns3;
+using std::pair;
+using std::vector;
+
+/**
+ * The mappings of a control packet a switch generates, for the destination
+ * switch to learn or for every switch on the way to invalidate. Victims a core
+ * forwards to a peer are learning mappings with the peers visited so far.
+ */
+class ControlTag : public Tag
+{
+public:
+  ControlTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  bool IsLearning (void) const;
+  void SetLearning (bool learning);
+  /// The peers a forwarded victim reached including this one, 0 for other mappings.
+  uint8_t GetVictimHops (void) const;
+  void SetVictimHops (uint8_t hops);
+  uint32_t GetCount (void) const;
+  pair<uint32_t, uint32_t> GetMapping (uint32_t index) const;
+  /// Adds a mapping. A learned mapping replaces an older one of the same key.
+  void AddMapping (pair<uint32_t, uint32_t> mapping);
+
+private:
+  bool m_learning;
+  uint8_t m_victimHops;
+  vector<pair<uint32_t, uint32_t>> m_mappings;
+};
+
+#endif /* CONTROL_TAG_H */
@@ -0,0 +1,38 @@
+#ifndef EPOCH_TAG_H
+#define EPOCH_TAG_H
+
+#include "ns3/network-module.h"
+
+using namespace ns3;
+
+/// The epochs of the source and destination mappings that the sending host expects.
+class EpochTag : public Tag
+{
+public:
+  /// Epochs wrap around, so a versioned host address keeps a valid last octet.
+  static constexpr uint8_t EPOCHS = 128;
+
+  EpochTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  void SetSourceEpoch (uint8_t epoch);
+  uint8_t GetSourceEpoch (void) const;
+  void SetDestinationEpoch (uint8_t epoch);
+  uint8_t GetDestinationEpoch (void) const;
+
+private:
+  uint8_t m_sourceEpoch, m_destinationEpoch;
+};
+
+#endif /* EPOCH_TAG_H */
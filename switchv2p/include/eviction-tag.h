@@ -6,9 +6,16 @@
 using namespace ns3;
 using std::pair;
 
+/**
+ * Mappings a packet carries down the cache hierarchy, oldest first. Each entry
+ * is a range of keys with one value, a single key unless a range cache evicted it.
+ */
 class EvictionTag : public Tag
 {
 public:
+  /// The most entries a tag can carry.
+  static constexpr uint32_t MAX_ENTRIES = 4;
+
   EvictionTag ();
 
   /**
@@ -18,17 +25,39 @@ public:
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
 
+  /// Also the wire size of the header: a count byte and the key, last key and value of each entry.
   virtual uint32_t GetSerializedSize (void) const;
   virtual void Serialize (TagBuffer i) const;
   virtual void Deserialize (TagBuffer i);
   virtual void Print (std::ostream &os) const;
 
-  pair<uint32_t, uint32_t> GetEvicted (void) const;
+  uint32_t GetCount (void) const;
+  /// The first key of the evicted range and its value.
+  pair<uint32_t, uint32_t> GetEvicted (uint32_t index = 0) const;
+  /// The last key of the evicted range, the first key unless a range cache evicted it.
+  uint32_t GetEvictedLast (uint32_t index = 0) const;
+  /// The index of the entry whose range holds \p key, or GetCount () if there is none.
+  uint32_t FindEvicted (uint32_t key) const;
+  /// The index of the (0, 0) entry that marks a migrated destination, or GetCount ().
+  uint32_t FindObsolete (void) const;
+  /// Replaces the entries with a single entry.
   void SetEvicted (pair<uint32_t, uint32_t> v);
+  void SetEvicted (pair<uint32_t, uint32_t> v, uint32_t last);
+  /**
+   * Appends an entry. Entries that overlap its range are dropped, since it is
+   * the newer mapping. If \p capacity entries remain, the oldest is dropped.
+   */
+  void AddEvicted (pair<uint32_t, uint32_t> v, uint32_t last, uint32_t capacity);
+  void RemoveEvicted (uint32_t index);
 
 private:
-  uint32_t m_key;
-  uint32_t m_val;
+  struct Entry
+  {
+    uint32_t key, val, last;
+  };
+
+  uint32_t m_count;
+  Entry m_entries[MAX_ENTRIES];
 };
 
 #endif /* EVICTION_TAG_H */
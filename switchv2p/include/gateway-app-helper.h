@@ -8,8 +8,9 @@
 class GatewayAppHelper
 {
 public:
-  GatewayAppHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical)
-      : m_virtualToPhysical (virtualToPhysical)
+  GatewayAppHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical,
+                    CacheDirectory *directory = nullptr)
+      : m_virtualToPhysical (virtualToPhysical), m_directory (directory)
   {
     m_factory.SetTypeId (GatewayApp::GetTypeId ());
   }
@@ -37,13 +38,14 @@ private:
   InstallPriv (Ptr<Node> node) const
   {
     Ptr<GatewayApp> app = m_factory.Create<GatewayApp> ();
-    app->Setup (&m_virtualToPhysical);
+    app->Setup (&m_virtualToPhysical, m_directory);
     node->AddApplication (app);
 
     return app;
   }
   ObjectFactory m_factory;
   unordered_map<uint32_t, uint32_t> &m_virtualToPhysical;
+  CacheDirectory *m_directory;
 };
 
 #endif /* GATEWAY_APP_HELPER_H */
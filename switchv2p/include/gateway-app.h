@@ -4,6 +4,7 @@
 #include "ns3/applications-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
+#include "cache-directory.h"
 #include <unordered_map>
 
 using namespace ns3;
@@ -19,7 +20,11 @@ public:
    * \return The TypeId.
    */
   static TypeId GetTypeId (void);
-  void Setup (unordered_map<uint32_t, uint32_t>* virtualToPhysical);
+  /// Microseconds a gateway holds a packet before sending it on, the Rx trace fires at the send
+  static const uint32_t PROCESSING_US = 40;
+  void Setup (unordered_map<uint32_t, uint32_t>* virtualToPhysical, CacheDirectory *directory);
+  /// Sends \p packet over UDP, for the invalidations of the CacheDirectory.
+  void SendTo (Ptr<Packet> packet, InetSocketAddress address);
 
 private:
   virtual void StartApplication (void);
@@ -30,7 +35,9 @@ private:
   void SendPacket (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Header innerHeader);
 
   Ptr<Socket> m_socket; //!< The tranmission socket.
+  Ptr<Socket> m_controlSocket;
   unordered_map<uint32_t, uint32_t> *m_virtualToPhysical;
+  CacheDirectory *m_directory;
   TracedCallback<Ptr<const Packet>, const Address &> m_rxTrace;
 };
 
@@ -24,6 +24,10 @@ public:
   static Ipv4Address GetCoreSwitchBaseAddress (uint32_t spinePodId, uint32_t core);
   static Ipv4Address GetCoreAddress (uint32_t spinePodId, uint32_t core);
   static Ipv4Address GetSpineFromCoreAddress (uint32_t spinePodId, uint32_t core);
+  /// A host address with \p epoch in its last octet, which is 1 for every host, as 1 + epoch.
+  static uint32_t GetVersionedAddress (uint32_t address, uint8_t epoch);
+  static uint32_t GetUnversionedAddress (uint32_t versionedAddress);
+  static uint8_t GetAddressEpoch (uint32_t versionedAddress);
 };
 
 #endif /* IP_UTILS_H */
\ No newline at end of file
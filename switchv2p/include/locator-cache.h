@@ -0,0 +1,174 @@
+#ifndef LOCATOR_CACHE_H
+#define LOCATOR_CACHE_H
+
+#include <cstdint>
+#include <utility>
+
+using std::pair;
+
+/**
+ * Dense numbering of the physical host addresses, (pod + 1).leafOffset.host.1
+ * as built by IpUtils::GetNodePhysicalAddress. Locators start at 1, since the
+ * P4 caches read a zero value as an empty slot. With \p epochs above 1, the
+ * last octet is the epoch + 1 of a versioned address (IpUtils::GetVersionedAddress)
+ * and is numbered too, so a decoded locator keeps its epoch.
+ */
+class HostLocators
+{
+public:
+  HostLocators (uint32_t leafCount = 0, uint32_t podWidth = 1, uint32_t hostsPerLeaf = 1,
+                uint32_t epochs = 1)
+      : m_leafCount (leafCount),
+        m_podWidth (podWidth),
+        m_hostsPerLeaf (hostsPerLeaf),
+        m_epochs (epochs)
+  {
+  }
+
+  /// The highest locator.
+  uint32_t
+  GetCount () const
+  {
+    return m_leafCount * m_hostsPerLeaf * m_epochs;
+  }
+
+  /// The leaves, and so the spines, of a pod.
+  uint32_t
+  GetPodWidth () const
+  {
+    return m_podWidth;
+  }
+
+  uint16_t
+  Encode (uint32_t address) const
+  {
+    uint32_t pod = (address >> 24) - 1, leafOffset = (address >> 16) & 0xff;
+    uint32_t host = (address >> 8) & 0xff, epoch = (address & 0xff) - 1;
+    return ((pod * m_podWidth + leafOffset) * m_hostsPerLeaf + host) * m_epochs + epoch + 1;
+  }
+
+  uint32_t
+  Decode (uint16_t locator) const
+  {
+    uint32_t index = (locator - 1) / m_epochs, epoch = (locator - 1) % m_epochs;
+    uint32_t leaf = index / m_hostsPerLeaf, host = index % m_hostsPerLeaf;
+    return ((leaf / m_podWidth + 1) << 24) | ((leaf % m_podWidth) << 16) | (host << 8) |
+           (epoch + 1);
+  }
+
+private:
+  uint32_t m_leafCount, m_podWidth, m_hostsPerLeaf, m_epochs;
+};
+
+/**
+ * Switch cache of host addresses that stores 16-bit host locators in \p Cache,
+ * a P4 register cache with uint16_t values, instead of 32-bit addresses. Values
+ * are encoded on the way in and decoded on a hit, so it has the interface of a
+ * cache of uint32_t values.
+ */
+template <typename Cache, typename K = uint32_t>
+class LocatorCache
+{
+public:
+  Cache &
+  GetCache ()
+  {
+    return m_cache;
+  }
+
+  void
+  SetLocators (const HostLocators &locators)
+  {
+    m_locators = locators;
+  }
+
+  bool
+  Get (K key, uint32_t &value)
+  {
+    uint16_t locator;
+    if (!m_cache.Get (key, locator))
+      {
+        return false;
+      }
+    value = m_locators.Decode (locator);
+    return true;
+  }
+
+  bool
+  Get (K key, uint32_t &value, uint8_t &bit)
+  {
+    uint16_t locator;
+    if (!m_cache.Get (key, locator, bit))
+      {
+        return false;
+      }
+    value = m_locators.Decode (locator);
+    return true;
+  }
+
+  uint8_t
+  GetBit (K key)
+  {
+    return m_cache.GetBit (key);
+  }
+
+  bool
+  Find (K key)
+  {
+    return m_cache.Find (key);
+  }
+
+  bool
+  PutIfNotEvict (K key, uint32_t value)
+  {
+    return m_cache.PutIfNotEvict (key, m_locators.Encode (value));
+  }
+
+  void
+  Put (K key, uint32_t value)
+  {
+    m_cache.Put (key, m_locators.Encode (value));
+  }
+
+  bool
+  Put (K key, uint32_t value, pair<K, uint32_t> &evicted)
+  {
+    pair<K, uint16_t> evictedLocator;
+    if (!m_cache.Put (key, m_locators.Encode (value), evictedLocator))
+      {
+        return false;
+      }
+    evicted = std::make_pair (evictedLocator.first, m_locators.Decode (evictedLocator.second));
+    return true;
+  }
+
+  bool
+  GetVictim (K key, K &victim)
+  {
+    return m_cache.GetVictim (key, victim);
+  }
+
+  void
+  Remove (K key)
+  {
+    m_cache.Remove (key);
+  }
+
+  size_t
+  GetSlots () const
+  {
+    return m_cache.GetSlots ();
+  }
+
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    m_cache.ClearBits (first, count);
+  }
+
+private:
+  Cache m_cache;
+  HostLocators m_locators;
+};
+
+#endif /* LOCATOR_CACHE_H */
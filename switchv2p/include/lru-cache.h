@@ -1,54 +1,109 @@
 #ifndef LRU_CACHE_H
 #define LRU_CACHE_H
 
-#include <map>
-#include <deque>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
-using std::deque;
-using std::map;
 using std::pair;
 using std::vector;
 
+/**
+ * LRU cache with O(1) Get/Put/Remove.
+ *
+ * Entries live in a node pool and are threaded on an intrusive doubly linked
+ * recency list (head = most recently used). Keys are located through a flat,
+ * linearly probed hash index that stores node indices. Storage grows on demand
+ * up to the configured capacity, so unused caches stay small.
+ */
 template <typename K, typename V>
 class LRUCache
 {
 public:
-  size_t m_cacheSize;
-  map<K, V> m_map;
-  deque<K> m_dq;
+  LRUCache () : m_cacheSize (0), m_size (0), m_head (NIL), m_tail (NIL), m_free (NIL)
+  {
+  }
 
   void
   SetCapacity (int capacity)
   {
-    m_cacheSize = capacity;
+    m_cacheSize = capacity > 0 ? capacity : 0;
+    m_nodes.clear ();
+    m_index.assign (MIN_INDEX_SIZE, NIL);
+    m_size = 0;
+    m_head = m_tail = m_free = NIL;
   }
 
   bool
   Get (K key, V &value)
   {
-    if (m_map.find (key) == m_map.end ())
+    uint32_t node = Lookup (key);
+    if (node == NIL)
       {
         return false;
       }
 
-    typename deque<K>::iterator it = m_dq.begin ();
-    while (*it != key)
+    MoveToFront (node);
+    value = m_nodes[node].value;
+    m_nodes[node].bit = 1;
+    return true;
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    uint32_t node = Lookup (key);
+    if (node == NIL)
       {
-        it++;
+        return false;
       }
 
-    m_dq.erase (it);
-    m_dq.push_front (key);
-
-    value = m_map[key];
+    MoveToFront (node);
+    value = m_nodes[node].value;
+    bit = m_nodes[node].bit;
+    m_nodes[node].bit = 1;
     return true;
   }
 
+  /// The value of the key without touching its recency, or nullptr if absent.
+  V *
+  Peek (K key)
+  {
+    uint32_t node = Lookup (key);
+    return node == NIL ? nullptr : &m_nodes[node].value;
+  }
+
+  /**
+   * The access bit of the key, set by Get and cleared by Put. For an absent key,
+   * the bit of the entry a Put would evict, or 0 if there is room.
+   */
+  uint8_t
+  GetBit (K key)
+  {
+    uint32_t node = Lookup (key);
+    if (node == NIL)
+      {
+        return m_size == m_cacheSize && m_size > 0 ? m_nodes[m_tail].bit : 0;
+      }
+    return m_nodes[node].bit;
+  }
+
   bool
   Find (K key)
   {
-    return m_map.find (key) != m_map.end ();
+    return Lookup (key) != NIL;
+  }
+
+  /// Puts the key only if it is cached or there is room without an eviction.
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    if (m_size == m_cacheSize && !Find (key))
+      {
+        return false;
+      }
+    Put (key, value);
+    return true;
   }
 
   bool
@@ -61,70 +116,294 @@ public:
   size_t
   GetSize ()
   {
-    return m_dq.size ();
+    return m_size;
+  }
+
+  size_t
+  GetCapacity ()
+  {
+    return m_cacheSize;
   }
 
   K
   GetEvictionCandidate ()
   {
-    return m_dq.back ();
+    return m_nodes[m_tail].key;
+  }
+
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    if (m_size < m_cacheSize || m_size == 0 || Find (key))
+      {
+        return false;
+      }
+    victim = m_nodes[m_tail].key;
+    return true;
   }
 
   void
   Remove (K key)
   {
-    typename deque<K>::iterator it = m_dq.begin ();
-    while (*it != key)
+    if (m_size == 0)
       {
-        it++;
+        return;
       }
 
-    m_dq.erase (it);
-    m_map.erase (key);
+    size_t slot = FindSlot (key);
+    if (m_index[slot] == NIL)
+      {
+        return;
+      }
+
+    uint32_t node = m_index[slot];
+    EraseSlot (slot);
+    Unlink (node);
+    m_nodes[node].next = m_free;
+    m_free = node;
+    m_size--;
   }
 
+  /// Keys ordered from the most to the least recently used.
   vector<K>
   GetKeys ()
   {
-    vector<K> vints;
-    for (auto const &imap : m_map)
-      vints.push_back (imap.first);
-    return vints;
+    vector<K> keys;
+    keys.reserve (m_size);
+    for (uint32_t node = m_head; node != NIL; node = m_nodes[node].next)
+      {
+        keys.push_back (m_nodes[node].key);
+      }
+    return keys;
+  }
+
+  /// The number of allocated nodes, including free ones.
+  size_t
+  GetSlots () const
+  {
+    return m_nodes.size ();
+  }
+
+  /// Calls \p visit (value, bit) for \p count nodes starting at node \p first.
+  template <typename Visitor>
+  void
+  VisitSlots (size_t first, size_t count, Visitor visit)
+  {
+    for (size_t node = first; node < first + count; ++node)
+      {
+        visit (m_nodes[node].value, m_nodes[node].bit);
+      }
+  }
+
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    VisitSlots (first, count, [] (V &, uint8_t &bit) { bit = 0; });
   }
 
   bool
   Put (K key, V value, pair<K, V> &removed)
   {
+    if (m_cacheSize == 0)
+      {
+        return false;
+      }
+
+    size_t slot = FindSlot (key);
+    if (m_index[slot] != NIL)
+      {
+        uint32_t node = m_index[slot];
+        m_nodes[node].value = value;
+        m_nodes[node].bit = 0;
+        MoveToFront (node);
+        return false;
+      }
+
     bool evict = false;
+    uint32_t node;
+    if (m_size == m_cacheSize)
+      {
+        // Recycle the LRU node for the new key
+        node = m_tail;
+        removed.first = m_nodes[node].key;
+        removed.second = m_nodes[node].value;
+        EraseSlot (FindSlot (removed.first));
+        Unlink (node);
+        m_size--;
+        evict = true;
+        slot = FindSlot (key);
+      }
+    else
+      {
+        node = AllocateNode ();
+        if (GrowIndexIfNeeded ())
+          {
+            slot = FindSlot (key);
+          }
+      }
+
+    m_nodes[node].key = key;
+    m_nodes[node].value = value;
+    m_nodes[node].bit = 0;
+    m_index[slot] = node;
+    PushFront (node);
+    m_size++;
+    return evict;
+  }
+
+private:
+  static constexpr uint32_t NIL = (uint32_t) -1;
+  static constexpr size_t MIN_INDEX_SIZE = 16;
+
+  struct Node
+  {
+    K key;
+    V value;
+    uint32_t prev;
+    uint32_t next;
+    uint8_t bit;
+  };
+
+  size_t
+  Home (K key) const
+  {
+    uint64_t h = static_cast<uint64_t> (std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ULL;
+    return (h >> 32) & (m_index.size () - 1);
+  }
 
-    if (m_map.find (key) == m_map.end ())
+  /// Slot holding the key, or the empty slot where it would be inserted.
+  size_t
+  FindSlot (K key) const
+  {
+    size_t mask = m_index.size () - 1;
+    size_t slot = Home (key);
+    while (m_index[slot] != NIL && !(m_nodes[m_index[slot]].key == key))
       {
-        if (m_cacheSize == m_dq.size ())
+        slot = (slot + 1) & mask;
+      }
+    return slot;
+  }
+
+  uint32_t
+  Lookup (K key) const
+  {
+    if (m_size == 0)
+      {
+        return NIL;
+      }
+    return m_index[FindSlot (key)];
+  }
+
+  /// Backward-shift deletion keeps probe sequences intact without tombstones.
+  void
+  EraseSlot (size_t slot)
+  {
+    size_t mask = m_index.size () - 1;
+    size_t hole = slot;
+    size_t i = (slot + 1) & mask;
+    while (m_index[i] != NIL)
+      {
+        size_t home = Home (m_nodes[m_index[i]].key);
+        if (((i - home) & mask) >= ((i - hole) & mask))
           {
-            K last = m_dq.back ();
-            m_dq.pop_back ();
-            removed.first = last;
-            removed.second = m_map.at (last);
-            m_map.erase (last);
-            evict = true;
+            m_index[hole] = m_index[i];
+            hole = i;
           }
+        i = (i + 1) & mask;
       }
-    else
+    m_index[hole] = NIL;
+  }
+
+  /// Keeps the index at most half full. Returns true if it was rehashed.
+  bool
+  GrowIndexIfNeeded ()
+  {
+    if ((m_size + 1) * 2 <= m_index.size ())
+      {
+        return false;
+      }
+
+    vector<uint32_t> old;
+    old.swap (m_index);
+    m_index.assign (old.size () * 2, NIL);
+    for (uint32_t node : old)
       {
-        typename deque<K>::iterator it = m_dq.begin ();
-        while (*it != key)
+        if (node != NIL)
           {
-            it++;
+            m_index[FindSlot (m_nodes[node].key)] = node;
           }
+      }
+    return true;
+  }
 
-        m_dq.erase (it);
-        m_map.erase (key);
+  uint32_t
+  AllocateNode ()
+  {
+    if (m_free != NIL)
+      {
+        uint32_t node = m_free;
+        m_free = m_nodes[node].next;
+        return node;
       }
+    m_nodes.push_back (Node ());
+    return m_nodes.size () - 1;
+  }
 
-    m_dq.push_front (key);
-    m_map[key] = value;
-    return evict;
+  void
+  Unlink (uint32_t node)
+  {
+    Node &n = m_nodes[node];
+    if (n.prev != NIL)
+      {
+        m_nodes[n.prev].next = n.next;
+      }
+    else
+      {
+        m_head = n.next;
+      }
+
+    if (n.next != NIL)
+      {
+        m_nodes[n.next].prev = n.prev;
+      }
+    else
+      {
+        m_tail = n.prev;
+      }
+  }
+
+  void
+  PushFront (uint32_t node)
+  {
+    m_nodes[node].prev = NIL;
+    m_nodes[node].next = m_head;
+    if (m_head != NIL)
+      {
+        m_nodes[m_head].prev = node;
+      }
+    m_head = node;
+    if (m_tail == NIL)
+      {
+        m_tail = node;
+      }
   }
+
+  void
+  MoveToFront (uint32_t node)
+  {
+    if (node != m_head)
+      {
+        Unlink (node);
+        PushFront (node);
+      }
+  }
+
+  size_t m_cacheSize;
+  size_t m_size;
+  uint32_t m_head, m_tail, m_free;
+  vector<Node> m_nodes;
+  vector<uint32_t> m_index;
 };
 
-#endif /* LRU_CACHE_H */
\ No newline at end of file
+#endif /* LRU_CACHE_H */
@@ -2,22 +2,57 @@
 #define MIGRATION_PARAMS_H
 
 #include <cstdint>
+#include <string>
 
 class MigrationParams
 {
 public:
   MigrationParams (bool migration, uint32_t containerId, uint32_t dstLeaf, uint32_t dstHost,
-                   uint64_t ts)
-      : migration (migration),
+                   uint64_t ts, bool versionedMappings = false, bool cacheDirectory = false,
+                   std::string schedule = "", uint64_t window = 1000)
+      : migration (migration || !schedule.empty ()),
+        versionedMappings (versionedMappings),
+        cacheDirectory (cacheDirectory),
         containerId (containerId),
         dstLeaf (dstLeaf),
         dstHost (dstHost),
-        ts (ts)
+        ts (ts),
+        schedule (schedule),
+        window (window)
   {
   }
-  bool migration;
+  /// Hosts stamp the epochs of the mappings they expect, see EpochTag
+  bool migration, versionedMappings;
+  /// The gateways invalidate the switches of a moved mapping, see CacheDirectory
+  bool cacheDirectory;
   uint32_t containerId, dstLeaf, dstHost;
   uint64_t ts;
+  /// The CSV migration schedule, replaces the single migration above when set
+  std::string schedule;
+  /// Microseconds before and after each migration its gateway packets are counted in
+  uint64_t window;
+};
+
+/// A VM event of the migration schedule, in microseconds.
+class MigrationEvent
+{
+public:
+  enum Type
+  {
+    MIGRATE,
+    CREATE,
+    DESTROY
+  };
+
+  MigrationEvent (uint64_t ts, uint32_t containerId, uint32_t dstLeaf, uint32_t dstHost,
+                  enum Type type = MIGRATE)
+      : ts (ts), containerId (containerId), dstLeaf (dstLeaf), dstHost (dstHost), type (type)
+  {
+  }
+
+  uint64_t ts;
+  uint32_t containerId, dstLeaf, dstHost;
+  enum Type type;
 };
 
 #endif /* MIGRATION_PARAMS_H */
\ No newline at end of file
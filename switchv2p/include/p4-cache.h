@@ -1,49 +1,74 @@
 #ifndef P4_CACHE_H
 #define P4_CACHE_H
 
-#include <map>
-#include <deque>
+#include <algorithm>
+#include <cassert>
 #include <vector>
-#include "ns3/network-module.h"
-#include "ns3/core-module.h"
+#include "aligned-array.h"
+#include "cache-hash.h"
 
-using ns3::CRC32Calculate;
-using ns3::CreateObject;
-using ns3::UniformRandomVariable;
 using std::pair;
 using std::vector;
 
-template <typename K, typename V>
+/**
+ * Direct-mapped cache modelled after a P4 register array.
+ *
+ * Storage is a struct of arrays: keys and values live in separate contiguous
+ * arrays and the access bits are packed 64 per word, so probing a key touches
+ * one key cache line and reading a bit touches one bit word. All arrays are
+ * allocated once at full size in Setup, optionally backed by huge pages.
+ *
+ * With SetExpiry, each slot also keeps 16-bit stamps of a coarse clock, set
+ * with SetClock, for when it was inserted and last hit. An entry idle or
+ * resident for its timeout is a miss and is cleared on lookup, or by Expire.
+ */
+template <typename K, typename V, typename Hash = Crc32Hash>
 class P4Cache
 {
 public:
   size_t m_cacheSize;
-  vector<pair<K, V>> m_array;
-  vector<uint8_t> m_bits;
-  K m_buffer[2];
-  ns3::Ptr<UniformRandomVariable> m_random;
+  AlignedArray<K> m_keys;
+  AlignedArray<V> m_values;
+  AlignedArray<uint64_t> m_bits;
+  K m_seed;
+  CacheIndex m_index;
+  AlignedArray<uint16_t> m_accessed, m_inserted;
+  uint16_t m_idleTicks, m_hardTicks, m_now;
+  uint64_t m_expirations;
 
-  P4Cache () : m_buffer{0, 0}, m_random (CreateObject<UniformRandomVariable> ())
+  P4Cache ()
+      : m_cacheSize (0), m_seed (0), m_idleTicks (0), m_hardTicks (0), m_now (0), m_expirations (0)
   {
   }
 
   void
-  Setup (int capacity, bool randomHash)
+  Setup (int capacity, K seed = 0, bool hugePages = false)
   {
-    m_cacheSize = capacity;
-    m_array.reserve (m_cacheSize);
-    m_bits.reserve (m_cacheSize);
-    for (size_t i = 0; i < m_cacheSize; ++i)
-      {
-        m_array[i].first = 0;
-        m_array[i].second = 0;
-        m_bits[i] = 0;
-      }
+    // A zero-sized register array is kept as a single slot so lookups stay in bounds
+    m_cacheSize = std::max (capacity, 1);
+    m_index.SetSize (m_cacheSize);
+    m_keys.Allocate (m_cacheSize, hugePages);
+    m_values.Allocate (m_cacheSize, hugePages);
+    m_bits.Allocate ((m_cacheSize + 63) / 64, hugePages);
 
-    if (randomHash)
-      {
-        m_buffer[1] = m_random->GetInteger (0, (K) -1);
-      }
+    m_seed = seed;
+  }
+
+  /// Expires entries idle for \p idleTicks or resident for \p hardTicks clock ticks, 0 disables.
+  void
+  SetExpiry (uint16_t idleTicks, uint16_t hardTicks, bool hugePages = false)
+  {
+    m_idleTicks = idleTicks;
+    m_hardTicks = hardTicks;
+    m_accessed.Allocate (idleTicks > 0 ? m_cacheSize : 0, hugePages);
+    m_inserted.Allocate (hardTicks > 0 ? m_cacheSize : 0, hugePages);
+  }
+
+  /// Sets the coarse clock the stamps are taken from, it may wrap around.
+  void
+  SetClock (uint16_t now)
+  {
+    m_now = now;
   }
 
   bool
@@ -51,28 +76,28 @@ public:
   {
     uint32_t idx = GetIndex (key);
 
-    if (m_array[idx].first == key && m_array[idx].second != 0)
+    if (m_keys[idx] == key && m_values[idx] != 0 && !Expire (idx))
       {
-        value = m_array[idx].second;
-        m_bits[idx] = 1;
+        value = m_values[idx];
+        SetBit (idx);
+        Touch (idx);
         return true;
       }
-    m_bits[idx] = 0;
+    ClearBit (idx);
     return false;
   }
 
   uint8_t
   GetBit (K key)
   {
-    uint32_t idx = GetIndex (key);
-    return m_bits[idx];
+    return TestBit (GetIndex (key));
   }
 
   bool
   Find (K key)
   {
     uint32_t idx = GetIndex (key);
-    return m_array[idx].first == key && m_array[idx].second != 0;
+    return m_keys[idx] == key && m_values[idx] != 0 && !Expire (idx);
   }
 
   bool
@@ -80,11 +105,12 @@ public:
   {
     uint32_t idx = GetIndex (key);
 
-    if (m_array[idx].first == key && m_array[idx].second != 0)
+    if (m_keys[idx] == key && m_values[idx] != 0 && !Expire (idx))
       {
-        value = m_array[idx].second;
-        bit = m_bits[idx];
-        m_bits[idx] = 1;
+        value = m_values[idx];
+        bit = TestBit (idx);
+        SetBit (idx);
+        Touch (idx);
         return true;
       }
 
@@ -95,12 +121,13 @@ public:
   PutIfNotEvict (K key, V value)
   {
     uint32_t idx = GetIndex (key);
-    if (m_array[idx].first != 0 && m_array[idx].first != key)
+    if (m_keys[idx] != 0 && m_keys[idx] != key && !Expire (idx))
       {
         return false;
       }
-    m_array[idx].first = key;
-    m_array[idx].second = value;
+    m_keys[idx] = key;
+    m_values[idx] = value;
+    Stamp (idx);
     return true;
   }
 
@@ -116,34 +143,146 @@ public:
   {
     uint32_t idx = GetIndex (key);
     bool eviction = false;
-    if (m_array[idx].first != 0 && m_array[idx].first != key)
+    if (m_keys[idx] != 0 && m_keys[idx] != key && !Expire (idx))
       {
-        evicted = m_array[idx];
+        evicted = std::make_pair (m_keys[idx], m_values[idx]);
         eviction = true;
       }
-    m_array[idx].first = key;
-    m_array[idx].second = value;
-    m_bits[idx] = 0;
+    m_keys[idx] = key;
+    m_values[idx] = value;
+    ClearBit (idx);
+    Stamp (idx);
     return eviction;
   }
 
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    uint32_t idx = GetIndex (key);
+    if (m_keys[idx] == 0 || m_keys[idx] == key || Expire (idx))
+      {
+        return false;
+      }
+    victim = m_keys[idx];
+    return true;
+  }
+
   void
   Remove (K key)
   {
     uint32_t idx = GetIndex (key);
-    NS_ASSERT (m_array[idx].first == key);
-    m_array[idx].first = 0;
-    m_array[idx].second = 0;
-    m_bits[idx] = 0;
+    assert (m_keys[idx] == key);
+    m_keys[idx] = 0;
+    m_values[idx] = 0;
+    ClearBit (idx);
+  }
+
+  /// The number of slots with an access bit.
+  size_t
+  GetSlots () const
+  {
+    return m_cacheSize;
+  }
+
+  /// Clears the access bits of \p count slots starting at slot \p first, a word at a time.
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    size_t end = first + count;
+    while (first < end && (first & 63))
+      {
+        ClearBit (first++);
+      }
+    if (end - first >= 64)
+      {
+        m_bits.Clear (first >> 6, (end - first) >> 6);
+        first += (end - first) & ~(size_t) 63;
+      }
+    while (first < end)
+      {
+        ClearBit (first++);
+      }
+  }
+
+  /// Clears the expired entries of \p count slots starting at slot \p first, returns how many.
+  size_t
+  Expire (size_t first, size_t count)
+  {
+    size_t expired = 0;
+    for (size_t end = first + count; first < end; first++)
+      {
+        expired += m_keys[first] != 0 && Expire (first);
+      }
+    return expired;
+  }
+
+  /// The entries cleared since Setup because they timed out.
+  uint64_t
+  GetExpirations () const
+  {
+    return m_expirations;
   }
 
 private:
+  /// Clears the entry of slot \p idx if it timed out.
+  bool
+  Expire (size_t idx)
+  {
+    if (!(m_idleTicks > 0 && (uint16_t) (m_now - m_accessed[idx]) >= m_idleTicks) &&
+        !(m_hardTicks > 0 && (uint16_t) (m_now - m_inserted[idx]) >= m_hardTicks))
+      {
+        return false;
+      }
+    m_keys[idx] = 0;
+    m_values[idx] = 0;
+    ClearBit (idx);
+    m_expirations++;
+    return true;
+  }
+
+  void
+  Touch (size_t idx)
+  {
+    if (m_idleTicks > 0)
+      {
+        m_accessed[idx] = m_now;
+      }
+  }
+
+  void
+  Stamp (size_t idx)
+  {
+    Touch (idx);
+    if (m_hardTicks > 0)
+      {
+        m_inserted[idx] = m_now;
+      }
+  }
+
   uint32_t
   GetIndex (K key)
   {
-    m_buffer[0] = key;
-    return CRC32Calculate ((uint8_t *) m_buffer, 2 * sizeof (K)) % m_cacheSize;
+    return m_index.Reduce (Hash::Hash (key, m_seed));
+  }
+
+  uint8_t
+  TestBit (size_t idx) const
+  {
+    return (m_bits[idx >> 6] >> (idx & 63)) & 1;
+  }
+
+  void
+  SetBit (size_t idx)
+  {
+    m_bits[idx >> 6] |= 1ULL << (idx & 63);
+  }
+
+  void
+  ClearBit (size_t idx)
+  {
+    m_bits[idx >> 6] &= ~(1ULL << (idx & 63));
   }
 };
 
-#endif /* P4_CACHE_H */
\ No newline at end of file
+#endif /* P4_CACHE_H */
@@ -0,0 +1,404 @@
+#ifndef P4_CUCKOO_CACHE_H
+#define P4_CUCKOO_CACHE_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "aligned-array.h"
+#include "cache-hash.h"
+
+using std::pair;
+using std::vector;
+
+/**
+ * Cuckoo-hashed counterpart of P4Cache.
+ *
+ * Every key has two candidate slots. A key whose slots are both taken moves
+ * one occupant to its other slot, which may move another, for at most
+ * maxKicks moves. Only when the chain fails is an entry evicted, after the
+ * stash (a few fully associative slots past the table) is full. The evicted
+ * entry is the one at the end of the chain, so evictions reflect capacity
+ * pressure rather than single-slot conflicts.
+ *
+ * An entry's access bit moves with it. Both chains are tried, and if both
+ * fail the one ending at a cold entry is preferred. A missed Get clears the
+ * bit of the key's first slot, like P4Cache does for its only slot.
+ */
+template <typename K, typename V, typename Hash = Crc32Hash>
+class P4CuckooCache
+{
+public:
+  static constexpr uint32_t STASH_SIZE = 4;
+  static constexpr uint32_t MAX_KICKS = 64;
+
+  size_t m_cacheSize;
+  uint32_t m_maxKicks;
+  AlignedArray<K> m_keys;
+  AlignedArray<V> m_values;
+  AlignedArray<uint8_t> m_bits;
+  K m_seed;
+  CacheIndex m_index;
+
+  P4CuckooCache ()
+      : m_cacheSize (0),
+        m_maxKicks (8),
+        m_seed (0)
+  {
+  }
+
+  /// Sizes the table to \p capacity slots, plus the stash.
+  void
+  Setup (int capacity, K seed = 0, uint32_t maxKicks = 8, bool hugePages = false)
+  {
+    assert (maxKicks <= MAX_KICKS && "Too many cuckoo kicks");
+    m_cacheSize = std::max (capacity, 1);
+    m_maxKicks = maxKicks;
+    m_index.SetSize (m_cacheSize);
+    m_keys.Allocate (m_cacheSize + STASH_SIZE, hugePages);
+    m_values.Allocate (m_cacheSize + STASH_SIZE, hugePages);
+    m_bits.Allocate (m_cacheSize + STASH_SIZE, hugePages);
+
+    m_seed = seed;
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    if (slot >= 0)
+      {
+        value = m_values[slot];
+        m_bits[slot] = 1;
+        return true;
+      }
+
+    m_bits[slots[0]] = 0;
+    return false;
+  }
+
+  /// The bit of the key, or for an absent key 1 if both its slots hold hot entries.
+  uint8_t
+  GetBit (K key)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    if (slot >= 0)
+      {
+        return m_bits[slot];
+      }
+    return IsHot (slots[0]) && IsHot (slots[1]);
+  }
+
+  bool
+  Find (K key)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    return FindSlot (key, slots) >= 0;
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    if (slot >= 0)
+      {
+        value = m_values[slot];
+        bit = m_bits[slot];
+        m_bits[slot] = 1;
+        return true;
+      }
+
+    return false;
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    if (slot >= 0)
+      {
+        m_values[slot] = value;
+        return true;
+      }
+
+    Path path;
+    if (!FindPath (slots, path) && (slot = FindFreeStash ()) < 0)
+      {
+        return false;
+      }
+
+    if (slot >= 0)
+      {
+        Store (slot, key, value);
+      }
+    else
+      {
+        Shift (path);
+        Store (path.slots[0], key, value);
+      }
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    Put (key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    if (slot >= 0)
+      {
+        m_values[slot] = value;
+        m_bits[slot] = 0;
+        return false;
+      }
+
+    Path path;
+    bool eviction = false;
+    if (!FindPath (slots, path))
+      {
+        // The chain ends at an occupied slot, its entry goes to the stash or is evicted
+        size_t last = path.slots[path.length - 1];
+        int64_t stash = FindFreeStash ();
+        if (stash >= 0)
+          {
+            Store (stash, m_keys[last], m_values[last]);
+            m_bits[stash] = m_bits[last];
+          }
+        else
+          {
+            evicted = std::make_pair (m_keys[last], m_values[last]);
+            eviction = true;
+          }
+      }
+
+    Shift (path);
+    Store (path.slots[0], key, value);
+    return eviction;
+  }
+
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    Path path;
+    if (FindSlot (key, slots) >= 0 || FindPath (slots, path) || FindFreeStash () >= 0)
+      {
+        return false;
+      }
+    victim = m_keys[path.slots[path.length - 1]];
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    size_t slots[2];
+    GetCandidates (key, slots);
+    int64_t slot = FindSlot (key, slots);
+    assert (slot >= 0);
+    Clear (slot);
+    if ((size_t) slot < m_cacheSize)
+      {
+        DrainStash (slot);
+      }
+  }
+
+  /// The number of slots with an access bit.
+  size_t
+  GetSlots () const
+  {
+    return m_cacheSize + STASH_SIZE;
+  }
+
+  /// Clears the access bits of \p count slots starting at slot \p first.
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    m_bits.Clear (first, count);
+  }
+
+private:
+  /// Slots visited by a displacement chain, the new key goes to slots[0].
+  struct Path
+  {
+    size_t slots[MAX_KICKS + 1];
+    uint32_t length;
+  };
+
+  void
+  GetCandidates (K key, size_t slots[2])
+  {
+    uint32_t hash = Hash::Hash (key, m_seed);
+    slots[0] = m_index.Reduce (hash);
+    slots[1] = m_index.Reduce ((uint32_t) ((hash * 0x9E3779B97F4A7C15ULL) >> 32));
+  }
+
+  int64_t
+  FindSlot (K key, const size_t slots[2])
+  {
+    for (int i = 0; i < 2; ++i)
+      {
+        if (m_keys[slots[i]] == key && m_values[slots[i]] != 0)
+          {
+            return slots[i];
+          }
+      }
+    for (size_t i = m_cacheSize; i < m_cacheSize + STASH_SIZE; ++i)
+      {
+        if (m_keys[i] == key && m_values[i] != 0)
+          {
+            return i;
+          }
+      }
+    return -1;
+  }
+
+  int64_t
+  FindFreeStash ()
+  {
+    for (size_t i = m_cacheSize; i < m_cacheSize + STASH_SIZE; ++i)
+      {
+        if (m_values[i] == 0)
+          {
+            return i;
+          }
+      }
+    return -1;
+  }
+
+  bool
+  IsHot (size_t slot)
+  {
+    return m_values[slot] != 0 && m_bits[slot] == 1;
+  }
+
+  /// Follows the chain starting at \p start. Returns true if it ends at an empty slot.
+  bool
+  Walk (size_t start, Path &path)
+  {
+    path.length = 0;
+    size_t slot = start;
+    while (true)
+      {
+        path.slots[path.length++] = slot;
+        if (m_values[slot] == 0)
+          {
+            return true;
+          }
+        if (path.length > m_maxKicks)
+          {
+            return false;
+          }
+
+        size_t alternatives[2];
+        GetCandidates (m_keys[slot], alternatives);
+        size_t next = alternatives[0] == slot ? alternatives[1] : alternatives[0];
+        if (std::find (path.slots, path.slots + path.length, next) != path.slots + path.length)
+          {
+            return false;
+          }
+        slot = next;
+      }
+  }
+
+  /// Picks the shorter successful chain, or the failed chain ending at a cold entry.
+  bool
+  FindPath (const size_t slots[2], Path &path)
+  {
+    bool found = Walk (slots[0], path);
+    if (slots[1] == slots[0] || (found && path.length == 1))
+      {
+        return found;
+      }
+
+    Path other;
+    bool otherFound = Walk (slots[1], other);
+    bool useOther;
+    if (found || otherFound)
+      {
+        useOther = otherFound && (!found || other.length < path.length);
+      }
+    else
+      {
+        useOther = m_bits[path.slots[path.length - 1]] == 1 &&
+                   m_bits[other.slots[other.length - 1]] == 0;
+      }
+
+    if (useOther)
+      {
+        path = other;
+      }
+    return found || otherFound;
+  }
+
+  /// Moves every entry of the chain one step further, freeing path.slots[0].
+  void
+  Shift (const Path &path)
+  {
+    for (uint32_t i = path.length - 1; i > 0; --i)
+      {
+        m_keys[path.slots[i]] = m_keys[path.slots[i - 1]];
+        m_values[path.slots[i]] = m_values[path.slots[i - 1]];
+        m_bits[path.slots[i]] = m_bits[path.slots[i - 1]];
+      }
+  }
+
+  void
+  Store (size_t slot, K key, V value)
+  {
+    m_keys[slot] = key;
+    m_values[slot] = value;
+    m_bits[slot] = 0;
+  }
+
+  void
+  Clear (size_t slot)
+  {
+    m_keys[slot] = 0;
+    m_values[slot] = 0;
+    m_bits[slot] = 0;
+  }
+
+  /// Moves a stashed entry that hashes to the freed \p slot back into the table.
+  void
+  DrainStash (size_t slot)
+  {
+    for (size_t i = m_cacheSize; i < m_cacheSize + STASH_SIZE; ++i)
+      {
+        if (m_values[i] == 0)
+          {
+            continue;
+          }
+
+        size_t slots[2];
+        GetCandidates (m_keys[i], slots);
+        if (slots[0] == slot || slots[1] == slot)
+          {
+            m_keys[slot] = m_keys[i];
+            m_values[slot] = m_values[i];
+            m_bits[slot] = m_bits[i];
+            Clear (i);
+            return;
+          }
+      }
+  }
+};
+
+#endif /* P4_CUCKOO_CACHE_H */
@@ -0,0 +1,324 @@
+#ifndef P4_SET_ASSOC_CACHE_H
+#define P4_SET_ASSOC_CACHE_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "cache-hash.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using std::pair;
+using std::vector;
+
+/**
+ * N-way set-associative counterpart of P4Cache.
+ *
+ * The hashed index selects a set of 2/4/8 ways instead of a single slot. The
+ * keys of a set are packed next to each other so a lookup is a single SIMD
+ * compare over the set. Replacement is a per-set CLOCK over the access bits:
+ * empty ways are used first, then the first way whose bit is clear, starting at
+ * the set's hand and clearing bits on the way. A missed Get advances the hand,
+ * which mirrors how P4Cache clears the slot bit on a miss.
+ */
+template <typename K, typename V, typename Hash = Crc32Hash>
+class P4SetAssocCache
+{
+public:
+  static constexpr uint32_t MAX_WAYS = 8;
+
+  size_t m_cacheSize, m_numSets;
+  uint32_t m_ways;
+  vector<K> m_keys;
+  vector<V> m_values;
+  vector<uint8_t> m_bits;
+  vector<uint8_t> m_hands;
+  K m_seed;
+  CacheIndex m_index;
+
+  P4SetAssocCache ()
+      : m_cacheSize (0),
+        m_numSets (0),
+        m_ways (1),
+        m_seed (0)
+  {
+  }
+
+  /// Sizes the cache to at most \p capacity entries, i.e. capacity / ways sets.
+  void
+  Setup (int capacity, uint32_t ways, K seed = 0)
+  {
+    assert ((ways == 1 || ways == 2 || ways == 4 || ways == MAX_WAYS) &&
+            "Unsupported associativity");
+    m_ways = ways;
+    m_numSets = std::max<size_t> (1, capacity / ways);
+    m_cacheSize = m_numSets * m_ways;
+    m_index.SetSize (m_numSets);
+    // Pad the key array so the vector compare of the last set stays in bounds
+    m_keys.assign (m_cacheSize + MAX_WAYS, 0);
+    m_values.assign (m_cacheSize, 0);
+    m_bits.assign (m_cacheSize, 0);
+    m_hands.assign (m_numSets, 0);
+
+    m_seed = seed;
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    size_t base = GetSetBase (key);
+    int way = FindWay (base, key);
+    if (way >= 0)
+      {
+        value = m_values[base + way];
+        m_bits[base + way] = 1;
+        return true;
+      }
+
+    AdvanceHand (base);
+    return false;
+  }
+
+  uint8_t
+  GetBit (K key)
+  {
+    size_t base = GetSetBase (key);
+    int way = FindWay (base, key);
+    if (way >= 0)
+      {
+        return m_bits[base + way];
+      }
+
+    return PeekVictim (base) < 0 ? 1 : 0;
+  }
+
+  bool
+  Find (K key)
+  {
+    return FindWay (GetSetBase (key), key) >= 0;
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    size_t base = GetSetBase (key);
+    int way = FindWay (base, key);
+    if (way >= 0)
+      {
+        value = m_values[base + way];
+        bit = m_bits[base + way];
+        m_bits[base + way] = 1;
+        return true;
+      }
+
+    return false;
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    size_t base = GetSetBase (key);
+    int way = FindWay (base, key);
+    if (way < 0)
+      {
+        way = FindEmptyWay (base);
+      }
+    if (way < 0)
+      {
+        return false;
+      }
+
+    m_keys[base + way] = key;
+    m_values[base + way] = value;
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    Put (key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    size_t base = GetSetBase (key);
+    bool eviction = false;
+    int way = FindWay (base, key);
+    if (way < 0)
+      {
+        way = FindEmptyWay (base);
+      }
+    if (way < 0)
+      {
+        way = SelectVictim (base);
+        evicted = std::make_pair (m_keys[base + way], m_values[base + way]);
+        eviction = true;
+      }
+
+    m_keys[base + way] = key;
+    m_values[base + way] = value;
+    m_bits[base + way] = 0;
+    return eviction;
+  }
+
+  /// The key a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    size_t base = GetSetBase (key);
+    if (FindWay (base, key) >= 0 || FindEmptyWay (base) >= 0)
+      {
+        return false;
+      }
+
+    // With every way hot, SelectVictim clears a full round and stops at the hand
+    int way = PeekVictim (base);
+    victim = m_keys[base + (way >= 0 ? way : m_hands[base / m_ways])];
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    size_t base = GetSetBase (key);
+    int way = FindWay (base, key);
+    assert (way >= 0);
+    m_keys[base + way] = 0;
+    m_values[base + way] = 0;
+    m_bits[base + way] = 0;
+  }
+
+  /// The number of slots with an access bit.
+  size_t
+  GetSlots () const
+  {
+    return m_cacheSize;
+  }
+
+  /// Clears the access bits of \p count slots starting at slot \p first.
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    std::fill (m_bits.begin () + first, m_bits.begin () + first + count, 0);
+  }
+
+private:
+  size_t
+  GetSetBase (K key)
+  {
+    return m_index.Reduce (Hash::Hash (key, m_seed)) * m_ways;
+  }
+
+  /// Bitmask of the ways in the set at \p base whose key equals \p key.
+  uint32_t
+  MatchKeys (size_t base, K key) const
+  {
+#if defined(__SSE2__)
+    if (sizeof (K) == sizeof (uint32_t))
+      {
+        const K *keys = &m_keys[base];
+        uint32_t mask;
+#if defined(__AVX2__)
+        __m256i needle = _mm256_set1_epi32 ((int) key);
+        __m256i lanes = _mm256_loadu_si256 ((const __m256i *) keys);
+        mask = _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (lanes, needle)));
+#else
+        __m128i needle = _mm_set1_epi32 ((int) key);
+        __m128i lo = _mm_loadu_si128 ((const __m128i *) keys);
+        mask = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (lo, needle)));
+        if (m_ways > 4)
+          {
+            __m128i hi = _mm_loadu_si128 ((const __m128i *) (keys + 4));
+            mask |= _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (hi, needle))) << 4;
+          }
+#endif
+        return mask & ((1u << m_ways) - 1);
+      }
+#endif
+    uint32_t mask = 0;
+    for (uint32_t way = 0; way < m_ways; ++way)
+      {
+        mask |= (uint32_t) (m_keys[base + way] == key) << way;
+      }
+    return mask;
+  }
+
+  int
+  FindWay (size_t base, K key) const
+  {
+    uint32_t mask = MatchKeys (base, key);
+    while (mask)
+      {
+        int way = __builtin_ctz (mask);
+        if (m_values[base + way] != 0)
+          {
+            return way;
+          }
+        mask &= mask - 1;
+      }
+    return -1;
+  }
+
+  int
+  FindEmptyWay (size_t base) const
+  {
+    for (uint32_t way = 0; way < m_ways; ++way)
+      {
+        if (m_values[base + way] == 0)
+          {
+            return way;
+          }
+      }
+    return -1;
+  }
+
+  /// The way SelectVictim would pick without touching any state, or -1 if all are hot.
+  int
+  PeekVictim (size_t base) const
+  {
+    int way = FindEmptyWay (base);
+    if (way >= 0)
+      {
+        return way;
+      }
+
+    uint32_t set = base / m_ways;
+    for (uint32_t i = 0; i < m_ways; ++i)
+      {
+        uint32_t candidate = (m_hands[set] + i) % m_ways;
+        if (m_bits[base + candidate] == 0)
+          {
+            return candidate;
+          }
+      }
+    return -1;
+  }
+
+  int
+  SelectVictim (size_t base)
+  {
+    uint32_t set = base / m_ways;
+    while (m_bits[base + m_hands[set]] == 1)
+      {
+        AdvanceHand (base);
+      }
+
+    int way = m_hands[set];
+    m_hands[set] = (m_hands[set] + 1) % m_ways;
+    return way;
+  }
+
+  void
+  AdvanceHand (size_t base)
+  {
+    uint32_t set = base / m_ways;
+    m_bits[base + m_hands[set]] = 0;
+    m_hands[set] = (m_hands[set] + 1) % m_ways;
+  }
+};
+
+#endif /* P4_SET_ASSOC_CACHE_H */
@@ -11,13 +11,17 @@ public:
   P4SwitchAppHelper (vector<Ipv4Address> &gwAddresses, Ipv4Address switchAddress,
                      enum P4SwitchApp::SwitchType switchType,
                      enum SimulationParameters::Mode simMode, uint32_t podCount,
-                     unordered_map<uint32_t, uint32_t> &virtualToPhysical)
+                     uint32_t coreCount,
+                     unordered_map<uint32_t, uint32_t> &virtualToPhysical,
+                     const HostLocators &hostLocators)
       : m_gwAddresses (gwAddresses),
         m_switchAddress (switchAddress),
         m_switchType (switchType),
         m_simMode (simMode),
         m_podCount (podCount),
-        m_virtualToPhysical (virtualToPhysical)
+        m_coreCount (coreCount),
+        m_virtualToPhysical (virtualToPhysical),
+        m_hostLocators (hostLocators)
   {
     m_factory.SetTypeId (P4SwitchApp::GetTypeId ());
   }
@@ -45,8 +49,8 @@ private:
   InstallPriv (Ptr<Node> node) const
   {
     Ptr<P4SwitchApp> app = m_factory.Create<P4SwitchApp> ();
-    app->Setup (m_gwAddresses, m_switchAddress, m_switchType, m_simMode, m_podCount,
-                &m_virtualToPhysical);
+    app->Setup (m_gwAddresses, m_switchAddress, m_switchType, m_simMode, m_podCount, m_coreCount,
+                &m_virtualToPhysical, m_hostLocators);
     node->AddApplication (app);
 
     return app;
@@ -56,8 +60,9 @@ private:
   Ipv4Address m_switchAddress;
   enum P4SwitchApp::SwitchType m_switchType;
   enum SimulationParameters::Mode m_simMode;
-  uint32_t m_podCount;
+  uint32_t m_podCount, m_coreCount;
   unordered_map<uint32_t, uint32_t> &m_virtualToPhysical;
+  HostLocators m_hostLocators;
 };
 
 #endif /* P4_SWITCH_APP_HELPER_H */
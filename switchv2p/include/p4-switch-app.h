@@ -4,23 +4,32 @@
 #include "ns3/applications-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
-#include "lru-cache.h"
-#include "p4-cache.h"
+#include "cache-policy-checker.h"
 #include "bloom-filter.h"
+#include "tinylfu.h"
+#include "consistent-hash-ring.h"
 #include "sim-parameters.h"
+#include "control-tag.h"
+#include "eviction-tag.h"
 #include <set>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace ns3;
 using std::set;
+using std::string;
 using std::unordered_map;
+using std::unordered_set;
 using std::vector;
 
 class P4SwitchApp : public Application
 {
 public:
   enum SwitchType { LEAF, GW_LEAF, GW_SPINE, SPINE, CORE };
+  /// The UDP port of the control packets to switches.
+  static const uint16_t SWITCH_PORT;
   P4SwitchApp ();
 
   /**
@@ -28,19 +37,117 @@ public:
    * \return The TypeId.
    */
   static TypeId GetTypeId (void);
+
+  /**
+   * TracedCallback signature for admission decisions.
+   * \param [in] switchId The switch.
+   * \param [in] admitted Whether the admission filter admitted the learn.
+   */
+  typedef void (*AdmissionTracedCallback) (uint32_t switchId, bool admitted);
+  /**
+   * TracedCallback signature for sent control packets.
+   * \param [in] packet The control packet.
+   * \param [in] wait The wait of its oldest mapping.
+   */
+  typedef void (*ControlPacketTracedCallback) (Ptr<const Packet> packet, Time wait);
+  /**
+   * TracedCallback signature for GenerateProbability updates.
+   * \param [in] switchId The gateway leaf.
+   * \param [in] probability The new GenerateProbability.
+   */
+  typedef void (*GenerateProbabilityTracedCallback) (uint32_t switchId, double probability);
+  /**
+   * TracedCallback signature for forwarded, installed and hit victims.
+   * \param [in] switchId The switch.
+   */
+  typedef void (*VictimTracedCallback) (uint32_t switchId);
+  /**
+   * TracedCallback signature for stale entries and stale hits.
+   * \param [in] switchId The switch.
+   */
+  typedef void (*StaleEntryTracedCallback) (uint32_t switchId);
+  /**
+   * TracedCallback signature for source-learned mappings.
+   * \param [in] vip The source VIP.
+   * \param [in] switchAddress The leaf that learned it.
+   */
+  typedef void (*SourceLearnedTracedCallback) (uint32_t vip, Ipv4Address switchAddress);
+
   void Setup (vector<Ipv4Address> &gwAddresses, Ipv4Address switchAddress,
               enum SwitchType switchType, enum SimulationParameters::Mode simMode,
-              uint32_t podCount, unordered_map<uint32_t, uint32_t> *virtualToPhysical);
+              uint32_t podCount, uint32_t coreCount,
+              unordered_map<uint32_t, uint32_t> *virtualToPhysical,
+              const HostLocators &hostLocators);
+  /**
+   * Hands generated and relayed protocol packets to \p sendCallback instead of a
+   * UDP socket. The packet starts with its UDP header, followed by the source and
+   * destination addresses. Used by the CacheOnly replay, which has no network stack.
+   */
+  void SetSendCallback (Callback<void, Ptr<Packet>, Ipv4Address, Ipv4Address> sendCallback);
+  /// Runs the switch pipeline on a received packet. Returns false if the switch consumed it.
+  bool ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader);
+  /// The cache entries of this switch tier, with -1 resolved to MemoryBytes or MemorySize.
+  int GetMemorySize ();
+  /// The SRAM bytes of one cache entry of this switch.
+  uint32_t GetEntryBytes ();
+  enum SwitchType GetSwitchType ();
+  /// Whether the cache holds \p key.
+  bool IsCached (uint32_t key);
+  /// The cache entries cleared because they reached their idle or hard timeout.
+  uint64_t GetExpiredEntries ();
 
 private:
-  static const uint16_t SWITCH_PORT;
+  /// The mappings waiting for a control packet to one switch.
+  struct ControlBatch
+  {
+    ControlTag tag;
+    Time start;
+    EventId flushEvent;
+  };
+
+  static const uint32_t OWNER_SEED;
+  static const uint32_t VICTIM_SEED;
   virtual void StartApplication (void);
   virtual void StopApplication (void);
 
-  bool ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader);
-  bool HandleProtocolPacket (Ptr<Packet> packet, Ipv4Header &ipHeader);
-  bool LocalP4CacheLogic (uint32_t virtualDestinationIp, uint32_t physicalDestinationIp,
-                          Ptr<Packet> packet, Ipv4Header &ipHeader);
+  /// The CachePolicy of this switch tier, with Default resolved for the simulation mode.
+  enum CachePolicy GetCachePolicy ();
+  /// Whether the cache stores host locators, see CompactLocators.
+  bool UsesLocators ();
+  template <typename Cache>
+  bool ProcessWith (Ptr<Packet> packet, Ipv4Header &ipHeader);
+  template <typename Cache>
+  void InsertWith (uint32_t key, uint32_t value);
+  template <typename Cache>
+  bool FindWith (uint32_t key);
+  /// Clears the access bits under the aging hand and moves it forward.
+  template <typename Cache>
+  void AgeWith ();
+  Time GetAgingPeriod ();
+  /// Clears the expired entries under the expiry hand and moves it forward.
+  template <typename Cache>
+  void ExpireWith ();
+  template <typename Cache>
+  uint64_t GetExpiredWith ();
+  /// The idle and hard timeouts of this switch tier, in ExpiryTick ticks.
+  void GetExpiryTicks (uint16_t &idleTicks, uint16_t &hardTicks);
+  /// The coarse clock of the entry stamps, in ExpiryTick ticks.
+  uint16_t GetExpiryClock ();
+  /// Whether the admission filter lets \p key replace the entry a Put would evict.
+  template <typename Cache>
+  bool Admit (Cache &cache, uint32_t key);
+  /// Gets the entry of \p vip, unless it is from another epoch than the EpochTag of \p packet
+  /// expects. A stale entry is removed.
+  template <typename Cache>
+  bool GetCurrent (Cache &cache, uint32_t vip, uint32_t &value, Ptr<Packet> packet);
+  template <typename Cache>
+  bool ProcessPacket (Cache &cache, Ptr<Packet> packet, Ipv4Header &ipHeader);
+  template <typename Cache>
+  bool HandleProtocolPacket (Cache &cache, Ptr<Packet> packet, Ipv4Header &ipHeader);
+  template <typename Cache>
+  bool LocalP4CacheLogic (Cache &cache, uint32_t virtualDestinationIp,
+                          uint32_t physicalDestinationIp, Ptr<Packet> packet,
+                          Ipv4Header &ipHeader);
   void BluebirdProcessPacket (Ptr<Packet> packet);
 
   void PopulateBluebirdCache (uint32_t virtualIp);
@@ -48,35 +155,98 @@ private:
   void BluebirdTxComplete ();
   void ReceiveRawPacket (Ptr<Socket> socket);
 
-  bool BluebirdLogic (uint32_t virtualDestinationIp, uint32_t physicalDestinationIp,
+  template <typename Cache>
+  bool BluebirdLogic (Cache &cache, uint32_t virtualDestinationIp, uint32_t physicalDestinationIp,
                       Ptr<Packet> packet, Ipv4Header &ipHeader);
+  void AgeBloomFilter ();
   void GeneratePacketToLeaf (pair<uint32_t, uint32_t> data, Ipv4Address hostAddress);
   void GeneratePacketToAddress (pair<uint32_t, uint32_t> data, Ipv4Address dstAddress,
-                                bool learning);
+                                bool learning, uint8_t victimHops = 0);
+  /// Sends a victim of this switch to a peer picked by hash, on hop \p hops of at most
+  /// VictimHopLimit.
+  void ForwardVictim (pair<uint32_t, uint32_t> victim, uint8_t hops);
+  void UpdateGenerateProbability ();
+  /// The offset of the spine of a pod that owns \p vip with ExclusiveSpines.
+  uint32_t GetOwnerSpine (uint32_t vip);
+  /// The core that owns \p vip on the CoreRing.
+  uint32_t GetOwnerCore (uint32_t vip);
+  /// Whether this switch may cache \p vip, false only for spines and cores that do not own it.
+  bool IsOwner (uint32_t vip);
+  /// Sends a gateway lookup leaving the pod of this spine through the core that owns \p vip.
+  void SteerToCore (Ptr<Packet> packet, Ipv4Header &ipHeader, uint32_t vip);
+  /// Sends a packet leaving this leaf through the spine that owns \p vip.
+  void SteerToOwner (Ptr<Packet> packet, Ipv4Header &ipHeader, uint32_t vip);
+  /// Sends the batched mappings of \p key, a switch address, the victim hops and the learning
+  /// bit.
+  void FlushControlBatch (uint64_t key);
+  /// Puts \p tag back on \p packet unless all of its entries were learned.
+  void AddEvictionTag (Ptr<Packet> packet, EvictionTag &tag);
+  void SendToSwitch (Ptr<Packet> packet, Ipv4Address dstAddress);
 
   QueueSize m_bluebirdQueueSize;
   Ptr<Queue<Packet>> m_bluebirdQueue;
   DataRate m_bps;
-  Time m_bluebirdDelay, m_bluebirdProgrammingDelay;
-  LRUCache<uint32_t, uint32_t> m_bluebirdCache;
-  P4Cache<uint32_t, uint32_t> m_cache;
+  Time m_bluebirdDelay, m_bluebirdProgrammingDelay, m_bloomFilterEpoch, m_bloomFilterRotation;
+  SwitchCaches<uint32_t, uint32_t, SwitchCacheHash> m_caches;
+  bool (P4SwitchApp::*m_packetHandler) (Ptr<Packet> packet, Ipv4Header &ipHeader);
+  void (P4SwitchApp::*m_insertHandler) (uint32_t key, uint32_t value);
+  bool (P4SwitchApp::*m_findHandler) (uint32_t key);
+  void (P4SwitchApp::*m_agingHandler) ();
+  void (P4SwitchApp::*m_expiryHandler) ();
+  uint64_t (P4SwitchApp::*m_expiredHandler) ();
+  Time m_leafAgingPeriod, m_spineAgingPeriod, m_coreAgingPeriod, m_agingStep,
+      m_controlBatchTimeout;
+  Time m_leafIdleTimeout, m_spineIdleTimeout, m_coreIdleTimeout, m_leafHardTimeout,
+      m_spineHardTimeout, m_coreHardTimeout, m_expiryTick;
+  EventId m_agingEvent, m_expiryEvent, m_generateProbEvent;
+  size_t m_agingHand, m_expiryHand;
+  uint16_t m_idleTicks, m_hardTicks;
+  enum CachePolicy m_cachePolicy, m_leafCachePolicy, m_spineCachePolicy, m_coreCachePolicy;
   BloomFilter<uint32_t> m_bloomFilter;
+  TinyLfu<uint32_t, SwitchCacheHash> m_admission;
   set<uint32_t> m_gwAddresses;
-  int m_memorySize, m_bloomFilterSize;
+  ConsistentHashRing m_coreOwners;
+  string m_removedCores;
+  int m_memorySize, m_memoryBytes, m_bloomFilterSize, m_admissionMemorySize;
+  int m_leafMemorySize, m_gwLeafMemorySize, m_spineMemorySize, m_gwSpineMemorySize,
+      m_coreMemorySize;
+  uint32_t m_bloomFilterEntries;
+  double m_bloomFilterFpr;
   enum SwitchType m_switchType;
   Ipv4Address m_switchAddress;
   bool m_randomHash, m_sourceLearning, m_accessBit, m_bloomFilterEnabled, m_generateInvalidation,
-      m_bluebirdBusy;
+      m_bluebirdBusy, m_hugePages, m_compactLocators, m_adaptiveGenerateProb,
+      m_exclusiveSpines, m_coreRing, m_victimForwarding;
   enum SimulationParameters::Mode m_simMode;
   Ptr<Socket> m_socket;
+  Callback<void, Ptr<Packet>, Ipv4Address, Ipv4Address> m_sendCallback;
   vector<Ptr<Socket>> m_bluebirdSockets;
   Ptr<UniformRandomVariable> m_random;
-  uint32_t m_podCount, m_defaultTtl;
-  double m_generateProb;
+  /// Draws the hash seed. It is created with the switch, as the P4Cache generator it replaces
+  /// was, so the other random streams keep their numbers.
+  Ptr<UniformRandomVariable> m_hashRandom;
+  uint32_t m_podCount, m_podWidth, m_coresPerSpine, m_defaultTtl, m_associativity,
+      m_cuckooMaxKicks, m_admissionSampleSize, m_evictionTagEntries, m_controlBatchSize,
+      m_coreRingVirtualNodes, m_victimHopLimit;
+  double m_generateProb, m_minGenerateProb, m_maxGenerateProb;
+  Time m_generateProbInterval;
+  /// Gateway-bound packets since the last GenerateProbability update, and those that missed
+  uint64_t m_gatewayLookups, m_gatewayMisses;
   TracedCallback<Ptr<const Packet>> m_learningTrace, m_invalidationTrace;
-  TracedCallback<Ptr<const Packet>, uint32_t> m_processedPackets, m_cacheHit;
+  TracedCallback<Ptr<const Packet>, uint32_t> m_processedPackets, m_cacheHit, m_steeredTrace;
+  TracedCallback<uint32_t, bool> m_admissionTrace;
+  TracedCallback<Ptr<const Packet>, Time> m_controlTrace;
+  TracedCallback<uint32_t, double> m_generateProbTrace;
+  TracedCallback<uint32_t> m_victimForwardedTrace, m_victimInstalledTrace, m_victimHitTrace,
+      m_staleEntryTrace, m_staleHitTrace;
+  TracedCallback<uint32_t, Ipv4Address> m_sourceLearnedTrace;
+  /// The cores and gateway-pod spines a core or a gateway-pod spine forwards its victims to
+  vector<Ipv4Address> m_victimPeers;
+  /// Forwarded victims this switch installed that did not hit yet
+  unordered_set<uint32_t> m_installedVictims;
   unordered_map<uint32_t, uint32_t> *m_virtualToPhysical;
   unordered_map<uint64_t, Ptr<Socket>> m_packetToSocket;
+  unordered_map<uint64_t, ControlBatch> m_controlBatches;
 };
 
 #endif /* P4_SWITCH_APP_H */
\ No newline at end of file
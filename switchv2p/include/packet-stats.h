@@ -25,4 +25,17 @@ public:
   uint64_t count, disorder;
 };
 
+class MigrationStats
+{
+public:
+  MigrationStats () : misdelivered (0), gatewayBefore (0), gatewayAfter (0), lastMisdelivered (0)
+  {
+  }
+  uint64_t misdelivered;
+  /// Gateway packets of the VM in the window before and after the event
+  uint64_t gatewayBefore, gatewayAfter;
+  /// Nanoseconds
+  uint64_t lastMisdelivered;
+};
+
 #endif /* PACKET_STATS_H */
\ No newline at end of file
@@ -0,0 +1,378 @@
+#ifndef RANGE_CACHE_H
+#define RANGE_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+using std::map;
+using std::pair;
+using std::vector;
+
+/**
+ * LRU cache of key ranges, modelled after a range-match table.
+ *
+ * An entry maps every key of [first, last] to one value. Learning a key next
+ * to an entry with the same value grows that entry instead of taking a new
+ * one, and entries that become adjacent are merged, so consecutive keys with
+ * one value (the containers of a host) share an entry. Writing or removing a
+ * key inside an entry splits it. Entries are ordered by their first key for
+ * lookup and threaded on a recency list for replacement. The capacity counts
+ * entries, not keys.
+ */
+template <typename K, typename V>
+class RangeCache
+{
+public:
+  RangeCache () : m_cacheSize (0), m_head (NIL), m_tail (NIL), m_evictedLast (0)
+  {
+  }
+
+  void
+  Setup (int capacity)
+  {
+    m_cacheSize = std::max (capacity, 1);
+    m_entries.assign (m_cacheSize, Entry ());
+    m_free.clear ();
+    for (uint32_t slot = m_cacheSize; slot > 0; --slot)
+      {
+        m_free.push_back (slot - 1);
+      }
+    m_ranges.clear ();
+    m_head = m_tail = NIL;
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    uint32_t slot = Lookup (key);
+    if (slot == NIL)
+      {
+        return false;
+      }
+
+    MoveToFront (slot);
+    value = m_entries[slot].value;
+    m_entries[slot].bit = 1;
+    return true;
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    uint32_t slot = Lookup (key);
+    if (slot == NIL)
+      {
+        return false;
+      }
+
+    MoveToFront (slot);
+    value = m_entries[slot].value;
+    bit = m_entries[slot].bit;
+    m_entries[slot].bit = 1;
+    return true;
+  }
+
+  /// The bit of the entry holding the key, or for an absent key the bit of the next victim.
+  uint8_t
+  GetBit (K key)
+  {
+    uint32_t slot = Lookup (key);
+    if (slot != NIL)
+      {
+        return m_entries[slot].bit;
+      }
+    return m_free.empty () ? m_entries[m_tail].bit : 0;
+  }
+
+  bool
+  Find (K key)
+  {
+    return Lookup (key) != NIL;
+  }
+
+  /// The range of the entry holding \p key, if any.
+  bool
+  GetRange (K key, K &first, K &last)
+  {
+    uint32_t slot = Lookup (key);
+    if (slot == NIL)
+      {
+        return false;
+      }
+    first = m_entries[slot].first;
+    last = m_entries[slot].last;
+    return true;
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    if (m_free.empty () && !Find (key) && !Joins (key, key, value))
+      {
+        return false;
+      }
+    Put (key, value);
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    PutRange (key, key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    return PutRange (key, key, value, evicted);
+  }
+
+  /**
+   * Maps every key of [first, last] to \p value. On eviction, \p evicted holds
+   * the first key and value of the evicted entry and GetEvictedLast its last key.
+   */
+  bool
+  PutRange (K first, K last, V value, pair<K, V> &evicted)
+  {
+    uint32_t slot = Lookup (first);
+    if (slot != NIL && m_entries[slot].value == value && m_entries[slot].last >= last)
+      {
+        m_entries[slot].bit = 0;
+        MoveToFront (slot);
+        return false;
+      }
+
+    Cut (first, last);
+    uint32_t left = first != 0 ? Lookup (first - 1) : NIL;
+    uint32_t right = last != std::numeric_limits<K>::max () ? Lookup (last + 1) : NIL;
+    bool joinLeft = left != NIL && m_entries[left].value == value;
+    bool joinRight = right != NIL && m_entries[right].value == value;
+    bool eviction = false;
+    if (joinLeft && joinRight)
+      {
+        m_entries[left].last = m_entries[right].last;
+        Release (right);
+        slot = left;
+      }
+    else if (joinLeft)
+      {
+        m_entries[left].last = last;
+        slot = left;
+      }
+    else if (joinRight)
+      {
+        m_ranges.erase (m_entries[right].first);
+        m_entries[right].first = first;
+        m_ranges[first] = right;
+        slot = right;
+      }
+    else
+      {
+        if (m_free.empty ())
+          {
+            Entry &victim = m_entries[m_tail];
+            evicted = std::make_pair (victim.first, victim.value);
+            m_evictedLast = victim.last;
+            Release (m_tail);
+            eviction = true;
+          }
+        slot = Acquire (first, last, value);
+      }
+
+    m_entries[slot].bit = 0;
+    MoveToFront (slot);
+    return eviction;
+  }
+
+  /// The last key of the entry evicted by the latest Put that evicted one.
+  K
+  GetEvictedLast () const
+  {
+    return m_evictedLast;
+  }
+
+  /// The first key of the entry a Put of \p key would evict, if any.
+  bool
+  GetVictim (K key, K &victim)
+  {
+    if (!m_free.empty () || Find (key))
+      {
+        return false;
+      }
+    victim = m_entries[m_tail].first;
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    Cut (key, key);
+  }
+
+  /// The number of slots with an access bit.
+  size_t
+  GetSlots () const
+  {
+    return m_cacheSize;
+  }
+
+  /// Clears the access bits of \p count slots starting at slot \p first.
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    for (size_t slot = first; slot < first + count; ++slot)
+      {
+        m_entries[slot].bit = 0;
+      }
+  }
+
+private:
+  static const uint32_t NIL = UINT32_MAX;
+
+  struct Entry
+  {
+    K first, last;
+    V value;
+    uint32_t prev, next;
+    uint8_t bit;
+  };
+
+  uint32_t
+  Lookup (K key) const
+  {
+    auto it = m_ranges.upper_bound (key);
+    if (it == m_ranges.begin ())
+      {
+        return NIL;
+      }
+    --it;
+    return m_entries[it->second].last >= key ? it->second : NIL;
+  }
+
+  /// Whether [first, last] would grow an adjacent entry with the same value.
+  bool
+  Joins (K first, K last, V value) const
+  {
+    uint32_t left = first != 0 ? Lookup (first - 1) : NIL;
+    uint32_t right = last != std::numeric_limits<K>::max () ? Lookup (last + 1) : NIL;
+    return (left != NIL && m_entries[left].value == value) ||
+           (right != NIL && m_entries[right].value == value);
+  }
+
+  /**
+   * Removes the keys [first, last] from every entry. An entry that keeps keys on
+   * both sides is split; if no slot is free for the second part, the shorter
+   * part is dropped instead of evicting another entry.
+   */
+  void
+  Cut (K first, K last)
+  {
+    auto it = m_ranges.upper_bound (first);
+    if (it != m_ranges.begin ())
+      {
+        --it;
+      }
+    while (it != m_ranges.end () && it->first <= last)
+      {
+        uint32_t slot = (it++)->second;
+        Entry &entry = m_entries[slot];
+        if (entry.last < first)
+          {
+            continue;
+          }
+
+        bool head = entry.first < first, tail = entry.last > last;
+        if (head && tail && !m_free.empty ())
+          {
+            uint32_t split = Acquire (last + 1, entry.last, entry.value);
+            m_entries[split].bit = entry.bit;
+            Unlink (split);
+            LinkAfter (split, slot);
+            entry.last = first - 1;
+          }
+        else if (head && (!tail || first - entry.first >= entry.last - last))
+          {
+            entry.last = first - 1;
+          }
+        else if (tail)
+          {
+            m_ranges.erase (entry.first);
+            entry.first = last + 1;
+            m_ranges[entry.first] = slot;
+          }
+        else
+          {
+            Release (slot);
+          }
+      }
+  }
+
+  uint32_t
+  Acquire (K first, K last, V value)
+  {
+    uint32_t slot = m_free.back ();
+    m_free.pop_back ();
+    Entry &entry = m_entries[slot];
+    entry.first = first;
+    entry.last = last;
+    entry.value = value;
+    entry.bit = 0;
+    entry.prev = entry.next = NIL;
+    LinkAfter (slot, NIL);
+    m_ranges[first] = slot;
+    return slot;
+  }
+
+  void
+  Release (uint32_t slot)
+  {
+    Unlink (slot);
+    m_ranges.erase (m_entries[slot].first);
+    m_entries[slot].bit = 0;
+    m_free.push_back (slot);
+  }
+
+  void
+  Unlink (uint32_t slot)
+  {
+    Entry &entry = m_entries[slot];
+    (entry.prev == NIL ? m_head : m_entries[entry.prev].next) = entry.next;
+    (entry.next == NIL ? m_tail : m_entries[entry.next].prev) = entry.prev;
+    entry.prev = entry.next = NIL;
+  }
+
+  /// Links \p slot after \p prev on the recency list, or at its head if \p prev is NIL.
+  void
+  LinkAfter (uint32_t slot, uint32_t prev)
+  {
+    Entry &entry = m_entries[slot];
+    entry.prev = prev;
+    entry.next = prev == NIL ? m_head : m_entries[prev].next;
+    (prev == NIL ? m_head : m_entries[prev].next) = slot;
+    (entry.next == NIL ? m_tail : m_entries[entry.next].prev) = slot;
+  }
+
+  void
+  MoveToFront (uint32_t slot)
+  {
+    if (m_head != slot)
+      {
+        Unlink (slot);
+        LinkAfter (slot, NIL);
+      }
+  }
+
+  size_t m_cacheSize;
+  vector<Entry> m_entries;
+  vector<uint32_t> m_free;
+  /// Entries by first key
+  map<K, uint32_t> m_ranges;
+  uint32_t m_head, m_tail;
+  K m_evictedLast;
+};
+
+#endif /* RANGE_CACHE_H */
@@ -0,0 +1,269 @@
+#ifndef S3FIFO_CACHE_H
+#define S3FIFO_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include "lru-cache.h"
+
+using std::pair;
+
+/**
+ * S3-FIFO cache (Yang et al., SOSP '23).
+ *
+ * New keys enter a small FIFO S holding 10% of the entries. Keys hit more than
+ * once while in S move to the main FIFO M on eviction, the others leave and are
+ * remembered in the ghost FIFO G. A key learned again while in G goes straight
+ * to M. M is a FIFO with reinsertion: an entry at its tail with a non-zero
+ * frequency is reinserted at the head with a decremented frequency. Hits only
+ * bump a 2-bit frequency, they never reorder the queues. The FIFOs are
+ * LRUCache instances that are only read through Peek.
+ */
+template <typename K, typename V>
+class S3FifoCache
+{
+public:
+  S3FifoCache () : m_cacheSize (0), m_smallSize (0)
+  {
+  }
+
+  void
+  Setup (int capacity)
+  {
+    m_cacheSize = std::max (capacity, 1);
+    m_smallSize = std::max<size_t> (m_cacheSize / 10, 1);
+    m_small.SetCapacity (m_cacheSize);
+    m_main.SetCapacity (m_cacheSize);
+    m_ghost.SetCapacity (std::max<size_t> (m_cacheSize - m_smallSize, 1));
+  }
+
+  bool
+  Get (K key, V &value)
+  {
+    uint8_t bit;
+    return Get (key, value, bit);
+  }
+
+  bool
+  Get (K key, V &value, uint8_t &bit)
+  {
+    Entry *entry = Lookup (key);
+    if (entry == nullptr)
+      {
+        return false;
+      }
+
+    value = entry->value;
+    bit = entry->bit;
+    entry->bit = 1;
+    entry->freq = std::min (entry->freq + 1, 3);
+    return true;
+  }
+
+  /// The bit of the key, or for an absent key the bit of the next queue tail to be evicted.
+  uint8_t
+  GetBit (K key)
+  {
+    Entry *entry = Lookup (key);
+    if (entry != nullptr)
+      {
+        return entry->bit;
+      }
+    if (GetSize () < m_cacheSize)
+      {
+        return 0;
+      }
+
+    LRUCache<K, Entry> &queue = EvictFromSmall () ? m_small : m_main;
+    return queue.Peek (queue.GetEvictionCandidate ())->bit;
+  }
+
+  bool
+  Find (K key)
+  {
+    return m_small.Find (key) || m_main.Find (key);
+  }
+
+  bool
+  PutIfNotEvict (K key, V value)
+  {
+    if (GetSize () == m_cacheSize && !Find (key))
+      {
+        return false;
+      }
+    Put (key, value);
+    return true;
+  }
+
+  void
+  Put (K key, V value)
+  {
+    pair<K, V> evicted;
+    Put (key, value, evicted);
+  }
+
+  bool
+  Put (K key, V value, pair<K, V> &evicted)
+  {
+    Entry *entry = Lookup (key);
+    if (entry != nullptr)
+      {
+        entry->value = value;
+        entry->bit = 0;
+        return false;
+      }
+
+    bool eviction = false;
+    if (GetSize () == m_cacheSize)
+      {
+        eviction = EvictFromSmall () ? EvictSmall (evicted) : EvictMain (evicted);
+      }
+
+    if (m_ghost.Find (key))
+      {
+        m_ghost.Remove (key);
+        m_main.Put (key, Entry{value, 0, 0});
+      }
+    else
+      {
+        m_small.Put (key, Entry{value, 0, 0});
+      }
+    return eviction;
+  }
+
+  /**
+   * The key a Put of \p key would most likely evict, if any. Promotions from S
+   * to M during the eviction are not simulated, a frequently hit tail of S
+   * reports the tail of M instead.
+   */
+  bool
+  GetVictim (K key, K &victim)
+  {
+    if (GetSize () < m_cacheSize || Find (key))
+      {
+        return false;
+      }
+
+    if (EvictFromSmall ())
+      {
+        K tail = m_small.GetEvictionCandidate ();
+        if (m_small.Peek (tail)->freq <= 1 || m_main.GetSize () == 0)
+          {
+            victim = tail;
+            return true;
+          }
+      }
+    victim = m_main.GetEvictionCandidate ();
+    return true;
+  }
+
+  void
+  Remove (K key)
+  {
+    m_small.Remove (key);
+    m_main.Remove (key);
+  }
+
+  size_t
+  GetSize ()
+  {
+    return m_small.GetSize () + m_main.GetSize ();
+  }
+
+  /// The slots of S followed by the slots of M.
+  size_t
+  GetSlots () const
+  {
+    return m_small.GetSlots () + m_main.GetSlots ();
+  }
+
+  void
+  ClearBits (size_t first, size_t count)
+  {
+    auto clear = [] (Entry &entry, uint8_t &) { entry.bit = 0; };
+    size_t split = m_small.GetSlots ();
+    if (first < split)
+      {
+        size_t head = std::min (count, split - first);
+        m_small.VisitSlots (first, head, clear);
+        first += head;
+        count -= head;
+      }
+    m_main.VisitSlots (first - split, count, clear);
+  }
+
+private:
+  struct Entry
+  {
+    V value;
+    int freq;
+    uint8_t bit;
+  };
+
+  Entry *
+  Lookup (K key)
+  {
+    Entry *entry = m_small.Peek (key);
+    return entry != nullptr ? entry : m_main.Peek (key);
+  }
+
+  bool
+  EvictFromSmall ()
+  {
+    return m_small.GetSize () >= m_smallSize || m_main.GetSize () == 0;
+  }
+
+  /// Evicts one entry, promoting frequently hit tail entries of S to M on the way.
+  bool
+  EvictSmall (pair<K, V> &evicted)
+  {
+    while (m_small.GetSize () > 0)
+      {
+        K key = m_small.GetEvictionCandidate ();
+        Entry entry = *m_small.Peek (key);
+        m_small.Remove (key);
+        if (entry.freq > 1)
+          {
+            m_main.Put (key, Entry{entry.value, 0, entry.bit});
+            if (m_main.GetSize () > m_cacheSize - m_smallSize)
+              {
+                return EvictMain (evicted);
+              }
+          }
+        else
+          {
+            m_ghost.Put (key, 0);
+            evicted = std::make_pair (key, entry.value);
+            return true;
+          }
+      }
+    return EvictMain (evicted);
+  }
+
+  bool
+  EvictMain (pair<K, V> &evicted)
+  {
+    while (m_main.GetSize () > 0)
+      {
+        K key = m_main.GetEvictionCandidate ();
+        Entry entry = *m_main.Peek (key);
+        m_main.Remove (key);
+        if (entry.freq > 0)
+          {
+            entry.freq--;
+            m_main.Put (key, entry);
+          }
+        else
+          {
+            evicted = std::make_pair (key, entry.value);
+            return true;
+          }
+      }
+    return false;
+  }
+
+  size_t m_cacheSize, m_smallSize;
+  LRUCache<K, Entry> m_small, m_main;
+  LRUCache<K, uint8_t> m_ghost;
+};
+
+#endif /* S3FIFO_CACHE_H */
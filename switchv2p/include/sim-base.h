@@ -5,6 +5,7 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/internet-module.h"
 #include "socket-helper.h"
+#include "locator-cache.h"
 #include "sim-parameters.h"
 #include "migration-params.h"
 #include <unordered_map>
@@ -30,6 +31,8 @@ public:
   virtual void Run ();
 
 protected:
+  static const uint32_t SEGMENT_SIZE;
+
   virtual void AssignIds ();
 
   virtual void Configure ();
@@ -42,6 +45,12 @@ protected:
 
   virtual void AssignPhysicalIps ();
 
+  /// Places the containers and gateways, the part of SetupTunnel that needs no network stack.
+  void MapContainers ();
+
+  /// Numbers the hosts of every leaf for the switch caches that store host locators.
+  HostLocators GetHostLocators () const;
+
   virtual void SetupTunnel ();
 
   virtual void SetupApplications () = 0;
@@ -60,6 +69,11 @@ protected:
   Ipv4AddressHelper m_address;
   vector<vector<NetDeviceContainer>> m_nodeToSwDevice, m_swToSwDevice, m_coreToSpineDevice;
   unordered_map<uint32_t, uint32_t> m_virtualToPhysical;
+  /// The epoch of each mapping, bumped when it changes. Missing VIPs are at epoch 0.
+  unordered_map<uint32_t, uint8_t> m_mappingEpochs;
+  /// The host each VM of the migration schedule runs on, 0 while it does not run. It moves before
+  /// m_virtualToPhysical, which is the mapping the gateways hand out.
+  unordered_map<uint32_t, uint32_t> m_vmLocations;
   vector<vector<set<uint32_t>>> m_onDemandCaches;
   vector<vector<SocketHelper>> m_socketHelpers;
   AsciiTraceHelper m_asciiHelper;
@@ -68,6 +82,8 @@ protected:
   SimulationParameters m_simParameters;
   vector<pair<uint32_t, uint32_t>> m_gws;
   vector<Ipv4Address> m_gwAddresses;
+  /// The mapping epochs a host locator keeps, EpochTag::EPOCHS with versioned mappings
+  uint32_t m_locatorEpochs;
 };
 
 #endif /* SIM_BASE_H */
\ No newline at end of file
@@ -13,7 +13,7 @@ using std::vector;
 class SimulationParameters
 {
 public:
-  enum Mode { Controller, SwitchV2P, LocalLearning, NoCache, GwCache, Direct, Bluebird, OnDemand };
+  enum Mode { Controller, SwitchV2P, LocalLearning, NoCache, GwCache, Direct, Bluebird, OnDemand, CacheOnly };
   enum Topology { CLOS, FATTREE };
 
   SimulationParameters (string simMode, string networkTopology, size_t numOfPorts, size_t numOfCore,
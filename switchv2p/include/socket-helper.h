@@ -20,11 +20,18 @@ class SocketHelper
 private:
   void SendFollowMeRule (Ptr<Packet> packet, Ipv4Header ipHeader, bool misdelivery);
   void SendToGateway (Ptr<Packet> packet, uint32_t gwIdx);
+  /// Sends a packet that reached the old host of its destination on to the new one.
+  void Misdeliver (Ptr<Packet> packet, Ipv4Header &header, size_t gwIdx);
   uint32_t GetGatewayIdx (Ptr<Packet> packet, Ipv4Header &header);
+  void Send (Ptr<Packet> packet, Ipv4Address dst);
+  /// Tags \p packet with the epochs this host expects for its mappings.
+  void StampEpochs (Ptr<Packet> packet, const Ipv4Header &header);
 
 public:
   static const uint16_t PORT_NUMBER;
-  SocketHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical, uint32_t &misdeliveryCount,
+  SocketHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical,
+                unordered_map<uint32_t, uint8_t> &mappingEpochs,
+                unordered_map<uint32_t, uint32_t> &vmLocations, uint32_t &misdeliveryCount,
                 Time &lastMisdelivered, bool gatewayPerFlowLoadBalancing,
                 SimulationParameters simParams, MigrationParams migrationParams);
   bool VirtualSend (Ptr<Packet> packet, const Address &source, const Address &dest,
@@ -34,7 +41,13 @@ public:
   Ptr<Node> m_node;
   Ptr<Socket> m_socket;
   Ptr<VirtualNetDevice> m_vDev;
+  /// Takes over the encapsulated packets from m_socket when set, see P4SwitchApp::SetSendCallback.
+  Callback<void, Ptr<Packet>, Ipv4Address, Ipv4Address> m_sendCallback;
+  /// Called with the virtual destination of each misdelivered packet, when set.
+  Callback<void, Ipv4Address> m_misdeliveryCallback;
   unordered_map<uint32_t, uint32_t> &m_virtualToPhysical;
+  unordered_map<uint32_t, uint8_t> &m_mappingEpochs;
+  unordered_map<uint32_t, uint32_t> &m_vmLocations;
   uint32_t &m_misdeliveryCount;
   Time &m_lastMisdelivered;
   set<uint32_t> *m_onDemandCache;
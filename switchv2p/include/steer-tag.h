@@ -0,0 +1,33 @@
+#ifndef STEER_TAG_H
+#define STEER_TAG_H
+
+#include "ns3/network-module.h"
+
+using namespace ns3;
+
+/// The outer destination of a packet a leaf sent to the spine that owns its VIP.
+class SteerTag : public Tag
+{
+public:
+  SteerTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  void SetAddress (Ipv4Address addr);
+  Ipv4Address GetAddress (void) const;
+
+private:
+  Ipv4Address m_address;
+};
+
+#endif /* STEER_TAG_H */
@@ -4,7 +4,7 @@
 #include "ns3/applications-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
-#include "lru-cache.h"
+#include "cache-policy-checker.h"
 #include "flow-info.h"
 #include "sim-parameters.h"
 #include <unordered_map>
@@ -39,8 +39,15 @@ private:
 
   /// Send a packet.
   bool ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader);
-
-  LRUCache<uint32_t, uint32_t> m_cache;
+  template <typename Cache>
+  bool LookupWith (uint32_t key, uint32_t &value);
+  template <typename Cache>
+  void InsertWith (uint32_t key, uint32_t value);
+
+  SwitchCaches<uint32_t, uint32_t, SwitchCacheHash> m_caches;
+  bool (SwitchApp::*m_lookupHandler) (uint32_t key, uint32_t &value);
+  void (SwitchApp::*m_insertHandler) (uint32_t key, uint32_t value);
+  enum CachePolicy m_cachePolicy;
   set<uint32_t> m_gwAddresses;
   TrafficMatrix m_trafficMatrix;
   enum SimulationParameters::Mode m_switchMode;
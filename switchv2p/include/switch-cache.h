@@ -0,0 +1,294 @@
+#ifndef SWITCH_CACHE_H
+#define SWITCH_CACHE_H
+
+#include <tuple>
+#include "arc-cache.h"
+#include "clock-cache.h"
+#include "locator-cache.h"
+#include "lru-cache.h"
+#include "p4-cache.h"
+#include "p4-cuckoo-cache.h"
+#include "p4-set-assoc-cache.h"
+#include "range-cache.h"
+#include "s3fifo-cache.h"
+
+/**
+ * Replacement policies a switch cache can use.
+ *
+ * Every cache type implements the same interface: Get (with and without the
+ * access bit), GetBit, Find, PutIfNotEvict, Put (with and without the evicted
+ * entry) and Remove. A switch keeps one cache of each type in a SwitchCaches
+ * tuple, sizes only the one its policy selects, and binds its per-packet
+ * handler to that type once in Setup, so lookups are statically dispatched.
+ * The P4 register caches also come as LocatorCache variants that store 16-bit
+ * host locators instead of 32-bit addresses.
+ */
+enum CachePolicy {
+  DEFAULT_POLICY,
+  DIRECT_MAPPED,
+  SET_ASSOCIATIVE,
+  CUCKOO,
+  LRU,
+  CLOCK,
+  ARC,
+  S3FIFO,
+  RANGE
+};
+
+/// Hash policy of the switch caches, see cache-hash.h
+typedef Crc32Hash SwitchCacheHash;
+
+template <typename K, typename V, typename Hash>
+using SwitchCaches =
+    std::tuple<P4Cache<K, V, Hash>, P4SetAssocCache<K, V, Hash>, P4CuckooCache<K, V, Hash>,
+               LRUCache<K, V>, ClockCache<K, V>, ArcCache<K, V>, S3FifoCache<K, V>,
+               RangeCache<K, V>, LocatorCache<P4Cache<K, uint16_t, Hash>, K>,
+               LocatorCache<P4SetAssocCache<K, uint16_t, Hash>, K>,
+               LocatorCache<P4CuckooCache<K, uint16_t, Hash>, K>>;
+
+/// Sizing parameters shared by all cache types, each uses the ones it needs.
+struct CacheConfig
+{
+  int capacity = 0;
+  uint32_t ways = 1, maxKicks = 8;
+  /// Hash seed of the P4 caches, 0 is the switch default
+  uint32_t seed = 0;
+  bool hugePages = false;
+  /// Host numbering of the LocatorCache variants
+  HostLocators locators;
+  /// Idle and hard timeouts of the P4Cache entries in clock ticks, 0 disables
+  uint16_t idleTicks = 0, hardTicks = 0;
+};
+
+template <typename K, typename V, typename Hash>
+void
+SetupCache (P4Cache<K, V, Hash> &cache, const CacheConfig &config)
+{
+  cache.Setup (config.capacity, config.seed, config.hugePages);
+  if (config.idleTicks > 0 || config.hardTicks > 0)
+    {
+      cache.SetExpiry (config.idleTicks, config.hardTicks, config.hugePages);
+    }
+}
+
+template <typename K, typename V, typename Hash>
+void
+SetupCache (P4SetAssocCache<K, V, Hash> &cache, const CacheConfig &config)
+{
+  cache.Setup (config.capacity, config.ways, config.seed);
+}
+
+template <typename K, typename V, typename Hash>
+void
+SetupCache (P4CuckooCache<K, V, Hash> &cache, const CacheConfig &config)
+{
+  cache.Setup (config.capacity, config.seed, config.maxKicks, config.hugePages);
+}
+
+template <typename K, typename V>
+void
+SetupCache (LRUCache<K, V> &cache, const CacheConfig &config)
+{
+  cache.SetCapacity (config.capacity);
+}
+
+template <typename Cache>
+void
+SetupCache (Cache &cache, const CacheConfig &config)
+{
+  cache.Setup (config.capacity);
+}
+
+template <typename Cache, typename K>
+void
+SetupCache (LocatorCache<Cache, K> &cache, const CacheConfig &config)
+{
+  SetupCache (cache.GetCache (), config);
+  cache.SetLocators (config.locators);
+}
+
+/**
+ * Key ranges. A RangeCache entry covers consecutive keys with one value, the
+ * other caches hold single keys and keep only \p key, a key of the range.
+ */
+template <typename Cache, typename K, typename V>
+bool
+PutRange (Cache &cache, K first, K last, K key, V value, pair<K, V> &evicted)
+{
+  return cache.Put (key, value, evicted);
+}
+
+template <typename K, typename V>
+bool
+PutRange (RangeCache<K, V> &cache, K first, K last, K key, V value, pair<K, V> &evicted)
+{
+  return cache.PutRange (first, last, value, evicted);
+}
+
+/// The last key of the entry the latest evicting Put evicted, whose first key is \p first.
+template <typename Cache, typename K>
+K
+GetEvictedLast (Cache &cache, K first)
+{
+  return first;
+}
+
+template <typename K, typename V>
+K
+GetEvictedLast (RangeCache<K, V> &cache, K first)
+{
+  return cache.GetEvictedLast ();
+}
+
+/// The range of the cached entry holding \p key.
+template <typename Cache, typename K>
+void
+GetRange (Cache &cache, K key, K &first, K &last)
+{
+  first = last = key;
+}
+
+template <typename K, typename V>
+void
+GetRange (RangeCache<K, V> &cache, K key, K &first, K &last)
+{
+  if (!cache.GetRange (key, first, last))
+    {
+      first = last = key;
+    }
+}
+
+/**
+ * Entry expiry, which only the P4Cache keeps. The other caches have no clock
+ * and expire nothing.
+ */
+template <typename Cache>
+void
+SetCacheClock (Cache &cache, uint16_t now)
+{
+}
+
+template <typename K, typename V, typename Hash>
+void
+SetCacheClock (P4Cache<K, V, Hash> &cache, uint16_t now)
+{
+  cache.SetClock (now);
+}
+
+template <typename Cache, typename K>
+void
+SetCacheClock (LocatorCache<Cache, K> &cache, uint16_t now)
+{
+  SetCacheClock (cache.GetCache (), now);
+}
+
+/// Clears the expired entries of \p count slots starting at slot \p first.
+template <typename Cache>
+void
+ExpireSlots (Cache &cache, size_t first, size_t count)
+{
+}
+
+template <typename K, typename V, typename Hash>
+void
+ExpireSlots (P4Cache<K, V, Hash> &cache, size_t first, size_t count)
+{
+  cache.Expire (first, count);
+}
+
+template <typename Cache, typename K>
+void
+ExpireSlots (LocatorCache<Cache, K> &cache, size_t first, size_t count)
+{
+  ExpireSlots (cache.GetCache (), first, count);
+}
+
+template <typename Cache>
+uint64_t
+GetExpirations (Cache &cache)
+{
+  return 0;
+}
+
+template <typename K, typename V, typename Hash>
+uint64_t
+GetExpirations (P4Cache<K, V, Hash> &cache)
+{
+  return cache.GetExpirations ();
+}
+
+template <typename Cache, typename K>
+uint64_t
+GetExpirations (LocatorCache<Cache, K> &cache)
+{
+  return GetExpirations (cache.GetCache ());
+}
+
+/// Type tag handed to the visitor of VisitCachePolicy.
+template <typename Cache>
+struct CacheType
+{
+  typedef Cache type;
+};
+
+/// Whether \p policy is a P4 register cache, which has a LocatorCache variant.
+inline bool
+IsRegisterPolicy (enum CachePolicy policy)
+{
+  return policy == DIRECT_MAPPED || policy == SET_ASSOCIATIVE || policy == CUCKOO;
+}
+
+/**
+ * Calls \p visitor with the CacheType tag of the cache that implements \p policy,
+ * its LocatorCache variant if \p locators is set and the policy has one.
+ * DEFAULT_POLICY must be resolved by the caller.
+ */
+template <typename K, typename V, typename Hash, typename Visitor>
+void
+VisitCachePolicy (enum CachePolicy policy, Visitor visitor, bool locators = false)
+{
+  switch (policy)
+    {
+    case SET_ASSOCIATIVE:
+      if (locators)
+        {
+          visitor (CacheType<LocatorCache<P4SetAssocCache<K, uint16_t, Hash>, K>> ());
+          break;
+        }
+      visitor (CacheType<P4SetAssocCache<K, V, Hash>> ());
+      break;
+    case CUCKOO:
+      if (locators)
+        {
+          visitor (CacheType<LocatorCache<P4CuckooCache<K, uint16_t, Hash>, K>> ());
+          break;
+        }
+      visitor (CacheType<P4CuckooCache<K, V, Hash>> ());
+      break;
+    case LRU:
+      visitor (CacheType<LRUCache<K, V>> ());
+      break;
+    case CLOCK:
+      visitor (CacheType<ClockCache<K, V>> ());
+      break;
+    case ARC:
+      visitor (CacheType<ArcCache<K, V>> ());
+      break;
+    case S3FIFO:
+      visitor (CacheType<S3FifoCache<K, V>> ());
+      break;
+    case RANGE:
+      visitor (CacheType<RangeCache<K, V>> ());
+      break;
+    default:
+      if (locators)
+        {
+          visitor (CacheType<LocatorCache<P4Cache<K, uint16_t, Hash>, K>> ());
+          break;
+        }
+      visitor (CacheType<P4Cache<K, V, Hash>> ());
+      break;
+    }
+}
+
+#endif /* SWITCH_CACHE_H */
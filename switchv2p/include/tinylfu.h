@@ -0,0 +1,131 @@
+#ifndef TINYLFU_H
+#define TINYLFU_H
+
+#include <algorithm>
+#include <vector>
+#include "bloom-filter.h"
+#include "cache-hash.h"
+
+using std::vector;
+
+/**
+ * TinyLFU admission filter (Einziger et al., ToS '17).
+ *
+ * Accesses are counted in a count-min sketch of 4-bit counters, fronted by a
+ * doorkeeper Bloom filter so keys seen only once never reach the sketch. After
+ * sampleSize recorded accesses every counter is halved and the doorkeeper is
+ * cleared, so the estimates follow the recent workload. A key is admitted into
+ * a full cache only if its estimate beats the estimate of the key it evicts.
+ */
+template <typename K, typename Hash = Crc32Hash>
+class TinyLfu
+{
+public:
+  static constexpr uint32_t DEPTH = 4;
+  static constexpr uint8_t MAX_COUNT = 15;
+
+  TinyLfu () : m_width (0), m_samples (0), m_sampleSize (0)
+  {
+  }
+
+  /// Splits \p bytes between the doorkeeper (a quarter) and the sketch (the rest).
+  void
+  Setup (size_t bytes, size_t sampleSize)
+  {
+    m_sampleSize = std::max<size_t> (sampleSize, 1);
+    m_samples = 0;
+    m_doorkeeper.SetupBits (bytes * 8 / 4, m_sampleSize);
+    // Two 4-bit counters per byte
+    m_width = std::max<size_t> ((bytes - bytes / 4) * 2 / DEPTH, 2) & ~(size_t) 1;
+    m_index.SetSize (m_width);
+    m_counters.assign (m_width * DEPTH / 2, 0);
+  }
+
+  void
+  Record (K key)
+  {
+    if (!m_doorkeeper.Get (key))
+      {
+        m_doorkeeper.Put (key);
+      }
+    else
+      {
+        uint32_t h1, h2;
+        GetHashes (key, h1, h2);
+        for (uint32_t row = 0; row < DEPTH; ++row)
+          {
+            size_t counter = GetCounter (row, h1, h2);
+            if (Read (counter) < MAX_COUNT)
+              {
+                m_counters[counter >> 1] += (counter & 1) ? 0x10 : 0x01;
+              }
+          }
+      }
+
+    if (++m_samples >= m_sampleSize)
+      {
+        Reset ();
+      }
+  }
+
+  uint32_t
+  Estimate (K key)
+  {
+    uint32_t h1, h2;
+    GetHashes (key, h1, h2);
+    uint32_t estimate = MAX_COUNT;
+    for (uint32_t row = 0; row < DEPTH; ++row)
+      {
+        estimate = std::min<uint32_t> (estimate, Read (GetCounter (row, h1, h2)));
+      }
+    return estimate + (m_doorkeeper.Get (key) ? 1 : 0);
+  }
+
+  bool
+  Admit (K candidate, K victim)
+  {
+    return Estimate (candidate) > Estimate (victim);
+  }
+
+private:
+  void
+  GetHashes (K key, uint32_t &h1, uint32_t &h2)
+  {
+    uint64_t x = Hash::Hash (key, (K) 0) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 32;
+    h1 = (uint32_t) x;
+    h2 = (uint32_t) (x >> 32) | 1;
+  }
+
+  size_t
+  GetCounter (uint32_t row, uint32_t h1, uint32_t h2)
+  {
+    return row * m_width + m_index.Reduce (h1 + row * h2);
+  }
+
+  uint8_t
+  Read (size_t counter)
+  {
+    return (m_counters[counter >> 1] >> ((counter & 1) * 4)) & 0x0F;
+  }
+
+  /// Halves every counter and forgets the doorkeeper.
+  void
+  Reset ()
+  {
+    for (uint8_t &pair : m_counters)
+      {
+        pair = (pair >> 1) & 0x77;
+      }
+    m_doorkeeper.Clear ();
+    m_samples /= 2;
+  }
+
+  size_t m_width, m_samples, m_sampleSize;
+  CacheIndex m_index;
+  vector<uint8_t> m_counters;
+  BloomFilter<K, Hash> m_doorkeeper;
+};
+
+#endif /* TINYLFU_H */
@@ -2,6 +2,8 @@
 #define TRACE_SIM_H
 
 #include "ns3/applications-module.h"
+#include "cache-directory.h"
+#include "cache-replay.h"
 #include "sim-base.h"
 #include "flow.h"
 #include "migration-params.h"
@@ -9,6 +11,7 @@
 #include "packet-stats.h"
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <set>
 #include <boost/property_tree/ptree.hpp>
@@ -17,6 +20,7 @@
 using std::set;
 using std::string;
 using std::unordered_map;
+using std::unordered_set;
 using std::vector;
 using namespace boost::property_tree;
 class TraceSimulation : public SimulationBase
@@ -26,6 +30,8 @@ public:
                    SimulationParameters simulationParameters, string outputPath,
                    MigrationParams migrationParams);
 
+  virtual void Run ();
+
 protected:
   virtual void Configure ();
   virtual void StopSimulation ();
@@ -33,14 +39,35 @@ protected:
 
 private:
   uint64_t m_receivedPackets, m_sentPackets, m_gwPackets, m_lastGwPackets, m_generatedLearning,
-      m_generatedInvalidation, m_droppedPackets, m_totalPacketLatency, m_totalPacketHops;
+      m_generatedInvalidation, m_droppedPackets, m_totalPacketLatency, m_totalPacketHops,
+      m_admissions, m_admissionRejections, m_controlPackets, m_controlBytes, m_steeredPackets,
+      m_forwardedVictims, m_installedVictims, m_victimHits, m_victimControlBytes, m_staleEntries,
+      m_staleHits, m_directoryInvalidations, m_directoryUpdates, m_steeredReceivedPackets,
+      m_steeredPacketHops;
   void GatewayRx (Ptr<const Packet>, const Address &);
   void SinkRx (Ptr<const Packet>, const Address &, const Time &, const Time &, const uint32_t &);
   void ClientTx (Ptr<const Packet>, const uint32_t &);
   void GeneratedLearning (Ptr<const Packet>);
   void GeneratedInvalidation (Ptr<const Packet>);
+  void ControlPacket (Ptr<const Packet> packet, Time latency);
   void ProcessedPacket (Ptr<const Packet>, uint32_t);
   void CacheHit (Ptr<const Packet> packet, uint32_t switchId);
+  void Admission (uint32_t switchId, bool admitted);
+  void GenerateProbability (uint32_t switchId, double probability);
+  void SteeredPacket (Ptr<const Packet>, uint32_t);
+  void VictimForwarded (uint32_t switchId);
+  void VictimInstalled (uint32_t switchId);
+  void VictimHit (uint32_t switchId);
+  void StaleEntry (uint32_t switchId);
+  void StaleHit (uint32_t switchId);
+  void SourceLearned (uint32_t vip, Ipv4Address switchAddress);
+  /// Charges a misdelivered packet to the latest event of the VM at \p vip.
+  void Misdelivered (Ipv4Address vip);
+  /// Sends an invalidation of \p vip at \p physical to each switch the CacheDirectory holds.
+  void InvalidateDirectory (uint32_t vip, uint32_t physical);
+  /// The cached VIPs of each group of \p groupSize switches, in total and distinct.
+  void CountCachedEntries (const NodeContainer &switches, uint32_t groupSize, ptree &entries,
+                           ptree &uniqueEntries);
   void RecordDropIp (const Ipv4Header &ipHeader, Ptr<const Packet> ipPayload,
                      Ipv4L3Protocol::DropReason reason, Ptr<Ipv4> ipv4, uint32_t ifIndex);
   void RecordDropQueue (Ptr<const Packet> packet);
@@ -48,10 +75,26 @@ private:
   void RecordCongState (const TcpSocketState::TcpCongState_t, const TcpSocketState::TcpCongState_t,
                         const uint32_t &);
 
+  void InstallP4Switches (enum SimulationParameters::Mode simMode);
+  void ConnectSwitchTraces ();
+  /// Replaces the network with a CacheReplay for simMode=CacheOnly.
+  void SetupCacheReplay ();
+  void ReplayFlow (uint32_t containerId, Flow flow);
+  void ReplayPacket (uint32_t srcContainerId, uint32_t dstContainerId, uint32_t flowId,
+                     uint32_t size, uint8_t protocol);
+  void ReplayHostRx (Ptr<Packet> packet, Ipv4Header header, uint32_t leaf, uint32_t host);
+
   void CalculateDestinations ();
   void GatewayMonitoring ();
-  void Migration ();
-  void UpdateMappings ();
+  /// The events of --migrationSchedule, a CSV of ts,container,leaf,host[,event].
+  vector<MigrationEvent> ParseMigrationSchedule (string scheduleCsvPath);
+  void ScheduleMigrations ();
+  void Migration (size_t event);
+  /// Installs the client of \p containerId on \p host of \p leaf, the caller starts it.
+  ApplicationContainer InstallClient (uint32_t containerId, uint32_t leaf, uint32_t host);
+  /// Starts the sink of the VMs that move to \p host of \p leaf, at their first event.
+  void InstallVmSink (uint32_t leaf, uint32_t host);
+  void UpdateMappings (size_t event);
   ptree CreatePtree (vector<uint32_t> &vec);
   template <typename T>
   ptree CreatePtree (unordered_map<uint32_t, T> &map);
@@ -59,17 +102,37 @@ private:
   ContainerGroups ParsePlacement (string placementJsonPath,
                                   SimulationParameters simulationParameters);
   unordered_map<uint32_t, vector<Flow>> ParseTrace (string traceCsvPath);
-  Time m_startTime, m_stopTime;
+  Time m_startTime, m_stopTime, m_lastMappingUpdate, m_lastStaleHit;
   unordered_map<uint32_t, vector<Flow>> m_containerToFlows;
   unordered_map<uint32_t, uint64_t> m_switchToProcessedPackets, m_switchToCacheHits,
-      m_switchToProcessedBytes, m_switchToFirstCacheHits;
+      m_switchToProcessedBytes, m_switchToFirstCacheHits, m_switchToAdmissions,
+      m_switchToAdmissionRejections;
   unordered_map<uint32_t, FlowStats> m_flowStats;
+  /// The UIDs of the steered packets that have not reached a sink yet
+  unordered_set<uint64_t> m_steeredUids;
+  /// The GenerateProbability of each gateway leaf by the microsecond it was set
+  unordered_map<uint32_t, ptree> m_switchToGenerateProbability;
   set<int> m_destinations;
-  ApplicationContainer m_switchApps;
+  ApplicationContainer m_switchApps, m_gatewayApps;
+  CacheDirectory m_directory;
   string m_outputPath;
   vector<uint32_t> m_gatewayThroughput;
+  /// Control packets by the log2 bucket of the microseconds their oldest mapping waited
+  vector<uint64_t> m_controlFlushLatencies;
   MigrationParams m_migrationParams;
-  uint32_t m_migrationSrcLeaf, m_migrationSrcHost;
+  vector<MigrationEvent> m_migrations;
+  vector<MigrationStats> m_migrationStats;
+  /// The events of each VM in time order, and the latest one that happened
+  unordered_map<uint32_t, vector<size_t>> m_vmEvents;
+  unordered_map<uint32_t, size_t> m_vmLastEvent;
+  /// The client of each VM that sends, on the host the VM runs on
+  unordered_map<uint32_t, Ptr<ClientApp>> m_vmClients;
+  /// The hosts that have a sink for the VMs that moved to them
+  set<pair<uint32_t, uint32_t>> m_vmSinkHosts;
+  /// The containers of the placement whose first event creates them
+  set<uint32_t> m_reservedContainers;
+  uint32_t m_packetSize;
+  CacheReplay m_replay;
 };
 
 #endif /* TRACE_SIM_H */
\ No newline at end of file
@@ -83,4 +83,21 @@ Ipv4Address
 IpUtils::GetSpineFromCoreAddress (uint32_t spinePodId, uint32_t core)
 {
   return Ipv4Address (GetCoreSwitchBaseAddress (spinePodId, core).Get () + 2);
-}
\ No newline at end of file
+}
+uint32_t
+IpUtils::GetVersionedAddress (uint32_t address, uint8_t epoch)
+{
+  return (address & 0xffffff00) | (epoch + 1);
+}
+
+uint32_t
+IpUtils::GetUnversionedAddress (uint32_t versionedAddress)
+{
+  return (versionedAddress & 0xffffff00) | 1;
+}
+
+uint8_t
+IpUtils::GetAddressEpoch (uint32_t versionedAddress)
+{
+  return (versionedAddress & 0xff) - 1;
+}
@@ -1,18 +1,25 @@
 #include "include/p4-switch-app.h"
 
+#include "include/control-tag.h"
+#include "include/epoch-tag.h"
 #include "include/eviction-tag.h"
 #include "include/hit-tag.h"
 #include "include/invalidation-tag.h"
 #include "include/ip-utils.h"
+#include "include/steer-tag.h"
 
 #include "ns3/internet-module.h"
 
+#include <cmath>
 #include <random>
+#include <sstream>
 
 NS_LOG_COMPONENT_DEFINE ("P4SwitchApp");
 NS_OBJECT_ENSURE_REGISTERED (P4SwitchApp);
 
 const uint16_t P4SwitchApp::SWITCH_PORT = 333;
+const uint32_t P4SwitchApp::OWNER_SEED = 0x5eed;
+const uint32_t P4SwitchApp::VICTIM_SEED = 0x71c7;
 
 /**
  * Register this type.
@@ -29,11 +36,180 @@ P4SwitchApp::GetTypeId (void)
           .AddAttribute ("MemorySize", "The number of entries each switch can store",
                          IntegerValue (10), MakeIntegerAccessor (&P4SwitchApp::m_memorySize),
                          MakeIntegerChecker<int32_t> ())
+          .AddAttribute ("MemoryBytes",
+                         "The SRAM of each switch cache in bytes, used instead of MemorySize "
+                         "when positive. The entries are the bytes over the entry size of the "
+                         "cache policy",
+                         IntegerValue (0), MakeIntegerAccessor (&P4SwitchApp::m_memoryBytes),
+                         MakeIntegerChecker<int32_t> (0))
+          .AddAttribute ("CompactLocators",
+                         "Store 16-bit host locators instead of 32-bit physical addresses in the "
+                         "DirectMapped, SetAssociative and Cuckoo caches",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&P4SwitchApp::m_compactLocators),
+                         MakeBooleanChecker ())
+          .AddAttribute ("EvictionTagEntries",
+                         "The most evicted entries a packet carries to the next switches. When "
+                         "full, the oldest entry is dropped",
+                         UintegerValue (1),
+                         MakeUintegerAccessor (&P4SwitchApp::m_evictionTagEntries),
+                         MakeUintegerChecker<uint32_t> (1, EvictionTag::MAX_ENTRIES))
+          .AddAttribute ("ExclusiveSpines",
+                         "Partition the VIPs over the spines of each pod by hash. A spine only "
+                         "caches the VIPs it owns, and leaves steer gateway-bound packets to the "
+                         "owner of their VIP",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&P4SwitchApp::m_exclusiveSpines),
+                         MakeBooleanChecker ())
+          .AddAttribute ("CoreRing",
+                         "Assign each VIP to one core with a consistent-hash ring. A core only "
+                         "caches the VIPs it owns, and leaves and spines steer gateway-bound "
+                         "packets leaving the pod to the owner of their VIP",
+                         BooleanValue (false), MakeBooleanAccessor (&P4SwitchApp::m_coreRing),
+                         MakeBooleanChecker ())
+          .AddAttribute ("CoreRingVirtualNodes", "The points of each core on the CoreRing",
+                         UintegerValue (100),
+                         MakeUintegerAccessor (&P4SwitchApp::m_coreRingVirtualNodes),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("RemovedCores",
+                         "Comma-separated indices of the cores taken out of the CoreRing. They "
+                         "still forward packets, but own and cache no VIP",
+                         StringValue (""), MakeStringAccessor (&P4SwitchApp::m_removedCores),
+                         MakeStringChecker ())
+          .AddAttribute ("VictimForwarding",
+                         "Send the entries a core evicts to another core or a gateway-pod spine, "
+                         "which installs them only if it has room, instead of on the packet",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&P4SwitchApp::m_victimForwarding),
+                         MakeBooleanChecker ())
+          .AddAttribute ("VictimHopLimit",
+                         "The peers a forwarded victim tries before it is dropped",
+                         UintegerValue (2), MakeUintegerAccessor (&P4SwitchApp::m_victimHopLimit),
+                         MakeUintegerChecker<uint32_t> (1, 127))
+          .AddAttribute ("LeafMemorySize",
+                         "The number of entries of each leaf without a gateway (-1 = MemorySize)",
+                         IntegerValue (-1), MakeIntegerAccessor (&P4SwitchApp::m_leafMemorySize),
+                         MakeIntegerChecker<int32_t> (-1))
+          .AddAttribute ("GwLeafMemorySize",
+                         "The number of entries of each gateway leaf (-1 = MemorySize)",
+                         IntegerValue (-1), MakeIntegerAccessor (&P4SwitchApp::m_gwLeafMemorySize),
+                         MakeIntegerChecker<int32_t> (-1))
+          .AddAttribute ("SpineMemorySize",
+                         "The number of entries of each spine outside gateway pods "
+                         "(-1 = MemorySize)",
+                         IntegerValue (-1), MakeIntegerAccessor (&P4SwitchApp::m_spineMemorySize),
+                         MakeIntegerChecker<int32_t> (-1))
+          .AddAttribute ("GwSpineMemorySize",
+                         "The number of entries of each spine in a gateway pod (-1 = MemorySize)",
+                         IntegerValue (-1),
+                         MakeIntegerAccessor (&P4SwitchApp::m_gwSpineMemorySize),
+                         MakeIntegerChecker<int32_t> (-1))
+          .AddAttribute ("CoreMemorySize",
+                         "The number of entries of each core (-1 = MemorySize)", IntegerValue (-1),
+                         MakeIntegerAccessor (&P4SwitchApp::m_coreMemorySize),
+                         MakeIntegerChecker<int32_t> (-1))
+          .AddAttribute ("CachePolicy",
+                         "The cache replacement policy of all tiers (Default = LRU for Bluebird, "
+                         "set-associative if Associativity > 1, direct-mapped otherwise)",
+                         EnumValue (DEFAULT_POLICY),
+                         MakeEnumAccessor (&P4SwitchApp::m_cachePolicy), MakeCachePolicyChecker ())
+          .AddAttribute ("LeafCachePolicy",
+                         "The cache replacement policy of leaves (Default = CachePolicy)",
+                         EnumValue (DEFAULT_POLICY),
+                         MakeEnumAccessor (&P4SwitchApp::m_leafCachePolicy),
+                         MakeCachePolicyChecker ())
+          .AddAttribute ("SpineCachePolicy",
+                         "The cache replacement policy of spines (Default = CachePolicy)",
+                         EnumValue (DEFAULT_POLICY),
+                         MakeEnumAccessor (&P4SwitchApp::m_spineCachePolicy),
+                         MakeCachePolicyChecker ())
+          .AddAttribute ("CoreCachePolicy",
+                         "The cache replacement policy of cores (Default = CachePolicy)",
+                         EnumValue (DEFAULT_POLICY),
+                         MakeEnumAccessor (&P4SwitchApp::m_coreCachePolicy),
+                         MakeCachePolicyChecker ())
+          .AddAttribute ("Associativity",
+                         "The number of ways per set of the SetAssociative policy (1, 2, 4 or 8)",
+                         UintegerValue (1), MakeUintegerAccessor (&P4SwitchApp::m_associativity),
+                         MakeUintegerChecker<uint32_t> (1, 8))
+          .AddAttribute ("CuckooMaxKicks",
+                         "The maximal number of displacements of a Cuckoo policy insertion",
+                         UintegerValue (8), MakeUintegerAccessor (&P4SwitchApp::m_cuckooMaxKicks),
+                         MakeUintegerChecker<uint32_t> (0, 64))
+          .AddAttribute ("LeafAgingPeriod",
+                         "Time for the aging hand to clear every access bit of a leaf cache once "
+                         "(0 disables aging)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_leafAgingPeriod), MakeTimeChecker ())
+          .AddAttribute ("SpineAgingPeriod",
+                         "Time for the aging hand to clear every access bit of a spine cache once "
+                         "(0 disables aging)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_spineAgingPeriod), MakeTimeChecker ())
+          .AddAttribute ("CoreAgingPeriod",
+                         "Time for the aging hand to clear every access bit of a core cache once "
+                         "(0 disables aging)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_coreAgingPeriod), MakeTimeChecker ())
+          .AddAttribute ("AgingStep", "The interval between two moves of the aging hand",
+                         TimeValue (MicroSeconds (100)),
+                         MakeTimeAccessor (&P4SwitchApp::m_agingStep),
+                         MakeTimeChecker (NanoSeconds (1)))
+          .AddAttribute ("LeafIdleTimeout",
+                         "Time without a hit after which a leaf cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_leafIdleTimeout), MakeTimeChecker ())
+          .AddAttribute ("SpineIdleTimeout",
+                         "Time without a hit after which a spine cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_spineIdleTimeout), MakeTimeChecker ())
+          .AddAttribute ("CoreIdleTimeout",
+                         "Time without a hit after which a core cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_coreIdleTimeout), MakeTimeChecker ())
+          .AddAttribute ("LeafHardTimeout",
+                         "Time after its insertion at which a leaf cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_leafHardTimeout), MakeTimeChecker ())
+          .AddAttribute ("SpineHardTimeout",
+                         "Time after its insertion at which a spine cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_spineHardTimeout), MakeTimeChecker ())
+          .AddAttribute ("CoreHardTimeout",
+                         "Time after its insertion at which a core cache entry expires "
+                         "(0 disables, DirectMapped only)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_coreHardTimeout), MakeTimeChecker ())
+          .AddAttribute ("ExpiryTick",
+                         "The tick of the 16-bit clock of the entry timestamps, and the interval "
+                         "between two moves of the expiry sweep",
+                         TimeValue (MicroSeconds (100)),
+                         MakeTimeAccessor (&P4SwitchApp::m_expiryTick), MakeTimeChecker ())
+          .AddAttribute ("AdmissionMemorySize",
+                         "The memory of the TinyLFU admission filter, in MemorySize entries of "
+                         "8 bytes (0 disables admission control)",
+                         IntegerValue (0),
+                         MakeIntegerAccessor (&P4SwitchApp::m_admissionMemorySize),
+                         MakeIntegerChecker<int32_t> (0))
+          .AddAttribute ("AdmissionSampleSize",
+                         "The number of accesses between two halvings of the admission sketch "
+                         "(0 = 10 x MemorySize)",
+                         UintegerValue (0),
+                         MakeUintegerAccessor (&P4SwitchApp::m_admissionSampleSize),
+                         MakeUintegerChecker<uint32_t> ())
           .AddAttribute ("TTL", "The default TTL value", IntegerValue (64),
                          MakeIntegerAccessor (&P4SwitchApp::m_defaultTtl),
                          MakeIntegerChecker<uint32_t> ())
           .AddAttribute ("RandomHashFunction", "Random hash function", BooleanValue (false),
                          MakeBooleanAccessor (&P4SwitchApp::m_randomHash), MakeBooleanChecker ())
+          .AddAttribute ("HugePages", "Back large cache tables with transparent huge pages",
+                         BooleanValue (false), MakeBooleanAccessor (&P4SwitchApp::m_hugePages),
+                         MakeBooleanChecker ())
           .AddAttribute ("SourceLearning", "Enable source learning at leaf switches",
                          BooleanValue (false), MakeBooleanAccessor (&P4SwitchApp::m_sourceLearning),
                          MakeBooleanChecker ())
@@ -44,9 +220,23 @@ P4SwitchApp::GetTypeId (void)
                          BooleanValue (false),
                          MakeBooleanAccessor (&P4SwitchApp::m_bloomFilterEnabled),
                          MakeBooleanChecker ())
-          .AddAttribute ("BloomFilterSize", "The number of entries in the bloom filter",
-                         IntegerValue (80), MakeIntegerAccessor (&P4SwitchApp::m_bloomFilterSize),
-                         MakeIntegerChecker<int32_t> ())
+          .AddAttribute ("BloomFilterSize",
+                         "The number of bits in the bloom filter (0 = derive from "
+                         "BloomFilterEntries and BloomFilterFalsePositiveRate)",
+                         IntegerValue (0), MakeIntegerAccessor (&P4SwitchApp::m_bloomFilterSize),
+                         MakeIntegerChecker<int32_t> (0))
+          .AddAttribute ("BloomFilterEntries", "The expected number of keys in the bloom filter",
+                         UintegerValue (1024),
+                         MakeUintegerAccessor (&P4SwitchApp::m_bloomFilterEntries),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("BloomFilterFalsePositiveRate",
+                         "The target false-positive rate of the bloom filter", DoubleValue (0.01),
+                         MakeDoubleAccessor (&P4SwitchApp::m_bloomFilterFpr),
+                         MakeDoubleChecker<double> (0, 1))
+          .AddAttribute ("BloomFilterEpoch",
+                         "Rotation period of the two-generation bloom filter (0 disables aging)",
+                         TimeValue (Seconds (0)),
+                         MakeTimeAccessor (&P4SwitchApp::m_bloomFilterEpoch), MakeTimeChecker ())
           .AddAttribute ("GenerateInvalidations", "Enable the generation of invalidation packets",
                          BooleanValue (false),
                          MakeBooleanAccessor (&P4SwitchApp::m_generateInvalidation),
@@ -54,6 +244,26 @@ P4SwitchApp::GetTypeId (void)
           .AddAttribute ("GenerateProbability", "Probablity of packet generation",
                          DoubleValue (0.1), MakeDoubleAccessor (&P4SwitchApp::m_generateProb),
                          MakeDoubleChecker<double> ())
+          .AddAttribute ("AdaptiveGenerateProbability",
+                         "Set the GenerateProbability of gateway leaves from the fraction of "
+                         "gateway-bound packets that missed their cache in the last interval",
+                         BooleanValue (false),
+                         MakeBooleanAccessor (&P4SwitchApp::m_adaptiveGenerateProb),
+                         MakeBooleanChecker ())
+          .AddAttribute ("MinGenerateProbability",
+                         "The adaptive GenerateProbability when no gateway-bound packet misses",
+                         DoubleValue (0.001),
+                         MakeDoubleAccessor (&P4SwitchApp::m_minGenerateProb),
+                         MakeDoubleChecker<double> (0, 1))
+          .AddAttribute ("MaxGenerateProbability",
+                         "The adaptive GenerateProbability when every gateway-bound packet misses",
+                         DoubleValue (0.1), MakeDoubleAccessor (&P4SwitchApp::m_maxGenerateProb),
+                         MakeDoubleChecker<double> (0, 1))
+          .AddAttribute ("GenerateProbabilityInterval",
+                         "The interval between two updates of the adaptive GenerateProbability",
+                         TimeValue (MilliSeconds (1)),
+                         MakeTimeAccessor (&P4SwitchApp::m_generateProbInterval),
+                         MakeTimeChecker ())
           .AddAttribute ("PcieDataRate", "The default data rate for the pcie link",
                          DataRateValue (DataRate ("20Gbps")),
                          MakeDataRateAccessor (&P4SwitchApp::m_bps), MakeDataRateChecker ())
@@ -67,6 +277,16 @@ P4SwitchApp::GetTypeId (void)
           .AddAttribute (
               "BluebirdQueueSize", "The max queue size", QueueSizeValue (QueueSize ("1MiB")),
               MakeQueueSizeAccessor (&P4SwitchApp::m_bluebirdQueueSize), MakeQueueSizeChecker ())
+          .AddAttribute ("ControlBatchSize",
+                         "The learning or invalidation mappings to one switch that are sent "
+                         "together in one control packet",
+                         UintegerValue (1),
+                         MakeUintegerAccessor (&P4SwitchApp::m_controlBatchSize),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("ControlBatchTimeout",
+                         "The longest a mapping waits for its control packet to fill up",
+                         TimeValue (MicroSeconds (10)),
+                         MakeTimeAccessor (&P4SwitchApp::m_controlBatchTimeout), MakeTimeChecker ())
           .AddTraceSource ("GeneratedLearning", "A packet has been generated for learning",
                            MakeTraceSourceAccessor (&P4SwitchApp::m_learningTrace),
                            "ns3::Packet::AddressTracedCallback")
@@ -78,19 +298,60 @@ P4SwitchApp::GetTypeId (void)
                            "ns3::Packet::SwitchIdTracedCallback")
           .AddTraceSource ("CacheHit", "A packet hit the cache on the switch",
                            MakeTraceSourceAccessor (&P4SwitchApp::m_cacheHit),
-                           "ns3::Packet::SwitchIdTracedCallback");
+                           "ns3::Packet::SwitchIdTracedCallback")
+          .AddTraceSource ("Admission", "The admission filter admitted or rejected a learn",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_admissionTrace),
+                           "ns3::P4SwitchApp::AdmissionTracedCallback")
+          .AddTraceSource ("ControlPacket",
+                           "A control packet has been sent, with the wait of its oldest mapping",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_controlTrace),
+                           "ns3::P4SwitchApp::ControlPacketTracedCallback")
+          .AddTraceSource ("GenerateProbability",
+                           "A gateway leaf updated its adaptive GenerateProbability",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_generateProbTrace),
+                           "ns3::P4SwitchApp::GenerateProbabilityTracedCallback")
+          .AddTraceSource ("Steered", "A leaf steered a packet to the spine that owns its VIP",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_steeredTrace),
+                           "ns3::Packet::SwitchIdTracedCallback")
+          .AddTraceSource ("VictimForwarded", "A switch sent an evicted entry to a peer",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_victimForwardedTrace),
+                           "ns3::P4SwitchApp::VictimTracedCallback")
+          .AddTraceSource ("VictimInstalled", "A peer installed a forwarded victim",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_victimInstalledTrace),
+                           "ns3::P4SwitchApp::VictimTracedCallback")
+          .AddTraceSource ("VictimHit",
+                           "A gateway lookup hit an installed victim for the first time",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_victimHitTrace),
+                           "ns3::P4SwitchApp::VictimTracedCallback")
+          .AddTraceSource ("StaleEntry",
+                           "A switch skipped and removed an entry of an older mapping epoch",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_staleEntryTrace),
+                           "ns3::P4SwitchApp::StaleEntryTracedCallback")
+          .AddTraceSource ("StaleHit",
+                           "A switch sent a packet to the old address of a moved mapping",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_staleHitTrace),
+                           "ns3::P4SwitchApp::StaleEntryTracedCallback")
+          .AddTraceSource ("SourceLearned", "A leaf learned the mapping of a packet's source",
+                           MakeTraceSourceAccessor (&P4SwitchApp::m_sourceLearnedTrace),
+                           "ns3::P4SwitchApp::SourceLearnedTracedCallback");
 
   return tid;
 }
 
-P4SwitchApp::P4SwitchApp () : m_bluebirdBusy (false)
+P4SwitchApp::P4SwitchApp ()
+    : m_bluebirdBusy (false),
+      m_hashRandom (CreateObject<UniformRandomVariable> ()),
+      m_gatewayLookups (0),
+      m_gatewayMisses (0)
 {
 }
 
 void
 P4SwitchApp::Setup (vector<Ipv4Address> &gwAddresses, Ipv4Address switchAddress,
                     enum SwitchType switchType, enum SimulationParameters::Mode simMode,
-                    uint32_t podCount, unordered_map<uint32_t, uint32_t> *virtualToPhysical)
+                    uint32_t podCount, uint32_t coreCount,
+                    unordered_map<uint32_t, uint32_t> *virtualToPhysical,
+                    const HostLocators &hostLocators)
 {
   std::transform (gwAddresses.begin (), gwAddresses.end (),
                   inserter (m_gwAddresses, m_gwAddresses.end ()),
@@ -98,22 +359,116 @@ P4SwitchApp::Setup (vector<Ipv4Address> &gwAddresses, Ipv4Address switchAddress,
   m_switchAddress = switchAddress;
   m_switchType = switchType;
   m_simMode = simMode;
-  m_cache.Setup (m_memorySize, m_randomHash);
-  m_bluebirdCache.SetCapacity (m_memorySize);
+  uint32_t seed = m_randomHash ? m_hashRandom->GetInteger (0, UINT32_MAX) : 0;
+  m_random = CreateObject<UniformRandomVariable> ();
+  bool locators = UsesLocators ();
+  NS_ABORT_MSG_IF (locators && hostLocators.GetCount () > UINT16_MAX,
+                   "The hosts and mapping epochs do not fit in 16-bit locators");
+  NS_ABORT_MSG_IF (m_associativity & (m_associativity - 1),
+                   "Associativity must be 1, 2, 4 or 8");
+  NS_ABORT_MSG_IF (GetAgingPeriod ().IsStrictlyPositive () && !m_agingStep.IsStrictlyPositive (),
+                   "AgingStep must be positive");
+  GetExpiryTicks (m_idleTicks, m_hardTicks);
+  NS_ABORT_MSG_IF ((m_idleTicks > 0 || m_hardTicks > 0) && GetCachePolicy () != DIRECT_MAPPED,
+                   "Entry expiry needs the DirectMapped cache policy");
+  CacheConfig config;
+  config.capacity = GetMemorySize ();
+  config.ways = m_associativity;
+  config.maxKicks = m_cuckooMaxKicks;
+  config.seed = seed;
+  config.hugePages = m_hugePages;
+  config.locators = hostLocators;
+  config.idleTicks = m_idleTicks;
+  config.hardTicks = m_hardTicks;
+  VisitCachePolicy<uint32_t, uint32_t, SwitchCacheHash> (
+      GetCachePolicy (),
+      [&] (auto type) {
+        typedef typename decltype (type)::type Cache;
+        SetupCache (std::get<Cache> (m_caches), config);
+        m_packetHandler = &P4SwitchApp::ProcessWith<Cache>;
+        m_insertHandler = &P4SwitchApp::InsertWith<Cache>;
+        m_findHandler = &P4SwitchApp::FindWith<Cache>;
+        m_agingHandler = &P4SwitchApp::AgeWith<Cache>;
+        m_expiryHandler = &P4SwitchApp::ExpireWith<Cache>;
+        m_expiredHandler = &P4SwitchApp::GetExpiredWith<Cache>;
+      },
+      locators);
+  m_agingHand = 0;
+  m_expiryHand = 0;
   ObjectFactory queueFactory;
   queueFactory.SetTypeId ("ns3::DropTailQueue<Packet>");
   queueFactory.Set ("MaxSize", QueueSizeValue (m_bluebirdQueueSize));
   m_bluebirdQueue = queueFactory.Create<Queue<Packet>> ();
-  m_random = CreateObject<UniformRandomVariable> ();
   m_podCount = podCount;
+  m_podWidth = hostLocators.GetPodWidth ();
+  m_coresPerSpine = coreCount / m_podWidth;
+
+  if (m_coreRing)
+    {
+      m_coreOwners.Setup (coreCount, m_coreRingVirtualNodes);
+      std::istringstream removedCores (m_removedCores);
+      string core;
+      while (std::getline (removedCores, core, ','))
+        {
+          m_coreOwners.Remove (std::stoul (core));
+        }
+      NS_ABORT_MSG_IF (m_coreOwners.IsEmpty (), "All cores are removed from the CoreRing");
+      NS_ABORT_MSG_IF (m_coresPerSpine == 0, "CoreRing needs at least one core per spine");
+    }
+
+  if (m_victimForwarding && (m_switchType == CORE || m_switchType == GW_SPINE))
+    {
+      for (uint32_t core = 0; core < coreCount; ++core)
+        {
+          m_victimPeers.push_back (IpUtils::GetCoreAddress (0, core));
+        }
+      set<uint32_t> gatewayPods;
+      for (uint32_t gwAddress : m_gwAddresses)
+        {
+          gatewayPods.insert ((gwAddress >> 24) - 1);
+        }
+      for (uint32_t pod : gatewayPods)
+        {
+          for (uint32_t offset = 0; offset < m_podWidth; ++offset)
+            {
+              m_victimPeers.push_back (
+                  IpUtils::GetSpineFromLeafAddress (m_podCount, pod, offset, 0));
+            }
+        }
+      m_victimPeers.erase (std::remove (m_victimPeers.begin (), m_victimPeers.end (),
+                                        m_switchAddress),
+                           m_victimPeers.end ());
+    }
   m_virtualToPhysical = virtualToPhysical;
 
   if (m_bloomFilterEnabled)
     {
-      m_bloomFilter.Setup (m_bloomFilterSize);
+      bool epochs = m_bloomFilterEpoch.IsStrictlyPositive ();
+      if (m_bloomFilterSize > 0)
+        {
+          m_bloomFilter.SetupBits (m_bloomFilterSize, m_bloomFilterEntries, epochs);
+        }
+      else
+        {
+          m_bloomFilter.Setup (m_bloomFilterEntries, m_bloomFilterFpr, epochs);
+        }
+      m_bloomFilterRotation = m_bloomFilterEpoch;
+    }
+
+  if (m_admissionMemorySize > 0)
+    {
+      uint32_t sampleSize = m_admissionSampleSize > 0 ? m_admissionSampleSize
+                                                      : 10 * std::max (GetMemorySize (), 1);
+      m_admission.Setup (m_admissionMemorySize * 8, sampleSize);
     }
 }
 
+void
+P4SwitchApp::SetSendCallback (Callback<void, Ptr<Packet>, Ipv4Address, Ipv4Address> sendCallback)
+{
+  m_sendCallback = sendCallback;
+}
+
 void
 P4SwitchApp::StartApplication (void)
 {
@@ -129,7 +484,26 @@ P4SwitchApp::StartApplication (void)
       NS_LOG_INFO ("No Ipv4 with packet intercept facility");
     }
 
-  if (m_socket == 0)
+  if (GetAgingPeriod ().IsStrictlyPositive ())
+    {
+      m_agingEvent = Simulator::Schedule (m_agingStep, m_agingHandler, this);
+    }
+
+  if (m_idleTicks > 0 || m_hardTicks > 0)
+    {
+      m_expiryEvent = Simulator::Schedule (m_expiryTick, m_expiryHandler, this);
+    }
+
+  if (m_adaptiveGenerateProb && m_switchType == GW_LEAF)
+    {
+      NS_ABORT_MSG_IF (m_minGenerateProb > m_maxGenerateProb,
+                       "MinGenerateProbability is above MaxGenerateProbability");
+      m_generateProb = std::min (std::max (m_generateProb, m_minGenerateProb), m_maxGenerateProb);
+      m_generateProbEvent = Simulator::Schedule (m_generateProbInterval,
+                                                 &P4SwitchApp::UpdateGenerateProbability, this);
+    }
+
+  if (m_socket == 0 && m_sendCallback.IsNull ())
     {
       TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
       m_socket = Socket::CreateSocket (GetNode (), tid);
@@ -174,6 +548,15 @@ P4SwitchApp::ReceiveRawPacket (Ptr<Socket> socket)
 void
 P4SwitchApp::StopApplication (void)
 {
+  Simulator::Cancel (m_agingEvent);
+  Simulator::Cancel (m_expiryEvent);
+  Simulator::Cancel (m_generateProbEvent);
+  for (auto &batch : m_controlBatches)
+    {
+      batch.second.flushEvent.Cancel ();
+    }
+  m_controlBatches.clear ();
+
   if (m_socket)
     {
       m_socket->Close ();
@@ -192,56 +575,86 @@ P4SwitchApp::StopApplication (void)
     }
 }
 
+template <typename Cache>
 bool
-P4SwitchApp::HandleProtocolPacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
+P4SwitchApp::HandleProtocolPacket (Cache &cache, Ptr<Packet> packet, Ipv4Header &ipHeader)
 {
-  InvalidationTag tag;
-  if (packet->PeekPacketTag (tag))
+  ControlTag tag;
+  bool control = packet->PeekPacketTag (tag);
+  if (control && !tag.IsLearning ())
     {
       // Invalidation
-      pair<uint32_t, uint32_t> invalidated = tag.GetInvalidation ();
-      uint32_t cachedVal = 0;
-      if (m_cache.Get (invalidated.first, cachedVal))
+      for (uint32_t index = 0; index < tag.GetCount (); ++index)
         {
-          if (cachedVal == invalidated.second)
+          pair<uint32_t, uint32_t> invalidated = tag.GetMapping (index);
+          uint32_t cachedVal = 0;
+          if (cache.Get (invalidated.first, cachedVal))
             {
-              m_cache.Remove (invalidated.first);
+              if (IpUtils::GetUnversionedAddress (cachedVal) == invalidated.second)
+                {
+                  cache.Remove (invalidated.first);
+                  m_installedVictims.erase (invalidated.first);
+                }
             }
         }
     }
 
   if (ipHeader.GetDestination () == m_switchAddress)
     {
-      EvictionTag tag;
-      if (packet->PeekPacketTag (tag))
+      if (control && tag.GetVictimHops () > 0)
+        {
+          for (uint32_t index = 0; index < tag.GetCount (); ++index)
+            {
+              // Only a peer with room takes a victim, the others pass it on
+              pair<uint32_t, uint32_t> victim = tag.GetMapping (index);
+              if (IsOwner (victim.first) && cache.PutIfNotEvict (victim.first, victim.second))
+                {
+                  m_installedVictims.insert (victim.first);
+                  m_victimInstalledTrace (GetNode ()->GetId ());
+                }
+              else
+                {
+                  ForwardVictim (victim, tag.GetVictimHops () + 1);
+                }
+            }
+        }
+      else if (control && tag.IsLearning ())
         {
-          pair<uint32_t, uint32_t> learn = tag.GetEvicted ();
-          m_cache.Put (learn.first, learn.second);
+          for (uint32_t index = 0; index < tag.GetCount (); ++index)
+            {
+              pair<uint32_t, uint32_t> learn = tag.GetMapping (index);
+              if (Admit (cache, learn.first))
+                {
+                  cache.Put (learn.first, learn.second);
+                }
+            }
         }
     }
   else
     {
-      m_socket->SendTo (packet, 0, InetSocketAddress (ipHeader.GetDestination (), SWITCH_PORT));
+      SendToSwitch (packet, ipHeader.GetDestination ());
     }
 
   return false;
 }
 
+template <typename Cache>
 bool
-P4SwitchApp::LocalP4CacheLogic (uint32_t virtualDestinationIp, uint32_t physicalDestinationIp,
-                                Ptr<Packet> packet, Ipv4Header &ipHeader)
+P4SwitchApp::LocalP4CacheLogic (Cache &cache, uint32_t virtualDestinationIp,
+                                uint32_t physicalDestinationIp, Ptr<Packet> packet,
+                                Ipv4Header &ipHeader)
 {
   if (m_gwAddresses.count (physicalDestinationIp))
     {
       uint32_t cachedAddr = 0;
-      if (m_cache.Get (virtualDestinationIp, cachedAddr))
+      if (cache.Get (virtualDestinationIp, cachedAddr))
         {
-          ipHeader.SetDestination (Ipv4Address (cachedAddr));
+          ipHeader.SetDestination (Ipv4Address (IpUtils::GetUnversionedAddress (cachedAddr)));
         }
     }
-  else
+  else if (Admit (cache, virtualDestinationIp))
     {
-      m_cache.Put (virtualDestinationIp, physicalDestinationIp);
+      cache.Put (virtualDestinationIp, physicalDestinationIp);
     }
 
   return true;
@@ -271,7 +684,7 @@ P4SwitchApp::BluebirdProcessPacket (Ptr<Packet> packet)
 void
 P4SwitchApp::PopulateBluebirdCache (uint32_t virtualIp)
 {
-  m_bluebirdCache.Put (virtualIp, m_virtualToPhysical->at (virtualIp));
+  (this->*m_insertHandler) (virtualIp, m_virtualToPhysical->at (virtualIp));
 }
 
 void
@@ -296,14 +709,16 @@ P4SwitchApp::BluebirdTxComplete ()
   BluebirdTxStart (p);
 }
 
+template <typename Cache>
 bool
-P4SwitchApp::BluebirdLogic (uint32_t virtualDestinationIp, uint32_t physicalDestinationIp,
-                            Ptr<Packet> packet, Ipv4Header &ipHeader)
+P4SwitchApp::BluebirdLogic (Cache &cache, uint32_t virtualDestinationIp,
+                            uint32_t physicalDestinationIp, Ptr<Packet> packet,
+                            Ipv4Header &ipHeader)
 {
   if (m_gwAddresses.count (physicalDestinationIp))
     {
       uint32_t cachedAddr = 0;
-      if (m_bluebirdCache.Get (virtualDestinationIp, cachedAddr))
+      if (cache.Get (virtualDestinationIp, cachedAddr))
         {
           ipHeader.SetDestination (Ipv4Address (cachedAddr));
           return true;
@@ -330,6 +745,28 @@ P4SwitchApp::BluebirdLogic (uint32_t virtualDestinationIp, uint32_t physicalDest
   return true;
 }
 
+void
+P4SwitchApp::AgeBloomFilter ()
+{
+  if (!m_bloomFilterEpoch.IsStrictlyPositive () || Simulator::Now () < m_bloomFilterRotation)
+    {
+      return;
+    }
+
+  int64_t epoch = m_bloomFilterEpoch.GetTimeStep ();
+  int64_t elapsed = (Simulator::Now () - m_bloomFilterRotation).GetTimeStep () / epoch + 1;
+  if (elapsed > 1)
+    {
+      // No Put happened in the last full epoch, both generations are stale
+      m_bloomFilter.Clear ();
+    }
+  else
+    {
+      m_bloomFilter.Rotate ();
+    }
+  m_bloomFilterRotation = TimeStep (m_bloomFilterRotation.GetTimeStep () + elapsed * epoch);
+}
+
 void
 P4SwitchApp::GeneratePacketToLeaf (pair<uint32_t, uint32_t> data, Ipv4Address hostAddress)
 {
@@ -342,37 +779,212 @@ P4SwitchApp::GeneratePacketToLeaf (pair<uint32_t, uint32_t> data, Ipv4Address ho
 
 void
 P4SwitchApp::GeneratePacketToAddress (pair<uint32_t, uint32_t> data, Ipv4Address dstAddress,
-                                      bool learning)
+                                      bool learning, uint8_t victimHops)
 {
-  Ptr<Packet> generatedPacket = Create<Packet> (64);
-  if (learning)
+  if (dstAddress == m_switchAddress)
     {
-      EvictionTag tag;
-      tag.SetEvicted (data);
-      generatedPacket->AddPacketTag (tag);
+      return;
     }
-  else
+
+  // Mappings to one switch are batched into one packet per kind
+  uint64_t key = (static_cast<uint64_t> (dstAddress.Get ()) << 8) | (victimHops << 1) | learning;
+  ControlBatch &batch = m_controlBatches[key];
+  if (batch.tag.GetCount () == 0)
+    {
+      batch.tag.SetLearning (learning);
+      batch.tag.SetVictimHops (victimHops);
+      batch.start = Simulator::Now ();
+    }
+  batch.tag.AddMapping (data);
+
+  if (batch.tag.GetCount () >= m_controlBatchSize)
+    {
+      FlushControlBatch (key);
+    }
+  else if (!batch.flushEvent.IsRunning ())
+    {
+      batch.flushEvent =
+          Simulator::Schedule (m_controlBatchTimeout, &P4SwitchApp::FlushControlBatch, this, key);
+    }
+}
+
+void
+P4SwitchApp::FlushControlBatch (uint64_t key)
+{
+  auto it = m_controlBatches.find (key);
+  if (it == m_controlBatches.end ())
+    {
+      return;
+    }
+
+  ControlBatch &batch = it->second;
+  batch.flushEvent.Cancel ();
+  // 8 bytes per mapping, in at least a minimum-size packet
+  Ptr<Packet> generatedPacket =
+      Create<Packet> (std::max<uint32_t> (64, 2 * sizeof (uint32_t) * batch.tag.GetCount ()));
+  generatedPacket->AddPacketTag (batch.tag);
+  m_controlTrace (generatedPacket, Simulator::Now () - batch.start);
+  m_controlBatches.erase (it);
+  SendToSwitch (generatedPacket, Ipv4Address (static_cast<uint32_t> (key >> 8)));
+}
+
+void
+P4SwitchApp::ForwardVictim (pair<uint32_t, uint32_t> victim, uint8_t hops)
+{
+  // The hop limit stops a victim that finds no room from bouncing between peers
+  if (m_victimPeers.empty () || hops > m_victimHopLimit)
+    {
+      return;
+    }
+
+  uint32_t hash = MultiplyShiftHash::Hash<uint32_t> (victim.first, VICTIM_SEED + hops);
+  Ipv4Address peer = m_victimPeers[(static_cast<uint64_t> (hash) * m_victimPeers.size ()) >> 32];
+  m_victimForwardedTrace (GetNode ()->GetId ());
+  GeneratePacketToAddress (victim, peer, true, hops);
+}
+
+void
+P4SwitchApp::UpdateGenerateProbability ()
+{
+  // Misses toward the gateway grow when a new hot set appears and fade once it is cached
+  if (m_gatewayLookups > 0)
+    {
+      double missRatio = static_cast<double> (m_gatewayMisses) / m_gatewayLookups;
+      m_generateProb = m_minGenerateProb + (m_maxGenerateProb - m_minGenerateProb) * missRatio;
+      m_gatewayLookups = m_gatewayMisses = 0;
+      m_generateProbTrace (GetNode ()->GetId (), m_generateProb);
+    }
+
+  m_generateProbEvent = Simulator::Schedule (m_generateProbInterval,
+                                             &P4SwitchApp::UpdateGenerateProbability, this);
+}
+
+uint32_t
+P4SwitchApp::GetOwnerSpine (uint32_t vip)
+{
+  if (m_coreRing)
+    {
+      // The spine wired to the owning core
+      return GetOwnerCore (vip) / m_coresPerSpine;
+    }
+
+  // The high bits of the hash, so the owned VIPs still spread over all slots of a cache
+  uint32_t hash = MultiplyShiftHash::Hash<uint32_t> (vip, OWNER_SEED);
+  return (static_cast<uint64_t> (hash) * m_podWidth) >> 32;
+}
+
+uint32_t
+P4SwitchApp::GetOwnerCore (uint32_t vip)
+{
+  return m_coreOwners.GetOwner (vip);
+}
+
+bool
+P4SwitchApp::IsOwner (uint32_t vip)
+{
+  if (m_coreRing && m_switchType == CORE)
+    {
+      return GetOwnerCore (vip) == ((m_switchAddress.Get () >> 16) & 0xff);
+    }
+  if (!m_exclusiveSpines || (m_switchType != SPINE && m_switchType != GW_SPINE))
+    {
+      return true;
+    }
+  return GetOwnerSpine (vip) == ((m_switchAddress.Get () >> 16) & 0xff);
+}
+
+void
+P4SwitchApp::SteerToOwner (Ptr<Packet> packet, Ipv4Header &ipHeader, uint32_t vip)
+{
+  uint32_t destination = ipHeader.GetDestination ().Get ();
+  uint32_t pod = (m_switchAddress.Get () >> 24) - m_podCount - 1;
+  uint32_t leafOffset = (m_switchAddress.Get () >> 8) & 0xff;
+  bool lookup = m_gwAddresses.count (destination) > 0;
+  // With ExclusiveSpines, gateway lookups and at a gateway leaf the resolved packets the owner
+  // learns from. With only CoreRing, gateway lookups that pass a core on their way out of the pod.
+  bool steer = m_exclusiveSpines ? lookup || m_switchType == GW_LEAF
+                                 : lookup && (destination >> 24) - 1 != pod;
+  // Hosts of this leaf are reached without a spine
+  if (!steer || ((destination >> 24) - 1 == pod && ((destination >> 16) & 0xff) == leafOffset))
     {
-      InvalidationTag tag;
-      tag.SetInvalidation (data);
-      generatedPacket->AddPacketTag (tag);
+      return;
     }
 
-  if (dstAddress != m_switchAddress)
+  SteerTag tag;
+  tag.SetAddress (ipHeader.GetDestination ());
+  packet->AddPacketTag (tag);
+  ipHeader.SetDestination (
+      IpUtils::GetSpineFromLeafAddress (m_podCount, pod, GetOwnerSpine (vip), 0));
+  m_steeredTrace (packet, GetNode ()->GetId ());
+}
+
+void
+P4SwitchApp::SteerToCore (Ptr<Packet> packet, Ipv4Header &ipHeader, uint32_t vip)
+{
+  // Only lookups leaving the pod pass a core, and a spine only reaches its own group of cores
+  uint32_t destination = ipHeader.GetDestination ().Get ();
+  uint32_t pod = (m_switchAddress.Get () >> 24) - 2 * m_podCount - 1;
+  uint32_t core = GetOwnerCore (vip);
+  if (m_gwAddresses.count (destination) == 0 || (destination >> 24) - 1 == pod ||
+      core / m_coresPerSpine != ((m_switchAddress.Get () >> 16) & 0xff))
     {
-      m_socket->SendTo (generatedPacket, 0, InetSocketAddress (dstAddress, SWITCH_PORT));
+      return;
     }
+
+  SteerTag tag;
+  tag.SetAddress (ipHeader.GetDestination ());
+  packet->AddPacketTag (tag);
+  ipHeader.SetDestination (IpUtils::GetCoreAddress (0, core));
+  m_steeredTrace (packet, GetNode ()->GetId ());
 }
 
 bool
-P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
+P4SwitchApp::IsCached (uint32_t key)
+{
+  return (this->*m_findHandler) (key);
+}
+
+uint64_t
+P4SwitchApp::GetExpiredEntries ()
+{
+  return (this->*m_expiredHandler) ();
+}
+
+void
+P4SwitchApp::AddEvictionTag (Ptr<Packet> packet, EvictionTag &tag)
+{
+  if (tag.GetCount ())
+    {
+      packet->AddPacketTag (tag);
+    }
+}
+
+void
+P4SwitchApp::SendToSwitch (Ptr<Packet> packet, Ipv4Address dstAddress)
+{
+  if (m_sendCallback.IsNull ())
+    {
+      m_socket->SendTo (packet, 0, InetSocketAddress (dstAddress, SWITCH_PORT));
+      return;
+    }
+
+  UdpHeader udpHeader;
+  udpHeader.SetSourcePort (SWITCH_PORT);
+  udpHeader.SetDestinationPort (SWITCH_PORT);
+  packet->AddHeader (udpHeader);
+  m_sendCallback (packet, m_switchAddress, dstAddress);
+}
+
+template <typename Cache>
+bool
+P4SwitchApp::ProcessPacket (Cache &cache, Ptr<Packet> packet, Ipv4Header &ipHeader)
 {
   UdpHeader udpHeader;
   packet->RemoveHeader (udpHeader);
 
   if (udpHeader.GetDestinationPort () == SWITCH_PORT)
     {
-      return HandleProtocolPacket (packet, ipHeader);
+      return HandleProtocolPacket (cache, packet, ipHeader);
     }
 
   HopsTag hopsTag;
@@ -394,13 +1006,39 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
   uint32_t virtualDestinationIp = innerHeader.GetDestination ().Get ();
   uint32_t physicalDestinationIp = ipHeader.GetDestination ().Get ();
 
+  SteerTag steerTag;
+  if (physicalDestinationIp == m_switchAddress.Get () && packet->RemovePacketTag (steerTag))
+    {
+      // A leaf or a spine steered the packet to this switch, which owns its VIP
+      ipHeader.SetDestination (steerTag.GetAddress ());
+      physicalDestinationIp = steerTag.GetAddress ().Get ();
+    }
+
+  // With versioned mappings, learned host addresses keep the epoch the sending host expects
+  EpochTag epochTag;
+  bool versioned = packet->PeekPacketTag (epochTag);
+  uint32_t learnedDestinationIp =
+      versioned ? IpUtils::GetVersionedAddress (physicalDestinationIp,
+                                                epochTag.GetDestinationEpoch ())
+                : physicalDestinationIp;
+  uint32_t learnedSourceIp =
+      versioned ? IpUtils::GetVersionedAddress (ipHeader.GetSource ().Get (),
+                                                epochTag.GetSourceEpoch ())
+                : ipHeader.GetSource ().Get ();
+
+  if (m_admissionMemorySize > 0)
+    {
+      m_admission.Record (virtualDestinationIp);
+    }
+
   if (m_simMode == SimulationParameters::Mode::LocalLearning)
     {
-      return LocalP4CacheLogic (virtualDestinationIp, physicalDestinationIp, packet, ipHeader);
+      return LocalP4CacheLogic (cache, virtualDestinationIp, physicalDestinationIp, packet,
+                                ipHeader);
     }
   else if (m_simMode == SimulationParameters::Mode::Bluebird)
     {
-      return BluebirdLogic (virtualDestinationIp, physicalDestinationIp, packet, ipHeader);
+      return BluebirdLogic (cache, virtualDestinationIp, physicalDestinationIp, packet, ipHeader);
     }
 
   InvalidationTag invalidationTag;
@@ -408,15 +1046,15 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
     {
       pair<uint32_t, uint32_t> invalidated = invalidationTag.GetInvalidation ();
       uint32_t cachedVal = 0;
-      if (m_cache.Get (invalidated.first, cachedVal))
+      if (cache.Get (invalidated.first, cachedVal))
         {
-          if (cachedVal == invalidated.second)
+          if (IpUtils::GetUnversionedAddress (cachedVal) == invalidated.second)
             {
-              m_cache.Remove (invalidated.first);
+              cache.Remove (invalidated.first);
             }
           else
             {
-              ipHeader.SetDestination (Ipv4Address (cachedVal));
+              ipHeader.SetDestination (Ipv4Address (IpUtils::GetUnversionedAddress (cachedVal)));
             }
         }
 
@@ -428,7 +1066,8 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
               bool generate = m_generateInvalidation;
               if (m_bloomFilterEnabled)
                 {
-                  if (m_bloomFilter.Get (hitTag.GetId ()) == 1)
+                  AgeBloomFilter ();
+                  if (m_bloomFilter.Get (hitTag.GetId ()))
                     {
                       generate = false;
                     }
@@ -458,10 +1097,12 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
   if (m_switchType == SPINE && m_gwAddresses.count (physicalDestinationIp))
     {
       uint32_t cachedVal = 0;
-      if (m_cache.Get (virtualDestinationIp, cachedVal))
+      if (GetCurrent (cache, virtualDestinationIp, cachedVal, packet))
         {
+          uint32_t first, last;
+          GetRange (cache, virtualDestinationIp, first, last);
           packet->RemovePacketTag (tag);
-          tag.SetEvicted (std::make_pair (virtualDestinationIp, cachedVal));
+          tag.AddEvicted (std::make_pair (first, cachedVal), last, m_evictionTagEntries);
           packet->AddPacketTag (tag);
           return true;
         }
@@ -471,84 +1112,117 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
     {
       if (m_sourceLearning && ipHeader.GetTtl () < m_defaultTtl - 1)
         {
-          m_cache.Put (innerHeader.GetSource ().Get (), ipHeader.GetSource ().Get ());
+          if (Admit (cache, innerHeader.GetSource ().Get ()))
+            {
+              cache.Put (innerHeader.GetSource ().Get (), learnedSourceIp);
+              m_sourceLearnedTrace (innerHeader.GetSource ().Get (), m_switchAddress);
+            }
         }
       else if (m_gwAddresses.count (physicalDestinationIp) == 0)
         {
-          m_cache.PutIfNotEvict (virtualDestinationIp, physicalDestinationIp);
+          cache.PutIfNotEvict (virtualDestinationIp, learnedDestinationIp);
         }
     }
   else
     {
-      pair<uint32_t, uint32_t> learn = std::make_pair (virtualDestinationIp, physicalDestinationIp);
+      pair<uint32_t, uint32_t> learn = std::make_pair (virtualDestinationIp, learnedDestinationIp);
+      uint32_t learnLast = virtualDestinationIp;
       bool foundTag = false;
+      uint32_t learnIndex = 0;
       if (packet->RemovePacketTag (tag))
         {
           foundTag = true;
-          learn = tag.GetEvicted ();
-          if (learn.first == 0 && learn.second == 0)
+          // Any entry may mark the destination as migrated, not only the one learned
+          if (tag.FindObsolete () < tag.GetCount ())
             {
               // Remove obsolete entry -> migration
-              if (m_cache.Find (virtualDestinationIp))
+              if (cache.Find (virtualDestinationIp))
                 {
-                  m_cache.Remove (virtualDestinationIp);
+                  cache.Remove (virtualDestinationIp);
                 }
               packet->AddPacketTag (tag);
 
               return true;
             }
+          // A core learns only the entry of the destination, an exclusive spine the oldest entry
+          // it owns, and the other switches the oldest entry
+          if (m_switchType == CORE && tag.FindEvicted (virtualDestinationIp) < tag.GetCount ())
+            {
+              learnIndex = tag.FindEvicted (virtualDestinationIp);
+            }
+          while (learnIndex + 1 < tag.GetCount () && !IsOwner (tag.GetEvicted (learnIndex).first))
+            {
+              ++learnIndex;
+            }
+          learn = tag.GetEvicted (learnIndex);
+          learnLast = tag.GetEvictedLast (learnIndex);
         }
+      // A cache of single keys keeps the destination when the learned range covers it
+      uint32_t learnKey = learn.first <= virtualDestinationIp && virtualDestinationIp <= learnLast
+                              ? virtualDestinationIp
+                              : learn.first;
 
-      if (foundTag || m_gwAddresses.count (physicalDestinationIp) == 0)
+      if (!IsOwner (learn.first))
+        {
+          AddEvictionTag (packet, tag);
+        }
+      else if (foundTag || m_gwAddresses.count (physicalDestinationIp) == 0)
         {
           pair<uint32_t, uint32_t> evicted;
           if (m_switchType == CORE)
             {
               if (foundTag)
                 {
-                  uint8_t bit = m_cache.GetBit (learn.first);
-                  bool inCache = m_cache.Find (learn.first);
+                  uint8_t bit = cache.GetBit (learnKey);
+                  bool inCache = cache.Find (learnKey);
 
-                  if (learn.first == virtualDestinationIp && bit == 0 && !inCache)
+                  if (learn.first <= virtualDestinationIp && virtualDestinationIp <= learnLast &&
+                      bit == 0 && !inCache && Admit (cache, learnKey))
                     {
-                      if (m_cache.Put (learn.first, learn.second, evicted))
+                      tag.RemoveEvicted (learnIndex);
+                      if (PutRange (cache, learn.first, learnLast, learnKey, learn.second, evicted))
                         {
-                          tag.SetEvicted (evicted);
-                          packet->AddPacketTag (tag);
+                          if (m_victimForwarding)
+                            {
+                              ForwardVictim (evicted, 1);
+                            }
+                          else
+                            {
+                              tag.AddEvicted (evicted, GetEvictedLast (cache, evicted.first),
+                                              m_evictionTagEntries);
+                            }
                         }
                     }
-                  else
-                    {
-                      packet->AddPacketTag (tag);
-                    }
+                  AddEvictionTag (packet, tag);
                 }
               else
                 {
-                  m_cache.PutIfNotEvict (learn.first, learn.second);
+                  cache.PutIfNotEvict (learn.first, learn.second);
                 }
             }
           else
             {
               if ((m_switchType == SPINE || m_switchType == GW_SPINE) && m_accessBit)
                 {
-                  uint8_t bit = m_cache.GetBit (learn.first);
-                  bool inCache = m_cache.Find (learn.first);
+                  uint8_t bit = cache.GetBit (learnKey);
+                  bool inCache = cache.Find (learnKey);
 
-                  if (bit == 1 && !inCache)
+                  if ((bit == 1 && !inCache) || !Admit (cache, learnKey))
+                    {
+                      AddEvictionTag (packet, tag);
+                    }
+                  else
                     {
                       if (foundTag)
                         {
-                          packet->AddPacketTag (tag);
+                          tag.RemoveEvicted (learnIndex);
                         }
-                    }
-                  else if (bit == 0 || inCache)
-                    {
-                      bool cacheEvict = m_cache.Put (learn.first, learn.second, evicted);
-                      if (cacheEvict)
+                      if (PutRange (cache, learn.first, learnLast, learnKey, learn.second, evicted))
                         {
-                          tag.SetEvicted (evicted);
-                          packet->AddPacketTag (tag);
+                          tag.AddEvicted (evicted, GetEvictedLast (cache, evicted.first),
+                                          m_evictionTagEntries);
                         }
+                      AddEvictionTag (packet, tag);
                     }
                 }
               else
@@ -563,30 +1237,323 @@ P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
                                             sourceTag.GetSource ());
                     }
 
-                  bool cacheEvict = m_cache.Put (learn.first, learn.second, evicted);
-                  if (cacheEvict)
+                  if (Admit (cache, learnKey))
                     {
-                      tag.SetEvicted (evicted);
-                      packet->AddPacketTag (tag);
+                      if (foundTag)
+                        {
+                          tag.RemoveEvicted (learnIndex);
+                        }
+                      if (PutRange (cache, learn.first, learnLast, learnKey, learn.second, evicted))
+                        {
+                          tag.AddEvicted (evicted, GetEvictedLast (cache, evicted.first),
+                                          m_evictionTagEntries);
+                        }
                     }
+                  AddEvictionTag (packet, tag);
                 }
             }
         }
     }
   if (m_gwAddresses.count (physicalDestinationIp))
     {
+      m_gatewayLookups++;
       uint32_t cached_addr = 0;
-      if (m_cache.Get (virtualDestinationIp, cached_addr))
+      if (GetCurrent (cache, virtualDestinationIp, cached_addr, packet))
         {
           HitTag tag;
           tag.SetAddress (m_switchAddress);
           tag.SetId (GetNode ()->GetId ());
           packet->AddPacketTag (tag);
-          ipHeader.SetDestination (Ipv4Address (cached_addr));
+          ipHeader.SetDestination (Ipv4Address (IpUtils::GetUnversionedAddress (cached_addr)));
           m_cacheHit (packet, GetNode ()->GetId ());
+          auto mapping = m_virtualToPhysical->find (virtualDestinationIp);
+          if (mapping == m_virtualToPhysical->end () ||
+              ipHeader.GetDestination ().Get () != mapping->second)
+            {
+              m_staleHitTrace (GetNode ()->GetId ());
+            }
+          if (m_installedVictims.erase (virtualDestinationIp))
+            {
+              m_victimHitTrace (GetNode ()->GetId ());
+            }
           return true;
         }
+      m_gatewayMisses++;
+    }
+
+  if ((m_exclusiveSpines || m_coreRing) && (m_switchType == LEAF || m_switchType == GW_LEAF))
+    {
+      SteerToOwner (packet, ipHeader, virtualDestinationIp);
+    }
+  else if (m_coreRing && (m_switchType == SPINE || m_switchType == GW_SPINE))
+    {
+      SteerToCore (packet, ipHeader, virtualDestinationIp);
     }
 
   return true;
 }
+
+template <typename Cache>
+bool
+P4SwitchApp::ProcessWith (Ptr<Packet> packet, Ipv4Header &ipHeader)
+{
+  Cache &cache = std::get<Cache> (m_caches);
+  if (m_idleTicks > 0 || m_hardTicks > 0)
+    {
+      SetCacheClock (cache, GetExpiryClock ());
+    }
+  return ProcessPacket (cache, packet, ipHeader);
+}
+
+template <typename Cache>
+bool
+P4SwitchApp::GetCurrent (Cache &cache, uint32_t vip, uint32_t &value, Ptr<Packet> packet)
+{
+  EpochTag epochTag;
+  if (!cache.Get (vip, value))
+    {
+      return false;
+    }
+  if (!packet->PeekPacketTag (epochTag) ||
+      IpUtils::GetAddressEpoch (value) == epochTag.GetDestinationEpoch ())
+    {
+      return true;
+    }
+
+  // The mapping moved since this entry was learned, so the packet goes on to the gateway
+  cache.Remove (vip);
+  m_installedVictims.erase (vip);
+  m_staleEntryTrace (GetNode ()->GetId ());
+  return false;
+}
+
+template <typename Cache>
+bool
+P4SwitchApp::Admit (Cache &cache, uint32_t key)
+{
+  uint32_t victim;
+  if (m_admissionMemorySize == 0 || !cache.GetVictim (key, victim))
+    {
+      return true;
+    }
+
+  bool admitted = m_admission.Admit (key, victim);
+  m_admissionTrace (GetNode ()->GetId (), admitted);
+  return admitted;
+}
+
+template <typename Cache>
+void
+P4SwitchApp::InsertWith (uint32_t key, uint32_t value)
+{
+  Cache &cache = std::get<Cache> (m_caches);
+  if (m_idleTicks > 0 || m_hardTicks > 0)
+    {
+      SetCacheClock (cache, GetExpiryClock ());
+    }
+  cache.Put (key, value);
+}
+
+template <typename Cache>
+bool
+P4SwitchApp::FindWith (uint32_t key)
+{
+  return std::get<Cache> (m_caches).Find (key);
+}
+
+template <typename Cache>
+void
+P4SwitchApp::AgeWith ()
+{
+  Cache &cache = std::get<Cache> (m_caches);
+  size_t slots = cache.GetSlots ();
+  if (slots > 0)
+    {
+      // Move the hand by the share of the table that one step covers in the aging period
+      double share = m_agingStep.GetSeconds () / GetAgingPeriod ().GetSeconds ();
+      size_t count = std::min<size_t> (std::max (std::ceil (share * slots), 1.0), slots);
+      m_agingHand %= slots;
+      size_t head = std::min (count, slots - m_agingHand);
+      cache.ClearBits (m_agingHand, head);
+      cache.ClearBits (0, count - head);
+      m_agingHand = (m_agingHand + count) % slots;
+    }
+
+  m_agingEvent = Simulator::Schedule (m_agingStep, m_agingHandler, this);
+}
+
+Time
+P4SwitchApp::GetAgingPeriod ()
+{
+  if (m_switchType == LEAF || m_switchType == GW_LEAF)
+    {
+      return m_leafAgingPeriod;
+    }
+  if (m_switchType == CORE)
+    {
+      return m_coreAgingPeriod;
+    }
+  return m_spineAgingPeriod;
+}
+
+template <typename Cache>
+void
+P4SwitchApp::ExpireWith ()
+{
+  Cache &cache = std::get<Cache> (m_caches);
+  SetCacheClock (cache, GetExpiryClock ());
+  size_t slots = cache.GetSlots ();
+  if (slots > 0)
+    {
+      // Sweep the table once per shortest timeout, so the stamps never wrap around unseen
+      uint16_t ticks = m_idleTicks > 0 && m_hardTicks > 0 ? std::min (m_idleTicks, m_hardTicks)
+                                                          : std::max (m_idleTicks, m_hardTicks);
+      size_t count = std::min<size_t> ((slots + ticks - 1) / ticks, slots);
+      m_expiryHand %= slots;
+      size_t head = std::min (count, slots - m_expiryHand);
+      ExpireSlots (cache, m_expiryHand, head);
+      ExpireSlots (cache, 0, count - head);
+      m_expiryHand = (m_expiryHand + count) % slots;
+    }
+
+  m_expiryEvent = Simulator::Schedule (m_expiryTick, m_expiryHandler, this);
+}
+
+template <typename Cache>
+uint64_t
+P4SwitchApp::GetExpiredWith ()
+{
+  return GetExpirations (std::get<Cache> (m_caches));
+}
+
+void
+P4SwitchApp::GetExpiryTicks (uint16_t &idleTicks, uint16_t &hardTicks)
+{
+  Time idle = m_spineIdleTimeout, hard = m_spineHardTimeout;
+  if (m_switchType == LEAF || m_switchType == GW_LEAF)
+    {
+      idle = m_leafIdleTimeout;
+      hard = m_leafHardTimeout;
+    }
+  else if (m_switchType == CORE)
+    {
+      idle = m_coreIdleTimeout;
+      hard = m_coreHardTimeout;
+    }
+
+  // Half the clock range, so an entry is swept before its stamp wraps around
+  auto toTicks = [this] (Time timeout) -> uint16_t {
+    if (!timeout.IsStrictlyPositive ())
+      {
+        return 0;
+      }
+    int64_t ticks = (timeout.GetTimeStep () + m_expiryTick.GetTimeStep () - 1) /
+                    m_expiryTick.GetTimeStep ();
+    NS_ABORT_MSG_IF (ticks > INT16_MAX,
+                     "Timeout " << timeout << " is more than 32767 ExpiryTick ticks");
+    return ticks;
+  };
+  NS_ABORT_MSG_IF ((idle.IsStrictlyPositive () || hard.IsStrictlyPositive ()) &&
+                       !m_expiryTick.IsStrictlyPositive (),
+                   "ExpiryTick must be positive");
+  idleTicks = toTicks (idle);
+  hardTicks = toTicks (hard);
+}
+
+uint16_t
+P4SwitchApp::GetExpiryClock ()
+{
+  return Simulator::Now ().GetTimeStep () / m_expiryTick.GetTimeStep ();
+}
+
+int
+P4SwitchApp::GetMemorySize ()
+{
+  int memorySize = -1;
+  switch (m_switchType)
+    {
+    case LEAF:
+      memorySize = m_leafMemorySize;
+      break;
+    case GW_LEAF:
+      memorySize = m_gwLeafMemorySize;
+      break;
+    case GW_SPINE:
+      memorySize = m_gwSpineMemorySize;
+      break;
+    case SPINE:
+      memorySize = m_spineMemorySize;
+      break;
+    case CORE:
+      memorySize = m_coreMemorySize;
+      break;
+    }
+  if (memorySize >= 0)
+    {
+      return memorySize;
+    }
+  return m_memoryBytes > 0 ? m_memoryBytes / GetEntryBytes () : m_memorySize;
+}
+
+uint32_t
+P4SwitchApp::GetEntryBytes ()
+{
+  // The key and the value, a range entry has a first and a last key
+  uint32_t keyBytes = sizeof (uint32_t) * (GetCachePolicy () == RANGE ? 2 : 1);
+  uint32_t valueBytes = UsesLocators () ? sizeof (uint16_t) : sizeof (uint32_t);
+  // The 16-bit stamps of the enabled timeouts
+  uint16_t idleTicks, hardTicks;
+  GetExpiryTicks (idleTicks, hardTicks);
+  uint32_t stampBytes = sizeof (uint16_t) * ((idleTicks > 0) + (hardTicks > 0));
+  return keyBytes + valueBytes + stampBytes;
+}
+
+bool
+P4SwitchApp::UsesLocators ()
+{
+  return m_compactLocators && IsRegisterPolicy (GetCachePolicy ());
+}
+
+enum P4SwitchApp::SwitchType
+P4SwitchApp::GetSwitchType ()
+{
+  return m_switchType;
+}
+
+enum CachePolicy
+P4SwitchApp::GetCachePolicy ()
+{
+  enum CachePolicy policy = m_spineCachePolicy;
+  if (m_switchType == LEAF || m_switchType == GW_LEAF)
+    {
+      policy = m_leafCachePolicy;
+    }
+  else if (m_switchType == CORE)
+    {
+      policy = m_coreCachePolicy;
+    }
+
+  if (policy == DEFAULT_POLICY)
+    {
+      policy = m_cachePolicy;
+    }
+
+  if (policy == DEFAULT_POLICY)
+    {
+      if (m_simMode == SimulationParameters::Mode::Bluebird)
+        {
+          policy = LRU;
+        }
+      else
+        {
+          policy = m_associativity > 1 ? SET_ASSOCIATIVE : DIRECT_MAPPED;
+        }
+    }
+  return policy;
+}
+
+bool
+P4SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
+{
+  return (this->*m_packetHandler) (packet, ipHeader);
+}
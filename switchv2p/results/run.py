@@ -7,11 +7,14 @@ import itertools
 import json
 import numpy as np
 import argparse
+import csv
 
 ADDRESS_SPACE_SIZE = {"alibaba": 410796, "hadoop": 80 * 128, "websearch": 80 * 128, "microburst": 80 * 128, "video": 80 * 128}
 
 SWITCH_COUNT = {"alibaba": 816, "hadoop": 80, "websearch": 80, "microburst": 80, "video": 80}
 NS3_HOME = os.environ['NS3_HOME']
+MRC = os.environ.get('SWITCHV2P_MRC', os.path.join(NS3_HOME, 'build-tools/mrc'))
+CORE_COUNT = 16
 MAX_PROC = 30 # Set to 10 for Alibaba and Controller.
 PLACEMENT = {
     "hadoop": os.path.join(
@@ -88,7 +91,7 @@ def generate_configs(simMode, workload, gwScaling, topoScaling):
     if simMode != "GwCache":
         if simMode == "LocalLearning":
             config_options["randomHashFunction"] = ["true"]
-        if simMode == "SwitchV2P":
+        if simMode in ["SwitchV2P", "CacheOnly"]:
             config_options["randomHashFunction"] = ["false"]
             config_options["sourceLearning"] = ["true"]
             config_options["accessBit"] = ["true"]
@@ -110,11 +113,37 @@ def get_sim_modes():
         "Controller-300",
     ]
 
-def get_command_line(simMode, workload, config, output_file, topoScaling, gwScaling):
+def get_topology_args(config, ports, podWidth):
+    # The topology of a run, shared by the simulation and mrc so both model the same pods
+    return [
+        "--topology=Fattree",
+        f"--ports={ports}",
+        f"--core={CORE_COUNT}",
+        f"--podWidth={podWidth}",
+        f"--gwLeaves={config['gwLeaves']}",
+    ]
+
+
+def get_memory_split(workload, config, ports, podWidth):
+    # Per-switch entries of every switch type, split by the mrc budget optimizer
+    command = [
+        MRC,
+        f"--placement={PLACEMENT[workload]}",
+        f"--trace={TRACE[workload]}",
+        *get_topology_args(config, ports, podWidth),
+        "--gatewayPerFlowLoadBalancing",
+        "--perPacket",
+        f"--budget={config['mem_size']}",
+    ]
+    output = subprocess.run(command, check=True, capture_output=True, text=True).stdout
+    return {row["switch_type"]: int(row["entries"]) for row in csv.DictReader(output.splitlines())}
+
+
+def get_command_line(simMode, workload, config, output_file, topoScaling, gwScaling, split=False):
     cli = '"sim '
     if workload in ['microburst', 'video']:
         cli += '--udpMode '
-    cli += '--gatewayPerFlowLoadBalancing --ports={} --podWidth={} --topology=Fattree --gwLeaves={} --IlpControllerApp::Interval={} --IlpControllerApp::MemorySize={} --SwitchApp::MemorySize={} --P4SwitchApp::MemorySize={} --P4SwitchApp::RandomHashFunction={} --P4SwitchApp::SourceLearning={} --P4SwitchApp::AccessBit={} --P4SwitchApp::GenerateProbability={} --simMode={}  --placement={} --trace={} --output={}"'
+    cli += '--gatewayPerFlowLoadBalancing {} --IlpControllerApp::Interval={} --IlpControllerApp::MemorySize={} --SwitchApp::MemorySize={} --P4SwitchApp::MemorySize={} --P4SwitchApp::RandomHashFunction={} --P4SwitchApp::SourceLearning={} --P4SwitchApp::AccessBit={} --P4SwitchApp::GenerateProbability={} --simMode={}  --placement={} --trace={} --output={}"'
 
     ports = 8
     podWidth = 4
@@ -161,10 +190,16 @@ def get_command_line(simMode, workload, config, output_file, topoScaling, gwScal
         config['gw_count'] = len(config['gwLeaves'].split(','))
 
 
+    if split and simMode in ["SwitchV2P", "CacheOnly"]:
+        config["memory_split"] = get_memory_split(workload, config, ports, podWidth)
+        cli = cli[:-1]
+        for switchType, attribute in [("leaf", "Leaf"), ("gw_leaf", "GwLeaf"), ("spine", "Spine"),
+                                      ("gw_spine", "GwSpine"), ("core", "Core")]:
+            cli += f' --P4SwitchApp::{attribute}MemorySize={config["memory_split"][switchType]}'
+        cli += '"'
+
     return cli.format(
-        ports,
-        podWidth,
-        config["gwLeaves"],
+        " ".join(get_topology_args(config, ports, podWidth)),
         interval,
         per_switch_memory,
         per_switch_memory,
@@ -201,7 +236,7 @@ def get_default_output_dir(workload, topoScaling, gwScaling):
 
     return create_dir_if_not_exists(dirName)
 
-def run_workload(workload, gwScaling=False, topoScaling=False, outputDir=None):
+def run_workload(workload, gwScaling=False, topoScaling=False, outputDir=None, split=False):
     # os.system('pkill -9 ns3.36.1')
 
     if workload not in ["hadoop", "websearch", "alibaba", "microburst", "video"]:
@@ -257,7 +292,7 @@ def run_workload(workload, gwScaling=False, topoScaling=False, outputDir=None):
                 os.makedirs(experiment_dir)
                 output_file = os.path.join(experiment_dir, "results.json")
 
-                cli = get_command_line(mode, workload, config, output_file, topoScaling, gwScaling)
+                cli = get_command_line(mode, workload, config, output_file, topoScaling, gwScaling, split)
 
                 config["cli"] = cli
                 with open(os.path.join(experiment_dir, "config.json"), "w") as out_file:
@@ -297,9 +332,11 @@ def main():
     group = parser.add_mutually_exclusive_group()
     group.add_argument('--gw', action=argparse.BooleanOptionalAction)
     group.add_argument('--topo', action=argparse.BooleanOptionalAction)
+    parser.add_argument('--split', action='store_true',
+                    help='Split the memory of SwitchV2P over the switch types with the mrc tool')
     args = parser.parse_args()
 
-    run_workload(args.workload, args.gw, args.topo)
+    run_workload(args.workload, args.gw, args.topo, split=args.split)
 
     return 0
 
@@ -6,7 +6,9 @@ NS3_EXE=$NS3_HOME/ns3
 RESULTS=$NS3_HOME/scratch/switchv2p/results/incast
 PLACEMENT=$NS3_HOME/scratch/switchv2p/datasets/placement_n128_v80.json
 TRACE=$NS3_HOME/scratch/switchv2p/datasets/incast.csv
-MODES=("ondemand" "nocache" "switchv2p" "switchv2p_invalidations" "switchv2p_invalidations_bf")
+# Migrates the incast sender 80, whose mapping the destination leaf learns from its packets
+SENDER_SCHEDULE=$RESULTS/sender_schedule.csv
+MODES=("ondemand" "nocache" "switchv2p" "switchv2p_invalidations" "switchv2p_invalidations_bf" "switchv2p_epochs" "switchv2p_directory" "switchv2p_directory_sender")
 get_cli () {
     local cli="$NS3_EXE run --no-build \"sim --udpMode --ports=8 --topology=Fattree --gatewayPerFlowLoadBalancing --gwLeaves=0,10,20,31 --P4SwitchApp::MemorySize=12 --P4SwitchApp::RandomHashFunction=false --P4SwitchApp::SourceLearning=true --P4SwitchApp::AccessBit=true --P4SwitchApp::GenerateProbability=0.005 --migration --migrationTs=500 --migrationContainerId=5202 --migrationDestinationLeaf=17 --migrationDestinationHost=0 --placement=$PLACEMENT --trace=$TRACE --output=$RESULTS/$1.json"
     case $1 in
@@ -25,6 +27,15 @@ get_cli () {
         switchv2p_invalidations_bf)
             cli="$cli --P4SwitchApp::BloomFilter=true --P4SwitchApp::GenerateInvalidations=true --simMode=SwitchV2P"
             ;;
+        switchv2p_epochs)
+            cli="$cli --P4SwitchApp::BloomFilter=false --versionedMappings --simMode=SwitchV2P"
+            ;;
+        switchv2p_directory)
+            cli="$cli --P4SwitchApp::BloomFilter=false --cacheDirectory --simMode=SwitchV2P"
+            ;;
+        switchv2p_directory_sender)
+            cli="$cli --P4SwitchApp::BloomFilter=false --cacheDirectory --migrationSchedule=$SENDER_SCHEDULE --simMode=SwitchV2P"
+            ;;
         *)
             exit 1
             ;;
@@ -37,6 +48,7 @@ get_cli () {
 if [[ ! -d $RESULTS ]]; then
     mkdir $RESULTS
 fi
+echo "500,80,17,0" > $SENDER_SCHEDULE
 
 for mode in ${MODES[@]}; do
   echo "Running $mode"
@@ -1,9 +1,12 @@
 #include "include/sim-base.h"
+#include "include/epoch-tag.h"
 #include "include/ip-utils.h"
 #include "ns3/virtual-net-device-module.h"
 
 NS_LOG_COMPONENT_DEFINE ("Simulation");
 
+const uint32_t SimulationBase::SEGMENT_SIZE = 1024;
+
 SimulationBase::SimulationBase (SimulationParameters simParameters, ContainerGroups containerGroups,
                                 MigrationParams migParams)
     : m_containerGroups (containerGroups),
@@ -19,7 +22,8 @@ SimulationBase::SimulationBase (SimulationParameters simParameters, ContainerGro
       m_nodes (m_leafCount),
       m_swToSwDevice (m_spineCount, vector<NetDeviceContainer> (m_podWidth)),
       m_coreToSpineDevice (m_coreCount, vector<NetDeviceContainer> (m_podCount)),
-      m_simParameters (simParameters)
+      m_simParameters (simParameters),
+      m_locatorEpochs (migParams.versionedMappings ? EpochTag::EPOCHS : 1)
 {
   NS_LOG_DEBUG ("Pod width = " << m_podWidth);
   NS_ASSERT (m_simParameters.NumOfPorts >= 8);
@@ -38,7 +42,8 @@ SimulationBase::SimulationBase (SimulationParameters simParameters, ContainerGro
       m_nodeToSwDevice.push_back (vector<NetDeviceContainer> (count));
       m_socketHelpers.push_back (vector<SocketHelper> (
           count,
-          SocketHelper (m_virtualToPhysical, m_misdeliveryCount, m_lastMisdelivered,
+          SocketHelper (m_virtualToPhysical, m_mappingEpochs, m_vmLocations,
+                        m_misdeliveryCount, m_lastMisdelivered,
                         simParameters.GatewayPerFlowLoadBalancing, simParameters, migParams)));
       m_onDemandCaches.push_back (vector<set<uint32_t>> (count));
       NS_ASSERT_MSG (count <= 255, "Leaf #" << i << " with " << count << " nodes");
@@ -69,6 +74,17 @@ SimulationBase::AssignIds ()
     }
 }
 
+HostLocators
+SimulationBase::GetHostLocators () const
+{
+  size_t hostsPerLeaf = 1;
+  for (const auto &leaf : m_containerGroups)
+    {
+      hostsPerLeaf = std::max (hostsPerLeaf, leaf.size ());
+    }
+  return HostLocators (m_leafCount, m_podWidth, hostsPerLeaf, m_locatorEpochs);
+}
+
 void
 SimulationBase::Run ()
 {
@@ -110,7 +126,7 @@ SimulationBase::Configure ()
   // LogComponentEnable ("UdpSocketImpl", LOG_LEVEL_INFO);
 
   // Packet::EnablePrinting ();
-  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1024));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (SEGMENT_SIZE));
   Config::SetDefault ("ns3::TcpSocket::RcvBufSize",
                       UintegerValue (50 * 1024 * 1024));
   Config::SetDefault ("ns3::TcpSocket::SndBufSize",
@@ -423,13 +439,36 @@ SimulationBase::AssignPhysicalIps ()
 }
 
 void
-SimulationBase::SetupTunnel ()
+SimulationBase::MapContainers ()
 {
   for (size_t i = 0; i < m_gws.size (); ++i)
     {
       m_gwAddresses.push_back (IpUtils::GetNodePhysicalAddress (
           m_gws[i].first / m_podWidth, m_gws[i].first % m_podWidth, m_gws[i].second));
     }
+  for (uint32_t i = 0; i < m_leafCount; ++i)
+    for (size_t j = 0; j < m_containerGroups[i].size (); ++j)
+      {
+        Ipv4Address physicalAddress =
+            IpUtils::GetNodePhysicalAddress (i / m_podWidth, i % m_podWidth, j);
+        for (size_t k = 0; k < m_containerGroups[i][j].size (); ++k)
+          {
+            uint32_t containerId = m_containerToId[m_containerGroups[i][j][k]];
+            m_virtualToPhysical[IpUtils::GetContainerVirtualAddress (containerId).Get ()] =
+                physicalAddress.Get ();
+          }
+
+        m_socketHelpers[i][j].m_gatewayRange = m_containerToId.size () / m_gws.size ();
+        m_socketHelpers[i][j].m_gatewayAddresses = m_gwAddresses;
+        m_socketHelpers[i][j].m_physicalAddress = physicalAddress;
+        m_socketHelpers[i][j].m_onDemandCache = &m_onDemandCaches[i][j];
+      }
+}
+
+void
+SimulationBase::SetupTunnel ()
+{
+  MapContainers ();
   for (uint32_t i = 0; i < m_leafCount; ++i)
     for (size_t j = 0; j < m_containerGroups[i].size (); ++j)
       {
@@ -454,20 +493,12 @@ SimulationBase::SetupTunnel ()
             ipv4->AddAddress (
                 iface, Ipv4InterfaceAddress (IpUtils::GetContainerVirtualAddress (containerId),
                                              IpUtils::GetClassAMask ()));
-
-            m_virtualToPhysical[IpUtils::GetContainerVirtualAddress (containerId).Get ()] =
-                IpUtils::GetNodePhysicalAddress (i / m_podWidth, i % m_podWidth, j).Get ();
           }
         ipv4->SetUp (iface);
 
         m_socketHelpers[i][j].m_node = node;
         m_socketHelpers[i][j].m_socket = socket;
         m_socketHelpers[i][j].m_vDev = vDev;
-        m_socketHelpers[i][j].m_gatewayRange = m_containerToId.size () / m_gws.size ();
-        m_socketHelpers[i][j].m_gatewayAddresses = m_gwAddresses;
-        m_socketHelpers[i][j].m_physicalAddress =
-            IpUtils::GetNodePhysicalAddress (i / m_podWidth, i % m_podWidth, j);
-        m_socketHelpers[i][j].m_onDemandCache = &m_onDemandCaches[i][j];
       }
 }
 
@@ -3,7 +3,7 @@
 const map<string, enum SimulationParameters::Mode> SimulationParameters::simulationModeMap =
     boost::assign::map_list_of ("Controller", Controller) ("SwitchV2P", SwitchV2P) (
         "GwCache", GwCache) ("LocalLearning", LocalLearning) ("NoCache", NoCache) (
-        "Direct", Direct) ("Bluebird", Bluebird) ("OnDemand", OnDemand);
+        "Direct", Direct) ("Bluebird", Bluebird) ("OnDemand", OnDemand) ("CacheOnly", CacheOnly);
 
 const map<string, enum SimulationParameters::Topology> SimulationParameters::simulationTopologyMap =
     boost::assign::map_list_of ("Clos", CLOS) ("Fattree", FATTREE);
@@ -1,9 +1,16 @@
 #include "include/migration-params.h"
 #include "include/trace-sim.h"
+#include "ns3/test.h"
 #include <boost/algorithm/string.hpp>
 int
 main (int argc, char *argv[])
 {
+  // sim --test [--suite=<name>] [--verbose] runs the unit test suites linked into sim
+  if (argc > 1 && string (argv[1]) == "--test")
+    {
+      return TestRunner::Run (argc - 1, argv + 1);
+    }
+
   string placementFile = "simple_placement.json";
   string traceFile = "simple_trace.csv";
   string outputFile = "output.json";
@@ -15,7 +22,9 @@ main (int argc, char *argv[])
   string gwLeavesStr = "0";
   bool migrationTest = false, randomRouting = false, gatewayPerFlowLoadBalancing = false;
   uint32_t migrationContainerId = 0, migrationDstLeaf = 0, migrationDstHost = 0, migrationTs = 0;
-  bool udpMode = false;
+  bool udpMode = false, versionedMappings = false, cacheDirectory = false;
+  string migrationSchedule;
+  uint64_t migrationWindow = 1000;
   CommandLine cmd;
   cmd.AddValue ("placement", "The JSON placement file for the simulation", placementFile);
   cmd.AddValue ("trace", "The CSV trace file for the simulation", traceFile);
@@ -33,6 +42,18 @@ main (int argc, char *argv[])
                 migrationDstLeaf);
   cmd.AddValue ("migrationDestinationHost", "The destination host id for migration",
                 migrationDstHost);
+  cmd.AddValue ("migrationSchedule",
+                "A CSV of VM events, ts (us),container,leaf,host[,migrate|create|destroy]",
+                migrationSchedule);
+  cmd.AddValue ("migrationWindow",
+                "Microseconds before and after a VM event its gateway packets are compared in",
+                migrationWindow);
+  cmd.AddValue ("versionedMappings",
+                "Stamp the epoch of each mapping on the packets, so switches skip stale entries",
+                versionedMappings);
+  cmd.AddValue ("cacheDirectory",
+                "Track the switches of each VIP at the gateways and invalidate them on migration",
+                cacheDirectory);
   cmd.AddValue ("randomRouting", "Enable per-packet random routing", randomRouting);
   cmd.AddValue ("gatewayPerFlowLoadBalancing", "Enable per-flow gateway balancing",
                 gatewayPerFlowLoadBalancing);
@@ -50,7 +71,8 @@ main (int argc, char *argv[])
                                          udpMode),
                    outputFile,
                    MigrationParams (migrationTest, migrationContainerId, migrationDstLeaf,
-                                    migrationDstHost, migrationTs))
+                                    migrationDstHost, migrationTs, versionedMappings,
+                                    cacheDirectory, migrationSchedule, migrationWindow))
       .Run ();
   return 0;
 }
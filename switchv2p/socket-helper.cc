@@ -1,17 +1,21 @@
 #include "include/socket-helper.h"
-#include "include/ip-utils.h"
 #include "include/invalidation-tag.h"
 #include "include/hit-tag.h"
+#include "include/epoch-tag.h"
 
 NS_LOG_COMPONENT_DEFINE ("SocketHelper");
 
 const uint16_t SocketHelper::PORT_NUMBER = 667;
 
 SocketHelper::SocketHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical,
+                            unordered_map<uint32_t, uint8_t> &mappingEpochs,
+                            unordered_map<uint32_t, uint32_t> &vmLocations,
                             uint32_t &misdeliveryCount, Time &lastMisdelivered,
                             bool gatewayPerFlowLoadBalancing, SimulationParameters simParams,
                             MigrationParams migrationParams)
     : m_virtualToPhysical (virtualToPhysical),
+      m_mappingEpochs (mappingEpochs),
+      m_vmLocations (vmLocations),
       m_misdeliveryCount (misdeliveryCount),
       m_lastMisdelivered (lastMisdelivered),
       m_gatewayPerFlowLoadBalancing (gatewayPerFlowLoadBalancing),
@@ -24,19 +28,56 @@ SocketHelper::SocketHelper (unordered_map<uint32_t, uint32_t> &virtualToPhysical
 void
 SocketHelper::SendFollowMeRule (Ptr<Packet> packet, Ipv4Header ipHeader, bool misdelivery)
 {
-  Ipv4Address dst =
-      misdelivery
-          ? IpUtils::GetNodePhysicalAddress (m_migrationParams.dstLeaf / m_simParams.PodWidth,
-                                             m_migrationParams.dstLeaf % m_simParams.PodWidth,
-                                             m_migrationParams.dstHost)
-          : Ipv4Address (m_virtualToPhysical[ipHeader.GetDestination ().Get ()]);
-  m_socket->SendTo (packet, 0, InetSocketAddress (dst, PORT_NUMBER));
+  uint32_t vip = ipHeader.GetDestination ().Get ();
+  auto location = m_vmLocations.find (vip);
+  if (misdelivery && location != m_vmLocations.end ())
+    {
+      // The host knows where its VM went, a destroyed VM's packets are dropped
+      if (location->second != 0)
+        {
+          Send (packet, Ipv4Address (location->second));
+        }
+      return;
+    }
+  auto mapping = m_virtualToPhysical.find (vip);
+  if (mapping != m_virtualToPhysical.end ())
+    {
+      Send (packet, Ipv4Address (mapping->second));
+    }
 }
 
 void
 SocketHelper::SendToGateway (Ptr<Packet> packet, uint32_t gwIdx)
 {
-  m_socket->SendTo (packet, 0, InetSocketAddress (m_gatewayAddresses[gwIdx], PORT_NUMBER));
+  Send (packet, m_gatewayAddresses[gwIdx]);
+}
+
+void
+SocketHelper::Send (Ptr<Packet> packet, Ipv4Address dst)
+{
+  if (m_sendCallback.IsNull ())
+    {
+      m_socket->SendTo (packet, 0, InetSocketAddress (dst, PORT_NUMBER));
+      return;
+    }
+
+  UdpHeader udpHeader;
+  udpHeader.SetSourcePort (PORT_NUMBER);
+  udpHeader.SetDestinationPort (PORT_NUMBER);
+  packet->AddHeader (udpHeader);
+  m_sendCallback (packet, m_physicalAddress, dst);
+}
+
+void
+SocketHelper::StampEpochs (Ptr<Packet> packet, const Ipv4Header &header)
+{
+  auto source = m_mappingEpochs.find (header.GetSource ().Get ());
+  auto destination = m_mappingEpochs.find (header.GetDestination ().Get ());
+  EpochTag tag;
+  packet->RemovePacketTag (tag);
+  tag.SetSourceEpoch (source == m_mappingEpochs.end () ? 0 : source->second);
+  tag.SetDestinationEpoch (destination == m_mappingEpochs.end () ? 0 : destination->second);
+  packet->AddPacketTag (tag);
 }
 
 uint32_t
@@ -64,39 +105,23 @@ SocketHelper::VirtualSend (Ptr<Packet> packet, const Address &source, const Addr
 {
   NS_LOG_FUNCTION (*packet);
 
-  if (m_migrationParams.migration && m_simParams.SimMode == SimulationParameters::OnDemand)
-    {
-      m_onDemandCache->insert (
-          IpUtils::GetContainerVirtualAddress (m_migrationParams.containerId).Get ());
-    }
   NS_LOG_DEBUG ("SH: Sending packet " << *packet);
   Ipv4Header header;
   packet->PeekHeader (header);
+  if (m_migrationParams.migration && m_simParams.SimMode == SimulationParameters::OnDemand &&
+      m_vmLocations.count (header.GetDestination ().Get ()))
+    {
+      m_onDemandCache->insert (header.GetDestination ().Get ());
+    }
   NS_LOG_DEBUG ("Packet TTL = " << (uint32_t) header.GetTtl ());
   size_t gwIdx = GetGatewayIdx (packet, header);
+  if (m_migrationParams.versionedMappings)
+    {
+      StampEpochs (packet, header);
+    }
   if (header.GetTtl () < 64)
     {
-      InvalidationTag tag;
-      tag.SetInvalidation (
-          std::make_pair (header.GetDestination ().Get (), m_physicalAddress.Get ()));
-      packet->AddPacketTag (tag);
-
-      m_misdeliveryCount++;
-      m_lastMisdelivered = Max (Simulator::Now (), m_lastMisdelivered);
-
-      HitTag hitTag;
-      if (packet->PeekPacketTag (hitTag))
-        {
-          Simulator::Schedule (MicroSeconds (10), &SocketHelper::SendToGateway, this, packet,
-                               gwIdx);
-        }
-      else
-        {
-          // Use the follow-me rule to send the packet directly to its new destination
-          Simulator::Schedule (MicroSeconds (10), &SocketHelper::SendFollowMeRule, this, packet,
-                               header, true);
-        }
-
+      Misdeliver (packet, header, gwIdx);
       return true;
     }
 
@@ -123,15 +148,60 @@ SocketHelper::VirtualSend (Ptr<Packet> packet, const Address &source, const Addr
     }
 
   NS_LOG_DEBUG ("SH: Virtual address = " << header.GetDestination ());
-  m_socket->SendTo (packet, 0, InetSocketAddress (m_gatewayAddresses[gwIdx], PORT_NUMBER));
+  Send (packet, m_gatewayAddresses[gwIdx]);
   return true;
 }
 
+void
+SocketHelper::Misdeliver (Ptr<Packet> packet, Ipv4Header &header, size_t gwIdx)
+{
+  InvalidationTag tag;
+  tag.SetInvalidation (std::make_pair (header.GetDestination ().Get (), m_physicalAddress.Get ()));
+  packet->AddPacketTag (tag);
+
+  m_misdeliveryCount++;
+  m_lastMisdelivered = Max (Simulator::Now (), m_lastMisdelivered);
+  if (!m_misdeliveryCallback.IsNull ())
+    {
+      m_misdeliveryCallback (header.GetDestination ());
+    }
+
+  HitTag hitTag;
+  if (packet->PeekPacketTag (hitTag))
+    {
+      Simulator::Schedule (MicroSeconds (10), &SocketHelper::SendToGateway, this, packet, gwIdx);
+    }
+  else
+    {
+      // Use the follow-me rule to send the packet directly to its new destination
+      Simulator::Schedule (MicroSeconds (10), &SocketHelper::SendFollowMeRule, this, packet,
+                           header, true);
+    }
+}
+
 void
 SocketHelper::SocketRecv (Ptr<Socket> socket)
 {
   Ptr<Packet> packet = socket->Recv (65535, 0);
   NS_LOG_DEBUG ("Socket recv: " << *packet);
+  Ipv4Header innerHeader;
+  packet->PeekHeader (innerHeader);
+  auto location = m_vmLocations.find (innerHeader.GetDestination ().Get ());
+  if (location != m_vmLocations.end () && location->second != m_physicalAddress.Get () &&
+      std::find (m_gatewayAddresses.begin (), m_gatewayAddresses.end (), m_physicalAddress) ==
+          m_gatewayAddresses.end ())
+    {
+      // The VM moved away, the host sends the packet back into its tunnel like a router would
+      packet->RemoveHeader (innerHeader);
+      if (innerHeader.GetTtl () <= 1)
+        {
+          return;
+        }
+      innerHeader.SetTtl (innerHeader.GetTtl () - 1);
+      packet->AddHeader (innerHeader);
+      Misdeliver (packet, innerHeader, GetGatewayIdx (packet, innerHeader));
+      return;
+    }
   if (m_simParams.SimMode == SimulationParameters::OnDemand)
     {
       Ipv4Header header;
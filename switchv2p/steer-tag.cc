@@ -0,0 +1,55 @@
+#include "include/steer-tag.h"
+
+SteerTag::SteerTag ()
+{
+}
+
+TypeId
+SteerTag::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("SteerTag").SetParent<Tag> ().SetGroupName ("Sim").AddConstructor<SteerTag> ();
+  return tid;
+}
+
+TypeId
+SteerTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+SteerTag::GetSerializedSize (void) const
+{
+  return sizeof (uint32_t);
+}
+
+void
+SteerTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_address.Get ());
+}
+
+void
+SteerTag::Deserialize (TagBuffer i)
+{
+  m_address = Ipv4Address (i.ReadU32 ());
+}
+
+void
+SteerTag::Print (std::ostream &os) const
+{
+  os << "Steered from " << m_address;
+}
+
+void
+SteerTag::SetAddress (Ipv4Address addr)
+{
+  m_address = addr;
+}
+
+Ipv4Address
+SteerTag::GetAddress (void) const
+{
+  return m_address;
+}
@@ -19,6 +19,9 @@ SwitchApp::GetTypeId (void)
           .AddAttribute ("MemorySize", "The number of entries each switch can store",
                          IntegerValue (10), MakeIntegerAccessor (&SwitchApp::m_memorySize),
                          MakeIntegerChecker<int32_t> ())
+          .AddAttribute ("CachePolicy", "The cache replacement policy (Default = LRU)",
+                         EnumValue (DEFAULT_POLICY), MakeEnumAccessor (&SwitchApp::m_cachePolicy),
+                         MakeCachePolicyChecker ())
           .AddTraceSource ("ProcessedPackets", "A packet has been processed by the switch",
                            MakeTraceSourceAccessor (&SwitchApp::m_processedPackets),
                            "ns3::Packet::SwitchIdTracedCallback")
@@ -40,7 +43,29 @@ SwitchApp::Setup (vector<Ipv4Address> &gwAddresses, enum SimulationParameters::M
                   inserter (m_gwAddresses, m_gwAddresses.end ()),
                   [] (const Ipv4Address &ipv4) { return ipv4.Get (); });
   m_switchMode = switchMode;
-  m_cache.SetCapacity (m_memorySize);
+  CacheConfig config;
+  config.capacity = m_memorySize;
+  enum CachePolicy policy = m_cachePolicy == DEFAULT_POLICY ? LRU : m_cachePolicy;
+  VisitCachePolicy<uint32_t, uint32_t, SwitchCacheHash> (policy, [&] (auto type) {
+    typedef typename decltype (type)::type Cache;
+    SetupCache (std::get<Cache> (m_caches), config);
+    m_lookupHandler = &SwitchApp::LookupWith<Cache>;
+    m_insertHandler = &SwitchApp::InsertWith<Cache>;
+  });
+}
+
+template <typename Cache>
+bool
+SwitchApp::LookupWith (uint32_t key, uint32_t &value)
+{
+  return std::get<Cache> (m_caches).Get (key, value);
+}
+
+template <typename Cache>
+void
+SwitchApp::InsertWith (uint32_t key, uint32_t value)
+{
+  std::get<Cache> (m_caches).Put (key, value);
 }
 
 void
@@ -74,7 +99,7 @@ SwitchApp::BulkInsertToCache (vector<pair<uint32_t, uint32_t>> &items)
     {
       NS_LOG_INFO ("Inserting [" << Ipv4Address (pair.first) << ", " << Ipv4Address (pair.second)
                                  << "]");
-      m_cache.Put (pair.first, pair.second);
+      (this->*m_insertHandler) (pair.first, pair.second);
     }
 }
 
@@ -120,7 +145,7 @@ SwitchApp::ReceivePacket (Ptr<Packet> packet, Ipv4Header &ipHeader)
   if (m_gwAddresses.count (ipHeader.GetDestination ().Get ()) != 0)
     {
       uint32_t cached_addr = 0;
-      if (m_cache.Get (innerHeader.GetDestination ().Get (), cached_addr))
+      if ((this->*m_lookupHandler) (innerHeader.GetDestination ().Get (), cached_addr))
         {
           m_cacheHit (receivedPacket, GetNode ()->GetId ());
           ipHeader.SetDestination (Ipv4Address (cached_addr));
@@ -0,0 +1,211 @@
+#include "include/control-tag.h"
+#include "include/epoch-tag.h"
+#include "include/eviction-tag.h"
+#include "include/ip-utils.h"
+#include "include/switch-cache.h"
+#include "ns3/test.h"
+
+/// Copies \p tag through the wire format of a packet tag.
+template <typename T>
+static T
+RoundTrip (const T &tag)
+{
+  Ptr<Packet> packet = Create<Packet> (64);
+  packet->AddPacketTag (tag);
+  T copy;
+  packet->RemovePacketTag (copy);
+  return copy;
+}
+
+class EvictionTagRoundTripTestCase : public TestCase
+{
+public:
+  EvictionTagRoundTripTestCase () : TestCase ("Multi-entry EvictionTag round trip")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    EvictionTag tag;
+    tag.AddEvicted (std::make_pair (10, 100), 10, EvictionTag::MAX_ENTRIES);
+    tag.AddEvicted (std::make_pair (20, 200), 29, EvictionTag::MAX_ENTRIES);
+    tag.AddEvicted (std::make_pair (30, 300), 30, EvictionTag::MAX_ENTRIES);
+
+    EvictionTag copy = RoundTrip (tag);
+    NS_TEST_ASSERT_MSG_EQ (copy.GetCount (), 3u, "Entries lost on the wire");
+    NS_TEST_ASSERT_MSG_EQ (copy.GetSerializedSize (), 1u + 3 * 12, "Wrong wire size");
+    for (uint32_t index = 0; index < tag.GetCount (); ++index)
+      {
+        NS_TEST_ASSERT_MSG_EQ (copy.GetEvicted (index).first, tag.GetEvicted (index).first,
+                               "Wrong key of entry " << index);
+        NS_TEST_ASSERT_MSG_EQ (copy.GetEvicted (index).second, tag.GetEvicted (index).second,
+                               "Wrong value of entry " << index);
+        NS_TEST_ASSERT_MSG_EQ (copy.GetEvictedLast (index), tag.GetEvictedLast (index),
+                               "Wrong last key of entry " << index);
+      }
+    NS_TEST_ASSERT_MSG_EQ (copy.FindEvicted (25), 1u, "Key not found in its range");
+    NS_TEST_ASSERT_MSG_EQ (copy.FindEvicted (15), 3u, "Key found outside every range");
+  }
+};
+
+class EvictionTagAddTestCase : public TestCase
+{
+public:
+  EvictionTagAddTestCase () : TestCase ("EvictionTag drops overlapped and oldest entries")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    EvictionTag tag;
+    tag.AddEvicted (std::make_pair (10, 100), 19, 2);
+    tag.AddEvicted (std::make_pair (15, 150), 15, 2);
+    NS_TEST_ASSERT_MSG_EQ (tag.GetCount (), 1u, "The overlapped range was kept");
+    NS_TEST_ASSERT_MSG_EQ (tag.GetEvicted ().second, 150u, "The newer mapping was dropped");
+
+    tag.AddEvicted (std::make_pair (20, 200), 20, 2);
+    tag.AddEvicted (std::make_pair (30, 300), 30, 2);
+    NS_TEST_ASSERT_MSG_EQ (tag.GetCount (), 2u, "The capacity was exceeded");
+    NS_TEST_ASSERT_MSG_EQ (tag.GetEvicted (0).first, 20u, "The oldest entry was kept");
+    NS_TEST_ASSERT_MSG_EQ (tag.GetEvicted (1).first, 30u, "The newest entry was dropped");
+
+    tag.RemoveEvicted (0);
+    NS_TEST_ASSERT_MSG_EQ (tag.GetCount (), 1u, "The entry was not removed");
+    NS_TEST_ASSERT_MSG_EQ (tag.GetEvicted ().first, 30u, "The wrong entry was removed");
+  }
+};
+
+class EvictionTagObsoleteTestCase : public TestCase
+{
+public:
+  EvictionTagObsoleteTestCase () : TestCase ("EvictionTag finds a migration mark behind an entry")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    EvictionTag tag;
+    tag.AddEvicted (std::make_pair (10, 100), 10, EvictionTag::MAX_ENTRIES);
+    NS_TEST_ASSERT_MSG_EQ (tag.FindObsolete (), 1u, "A mapping read as a migration mark");
+
+    tag.AddEvicted (std::make_pair (0, 0), 0, EvictionTag::MAX_ENTRIES);
+    tag.AddEvicted (std::make_pair (20, 200), 20, EvictionTag::MAX_ENTRIES);
+    EvictionTag copy = RoundTrip (tag);
+    NS_TEST_ASSERT_MSG_EQ (copy.FindObsolete (), 1u, "The mark behind the first entry was missed");
+    NS_TEST_ASSERT_MSG_EQ (copy.FindEvicted (10), 0u, "The entry before the mark was lost");
+  }
+};
+
+class ControlTagRoundTripTestCase : public TestCase
+{
+public:
+  ControlTagRoundTripTestCase () : TestCase ("Batched ControlTag round trip")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    ControlTag learning;
+    learning.SetLearning (true);
+    learning.AddMapping (std::make_pair (10, 100));
+    learning.AddMapping (std::make_pair (20, 200));
+    learning.AddMapping (std::make_pair (10, 101));
+    NS_TEST_ASSERT_MSG_EQ (learning.GetCount (), 2u, "A learned key was batched twice");
+
+    ControlTag copy = RoundTrip (learning);
+    NS_TEST_ASSERT_MSG_EQ (copy.IsLearning (), true, "Lost the learning flag");
+    NS_TEST_ASSERT_MSG_EQ (copy.GetCount (), 2u, "Mappings lost on the wire");
+    NS_TEST_ASSERT_MSG_EQ (copy.GetMapping (0).second, 101u, "The newer mapping was not kept");
+    NS_TEST_ASSERT_MSG_EQ (copy.GetMapping (1).first, 20u, "Wrong key of the second mapping");
+
+    // Invalidations of one key to different addresses are all kept
+    ControlTag invalidation;
+    invalidation.SetVictimHops (2);
+    invalidation.AddMapping (std::make_pair (10, 100));
+    invalidation.AddMapping (std::make_pair (10, 101));
+    copy = RoundTrip (invalidation);
+    NS_TEST_ASSERT_MSG_EQ (copy.IsLearning (), false, "Gained the learning flag");
+    NS_TEST_ASSERT_MSG_EQ ((uint32_t) copy.GetVictimHops (), 2u, "Wrong victim hops");
+    NS_TEST_ASSERT_MSG_EQ (copy.GetCount (), 2u, "An invalidation was merged");
+  }
+};
+
+class EpochTagRoundTripTestCase : public TestCase
+{
+public:
+  EpochTagRoundTripTestCase () : TestCase ("EpochTag round trip")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    EpochTag tag;
+    tag.SetSourceEpoch (3);
+    tag.SetDestinationEpoch (EpochTag::EPOCHS - 1);
+    EpochTag copy = RoundTrip (tag);
+    NS_TEST_ASSERT_MSG_EQ ((uint32_t) copy.GetSourceEpoch (), 3u, "Wrong source epoch");
+    NS_TEST_ASSERT_MSG_EQ ((uint32_t) copy.GetDestinationEpoch (), EpochTag::EPOCHS - 1u,
+                           "Wrong destination epoch");
+  }
+};
+
+class EpochLocatorTestCase : public TestCase
+{
+public:
+  EpochLocatorTestCase () : TestCase ("A versioned address keeps its epoch in a locator cache")
+  {
+  }
+
+private:
+  virtual void
+  DoRun (void)
+  {
+    // 2 pods of 4 leaves with 16 hosts, numbered as SimulationBase::GetHostLocators does
+    HostLocators locators (8, 4, 16, EpochTag::EPOCHS);
+    LocatorCache<P4Cache<uint32_t, uint16_t, SwitchCacheHash>> cache;
+    CacheConfig config;
+    config.capacity = 64;
+    config.locators = locators;
+    SetupCache (cache, config);
+
+    uint32_t host = IpUtils::GetNodePhysicalAddress (1, 3, 15).Get ();
+    for (uint32_t epoch = 0; epoch < EpochTag::EPOCHS; ++epoch)
+      {
+        uint32_t versioned = IpUtils::GetVersionedAddress (host, epoch);
+        uint32_t cached = 0;
+        cache.Put (42, versioned);
+        NS_TEST_ASSERT_MSG_EQ (cache.Get (42, cached), true, "The mapping was not cached");
+        NS_TEST_ASSERT_MSG_EQ ((uint32_t) IpUtils::GetAddressEpoch (cached), epoch,
+                               "The locator lost the epoch");
+        NS_TEST_ASSERT_MSG_EQ (IpUtils::GetUnversionedAddress (cached), host,
+                               "The locator changed the host");
+      }
+    NS_TEST_ASSERT_MSG_LT (locators.GetCount (), UINT16_MAX + 1u, "Locators overflow");
+  }
+};
+
+class TagTestSuite : public TestSuite
+{
+public:
+  TagTestSuite () : TestSuite ("switchv2p-tags", UNIT)
+  {
+    AddTestCase (new EvictionTagRoundTripTestCase, TestCase::QUICK);
+    AddTestCase (new EvictionTagAddTestCase, TestCase::QUICK);
+    AddTestCase (new EvictionTagObsoleteTestCase, TestCase::QUICK);
+    AddTestCase (new ControlTagRoundTripTestCase, TestCase::QUICK);
+    AddTestCase (new EpochTagRoundTripTestCase, TestCase::QUICK);
+    AddTestCase (new EpochLocatorTestCase, TestCase::QUICK);
+  }
+};
+
+static TagTestSuite g_tagTestSuite;
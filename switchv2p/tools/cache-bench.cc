@@ -0,0 +1,530 @@
+/*
+ * Microbenchmark of the per-packet switch data structures.
+ *
+ * Every cache policy (and the invalidation bloom filter) is replayed against
+ * uniform, Zipf and trace key streams at a range of capacities. A replay
+ * phase mirrors a switch learning on miss and yields the hit ratio, then Get,
+ * Put and Remove are timed on their own over the same stream. Results are
+ * written as JSON. With --baseline, the run is compared to an earlier report
+ * and the exit status is non-zero if any phase got slower than --tolerance.
+ */
+
+#include "../include/bloom-filter.h"
+#include "../include/switch-cache.h"
+#include "input-file.h"
+#include "placement.h"
+#include "tool-args.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace boost::property_tree;
+using std::pair;
+using std::unordered_map;
+
+static const char *USAGE =
+    "Usage: cache-bench [options]\n"
+    "  --policies=A,B,...   Structures to run: DirectMapped, SetAssociative, Cuckoo, LRU,\n"
+    "                       CLOCK, ARC, S3FIFO, Range, BloomFilter (default all)\n"
+    "  --capacities=A,B,... Entries per structure (default 10,100,1000,10000,100000,1000000)\n"
+    "  --streams=A,B,...    Key streams: uniform, zipf, trace (default uniform,zipf, plus\n"
+    "                       trace if --trace is given)\n"
+    "  --trace=<file.csv[.gz]>  Flow trace, its destinations are replayed in time order\n"
+    "  --placement=<file.json[.gz]>  Number the trace containers as the simulation does and\n"
+    "                       map them to their host, so Range can merge a host's containers\n"
+    "  --ports=N            Ports per switch of the placement, half face hosts (default 64)\n"
+    "  --ops=N              Keys per stream (default 1000000)\n"
+    "  --keySpace=F         Distinct keys of the synthetic streams per entry (default 4)\n"
+    "  --zipf=S             Zipf exponent (default 0.99)\n"
+    "  --ways=N             Associativity of SetAssociative (default 4)\n"
+    "  --maxKicks=N         Displacements of Cuckoo (default 8)\n"
+    "  --fpr=P              False-positive rate of BloomFilter (default 0.01)\n"
+    "  --output=<file>      Write the JSON report there instead of stdout\n"
+    "  --baseline=<file>    Earlier report to compare the ns/op of every phase with\n"
+    "  --tolerance=F        Allowed slowdown against the baseline (default 0.2)\n";
+
+static const vector<pair<string, CachePolicy>> POLICIES = {
+    {"DirectMapped", DIRECT_MAPPED}, {"SetAssociative", SET_ASSOCIATIVE}, {"Cuckoo", CUCKOO},
+    {"LRU", LRU},                    {"CLOCK", CLOCK},                    {"ARC", ARC},
+    {"S3FIFO", S3FIFO},              {"Range", RANGE}};
+
+/// Counts last-level cache misses of this thread, if the kernel lets us.
+class MissCounter
+{
+public:
+  MissCounter () : m_fd (-1)
+  {
+#if defined(__linux__)
+    perf_event_attr attr;
+    std::memset (&attr, 0, sizeof (attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof (attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_fd = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+
+  ~MissCounter ()
+  {
+#if defined(__linux__)
+    if (m_fd >= 0)
+      {
+        close (m_fd);
+      }
+#endif
+  }
+
+  bool
+  IsAvailable () const
+  {
+    return m_fd >= 0;
+  }
+
+  void
+  Start ()
+  {
+#if defined(__linux__)
+    if (m_fd >= 0)
+      {
+        ioctl (m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl (m_fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+  }
+
+  uint64_t
+  Stop ()
+  {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (m_fd >= 0)
+      {
+        ioctl (m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read (m_fd, &count, sizeof (count)) != sizeof (count))
+          {
+            count = 0;
+          }
+      }
+#endif
+    return count;
+  }
+
+private:
+  int m_fd;
+};
+
+struct Phase
+{
+  double nsPerOp;
+  double missesPerOp;
+};
+
+/// Times \p op over every key of the stream.
+template <typename Op>
+static Phase
+Measure (const vector<uint32_t> &keys, MissCounter &misses, Op op)
+{
+  misses.Start ();
+  auto start = std::chrono::steady_clock::now ();
+  for (uint32_t key : keys)
+    {
+      op (key);
+    }
+  auto end = std::chrono::steady_clock::now ();
+  uint64_t missCount = misses.Stop ();
+  double ns = std::chrono::duration<double, std::nano> (end - start).count ();
+  return Phase{ns / keys.size (), missCount / (double) keys.size ()};
+}
+
+/// Values are never 0, which the P4 caches read as an empty slot.
+static inline uint32_t
+ValueOf (uint32_t key)
+{
+  return (key * 2654435761u) | 1;
+}
+
+struct Result
+{
+  double hitRatio;
+  vector<pair<string, Phase>> phases;
+};
+
+/// Replays \p keys on \p cache. The value of a key is values[key], or ValueOf if none are given.
+template <typename Cache>
+static Result
+RunCache (Cache &cache, const vector<uint32_t> &keys, const vector<uint32_t> &values,
+          MissCounter &misses)
+{
+  auto valueOf = [&] (uint32_t key) { return values.empty () ? ValueOf (key) : values[key]; };
+  Result result;
+  uint64_t hits = 0, sink = 0;
+  result.phases.emplace_back ("replay", Measure (keys, misses, [&] (uint32_t key) {
+                                uint32_t value;
+                                if (cache.Get (key, value))
+                                  {
+                                    hits++;
+                                    sink += value;
+                                  }
+                                else
+                                  {
+                                    cache.Put (key, valueOf (key));
+                                  }
+                              }));
+  result.hitRatio = hits / (double) keys.size ();
+  result.phases.emplace_back ("get", Measure (keys, misses, [&] (uint32_t key) {
+                                uint32_t value = 0;
+                                cache.Get (key, value);
+                                sink += value;
+                              }));
+  result.phases.emplace_back (
+      "put", Measure (keys, misses, [&] (uint32_t key) { cache.Put (key, valueOf (key)); }));
+  // Only cached keys are removed, P4Cache expects the key to be in its slot
+  result.phases.emplace_back ("remove", Measure (keys, misses, [&] (uint32_t key) {
+                                if (cache.Find (key))
+                                  {
+                                    cache.Remove (key);
+                                  }
+                              }));
+  volatile uint64_t keep = sink;
+  (void) keep;
+  return result;
+}
+
+static Result
+RunBloomFilter (size_t capacity, double fpr, const vector<uint32_t> &keys, MissCounter &misses)
+{
+  BloomFilter<uint32_t> filter;
+  filter.Setup (capacity, fpr);
+  Result result;
+  uint64_t hits = 0;
+  result.phases.emplace_back ("replay", Measure (keys, misses, [&] (uint32_t key) {
+                                if (filter.Get (key))
+                                  {
+                                    hits++;
+                                  }
+                                else
+                                  {
+                                    filter.Put (key);
+                                  }
+                              }));
+  result.hitRatio = hits / (double) keys.size ();
+  uint64_t sink = 0;
+  result.phases.emplace_back (
+      "get", Measure (keys, misses, [&] (uint32_t key) { sink += filter.Get (key); }));
+  result.phases.emplace_back ("put",
+                              Measure (keys, misses, [&] (uint32_t key) { filter.Put (key); }));
+  volatile uint64_t keep = sink;
+  (void) keep;
+  return result;
+}
+
+static vector<uint32_t>
+UniformStream (size_t ops, size_t keySpace, std::mt19937 &rng)
+{
+  std::uniform_int_distribution<uint32_t> dist (1, keySpace);
+  vector<uint32_t> keys (ops);
+  for (uint32_t &key : keys)
+    {
+      key = dist (rng);
+    }
+  return keys;
+}
+
+/// Zipf ranks mapped to shuffled key IDs, so popular keys do not share hash neighbourhoods.
+static vector<uint32_t>
+ZipfStream (size_t ops, size_t keySpace, double exponent, std::mt19937 &rng)
+{
+  vector<double> cdf (keySpace);
+  double sum = 0;
+  for (size_t rank = 0; rank < keySpace; ++rank)
+    {
+      sum += 1 / std::pow (rank + 1, exponent);
+      cdf[rank] = sum;
+    }
+
+  vector<uint32_t> ids (keySpace);
+  for (size_t i = 0; i < keySpace; ++i)
+    {
+      ids[i] = i + 1;
+    }
+  std::shuffle (ids.begin (), ids.end (), rng);
+
+  std::uniform_real_distribution<double> dist (0, sum);
+  vector<uint32_t> keys (ops);
+  for (uint32_t &key : keys)
+    {
+      size_t rank = std::lower_bound (cdf.begin (), cdf.end (), dist (rng)) - cdf.begin ();
+      key = ids[std::min (rank, keySpace - 1)];
+    }
+  return keys;
+}
+
+/**
+ * The destination containers of a flow trace (umContainer, dmContainer, ts,
+ * flowId, size) in time order, one key per flow, repeated to \p ops keys.
+ * Keys are the container IDs in \p ids plus one if given, so no key is 0.
+ */
+static vector<uint32_t>
+TraceStream (const string &path, size_t ops, const unordered_map<string, uint32_t> &ids)
+{
+  InputFile in (path);
+  vector<pair<uint64_t, string>> flows;
+  string line;
+  while (std::getline (in, line))
+    {
+      std::istringstream ss (line);
+      string source, destination, ts;
+      if (std::getline (ss, source, ',') && std::getline (ss, destination, ',') &&
+          std::getline (ss, ts, ','))
+        {
+          flows.emplace_back (std::stoull (ts), destination);
+        }
+    }
+  std::stable_sort (flows.begin (), flows.end (),
+                    [] (const pair<uint64_t, string> &a, const pair<uint64_t, string> &b) {
+                      return a.first < b.first;
+                    });
+
+  // Without a placement, containers get sequential IDs in order of appearance
+  unordered_map<string, uint32_t> traceIds;
+  vector<uint32_t> trace;
+  trace.reserve (flows.size ());
+  for (auto &flow : flows)
+    {
+      if (ids.empty ())
+        {
+          trace.push_back (traceIds.emplace (flow.second, traceIds.size () + 1).first->second);
+          continue;
+        }
+      auto it = ids.find (flow.second);
+      if (it == ids.end ())
+        {
+          throw std::runtime_error ("Container " + flow.second + " is not in the placement");
+        }
+      trace.push_back (it->second + 1);
+    }
+  if (trace.empty ())
+    {
+      throw std::runtime_error ("Empty trace " + path);
+    }
+
+  vector<uint32_t> keys (ops);
+  for (size_t i = 0; i < ops; ++i)
+    {
+      keys[i] = trace[i % trace.size ()];
+    }
+  return keys;
+}
+
+static string
+ResultId (const ptree &result)
+{
+  return result.get<string> ("structure") + "/" + result.get<string> ("stream") + "/" +
+         result.get<string> ("capacity");
+}
+
+/// Prints every phase slower than the baseline by more than \p tolerance.
+static bool
+CompareToBaseline (const ptree &report, const string &baselinePath, double tolerance)
+{
+  ptree baseline;
+  read_json (baselinePath, baseline);
+  unordered_map<string, const ptree *> previous;
+  for (auto &result : baseline.get_child ("results"))
+    {
+      previous[ResultId (result.second)] = &result.second;
+    }
+
+  bool regressed = false;
+  for (auto &result : report.get_child ("results"))
+    {
+      auto it = previous.find (ResultId (result.second));
+      if (it == previous.end ())
+        {
+          continue;
+        }
+      for (auto &phase : result.second.get_child ("phases"))
+        {
+          auto old = it->second->get_optional<double> ("phases." + phase.first + ".ns_per_op");
+          double ns = phase.second.get<double> ("ns_per_op");
+          if (old && ns > *old * (1 + tolerance))
+            {
+              fprintf (stderr, "Regression: %s %s %.2f ns/op (baseline %.2f)\n",
+                       ResultId (result.second).c_str (), phase.first.c_str (), ns, *old);
+              regressed = true;
+            }
+        }
+    }
+  return regressed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  ToolArgs args (argc, argv, USAGE);
+  size_t ops = std::max<uint64_t> (1, args.GetUint ("ops", 1000000));
+  double keySpaceFactor = args.GetDouble ("keySpace", 4);
+  double exponent = args.GetDouble ("zipf", 0.99);
+  string tracePath = args.Get ("trace", "");
+
+  std::istringstream policies (
+      args.Get ("policies", "DirectMapped,SetAssociative,Cuckoo,LRU,CLOCK,ARC,S3FIFO,BloomFilter"));
+  std::istringstream streams (args.Get ("streams", tracePath.empty () ? "uniform,zipf"
+                                                                      : "uniform,zipf,trace"));
+  vector<string> structureNames, streamNames;
+  string token;
+  while (std::getline (policies, token, ','))
+    {
+      structureNames.push_back (token);
+    }
+  while (std::getline (streams, token, ','))
+    {
+      streamNames.push_back (token);
+    }
+
+  CacheConfig config;
+  config.ways = args.GetUint ("ways", 4);
+  config.maxKicks = args.GetUint ("maxKicks", 8);
+  MissCounter misses;
+  vector<uint32_t> trace;
+  // The host of every trace key, plus one since a zero value reads as an empty slot
+  vector<uint32_t> traceValues;
+  unordered_map<string, uint32_t> ids;
+  if (!args.Get ("placement", "").empty ())
+    {
+      vector<uint32_t> gateways, hostOf;
+      PlaceContainers (args.Get ("placement", ""), args.GetUint ("ports", 64) / 2, {}, ids,
+                       gateways, &hostOf);
+      traceValues.push_back (0);
+      for (uint32_t host : hostOf)
+        {
+          traceValues.push_back (host + 1);
+        }
+    }
+  if (!tracePath.empty ())
+    {
+      trace = TraceStream (tracePath, ops, ids);
+    }
+
+  ptree report, results;
+  report.put ("config.ops", ops);
+  report.put ("config.key_space", keySpaceFactor);
+  report.put ("config.zipf", exponent);
+  report.put ("config.trace", tracePath);
+  report.put ("config.placement", args.Get ("placement", ""));
+  report.put ("config.cache_misses_available", misses.IsAvailable ());
+
+  for (uint64_t capacity :
+       args.GetUintList ("capacities", "10,100,1000,10000,100000,1000000"))
+    {
+      size_t keySpace = std::max<size_t> (1, capacity * keySpaceFactor);
+      for (const string &streamName : streamNames)
+        {
+          std::mt19937 rng (capacity);
+          vector<uint32_t> keys;
+          if (streamName == "uniform")
+            {
+              keys = UniformStream (ops, keySpace, rng);
+            }
+          else if (streamName == "zipf")
+            {
+              keys = ZipfStream (ops, keySpace, exponent, rng);
+            }
+          else if (streamName == "trace" && !trace.empty ())
+            {
+              keys = trace;
+            }
+          else
+            {
+              args.Usage (1);
+            }
+
+          for (const string &structure : structureNames)
+            {
+              Result result;
+              if (structure == "BloomFilter")
+                {
+                  result = RunBloomFilter (capacity, args.GetDouble ("fpr", 0.01), keys, misses);
+                }
+              else
+                {
+                  auto policy = std::find_if (
+                      POLICIES.begin (), POLICIES.end (),
+                      [&] (const pair<string, CachePolicy> &p) { return p.first == structure; });
+                  if (policy == POLICIES.end ())
+                    {
+                      args.Usage (1);
+                    }
+                  config.capacity = capacity;
+                  SwitchCaches<uint32_t, uint32_t, SwitchCacheHash> caches;
+                  VisitCachePolicy<uint32_t, uint32_t, SwitchCacheHash> (
+                      policy->second, [&] (auto type) {
+                        typedef typename decltype (type)::type Cache;
+                        Cache &cache = std::get<Cache> (caches);
+                        SetupCache (cache, config);
+                        result = RunCache (cache, keys,
+                                           streamName == "trace" ? traceValues : vector<uint32_t> (),
+                                           misses);
+                      });
+                }
+
+              ptree entry;
+              entry.put ("structure", structure);
+              entry.put ("stream", streamName);
+              entry.put ("capacity", capacity);
+              entry.put ("hit_ratio", result.hitRatio);
+              for (auto &[name, phase] : result.phases)
+                {
+                  entry.put ("phases." + name + ".ns_per_op", phase.nsPerOp);
+                  entry.put ("phases." + name + ".mops", 1e3 / phase.nsPerOp);
+                  if (misses.IsAvailable ())
+                    {
+                      entry.put ("phases." + name + ".cache_misses_per_op", phase.missesPerOp);
+                    }
+                }
+              results.push_back (std::make_pair ("", entry));
+              fprintf (stderr, "%-14s %-7s %8lu hit %.3f replay %.1f ns/op\n", structure.c_str (),
+                       streamName.c_str (), capacity, result.hitRatio,
+                       result.phases[0].second.nsPerOp);
+            }
+        }
+    }
+  report.add_child ("results", results);
+
+  string output = args.Get ("output", "");
+  if (output.empty ())
+    {
+      write_json (std::cout, report);
+    }
+  else
+    {
+      write_json (output, report);
+    }
+
+  string baseline = args.Get ("baseline", "");
+  if (!baseline.empty () &&
+      CompareToBaseline (report, baseline, args.GetDouble ("tolerance", 0.2)))
+    {
+      return 1;
+    }
+  return 0;
+}
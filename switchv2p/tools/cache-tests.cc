@@ -0,0 +1,266 @@
+/*
+ * Unit checks of the switch cache data structures that do not need ns-3,
+ * starting with the Get/Put/Remove/evict contract every cache policy shares.
+ * Registered with ctest; exits non-zero on a failure.
+ */
+
+#include "../include/bloom-filter.h"
+#include "../include/consistent-hash-ring.h"
+#include "../include/switch-cache.h"
+#include <cstdio>
+#include <set>
+#include <string>
+
+using std::string;
+
+static int g_failures = 0;
+
+#define CHECK(cond, what)                                                                          \
+  do                                                                                               \
+    {                                                                                              \
+      if (!(cond))                                                                                 \
+        {                                                                                          \
+          std::fprintf (stderr, "%s:%d: %s: %s\n", __FILE__, __LINE__, (what).c_str (), #cond);   \
+          ++g_failures;                                                                            \
+        }                                                                                          \
+    }                                                                                              \
+  while (0)
+
+static const vector<pair<string, CachePolicy>> POLICIES = {
+    {"DirectMapped", DIRECT_MAPPED}, {"SetAssociative", SET_ASSOCIATIVE}, {"Cuckoo", CUCKOO},
+    {"LRU", LRU},                    {"CLOCK", CLOCK},                    {"ARC", ARC},
+    {"S3FIFO", S3FIFO},              {"Range", RANGE}};
+
+/// A cuckoo table also holds the keys of its stash.
+static const size_t CUCKOO_STASH = P4CuckooCache<uint32_t, uint32_t>::STASH_SIZE;
+
+/// 4 pods of 2 leaves with 8 hosts each.
+static const HostLocators LOCATORS (8, 2, 8);
+
+/// The value cached for \p key, a host address so that a LocatorCache can hold it.
+static uint32_t
+Value (uint32_t key)
+{
+  return LOCATORS.Decode (key % LOCATORS.GetCount () + 1);
+}
+
+/**
+ * The Get/Put/Remove contract of SwitchCaches, checked on the cache of \p name
+ * that holds up to \p entries keys.
+ */
+template <typename Cache>
+static void
+CheckContract (Cache &cache, const string &name, size_t entries)
+{
+  uint32_t value = 0;
+  pair<uint32_t, uint32_t> evicted;
+  CHECK (!cache.Get (7, value), name + " hit on an empty cache");
+  CHECK (!cache.Put (7, Value (7), evicted), name + " evicted from an empty cache");
+  CHECK (cache.Find (7), name + " lost a put key");
+  CHECK (cache.Get (7, value) && value == Value (7), name + " returned a wrong value");
+  CHECK (!cache.Put (7, Value (8), evicted), name + " evicted on an update");
+  CHECK (cache.Get (7, value) && value == Value (8), name + " kept the old value");
+  cache.Remove (7);
+  CHECK (!cache.Find (7), name + " kept a removed key");
+
+  // Fill past the capacity with keys that do not form ranges
+  std::set<uint32_t> live;
+  for (uint32_t key = 2; key < 2 + 8 * entries; key += 2)
+    {
+      if (cache.Put (key, Value (key), evicted))
+        {
+          CHECK (live.count (evicted.first), name + " evicted a key it did not hold");
+          CHECK (evicted.second == Value (evicted.first), name + " evicted a wrong value");
+          CHECK (!cache.Find (evicted.first), name + " kept an evicted key");
+          live.erase (evicted.first);
+        }
+      live.insert (key);
+      CHECK (cache.Find (key), name + " did not hold the latest key");
+    }
+  size_t held = 0;
+  for (uint32_t key : live)
+    {
+      held += cache.Find (key);
+    }
+  CHECK (held <= entries, name + " held more keys than its capacity");
+}
+
+static void
+TestContract ()
+{
+  const int capacity = 64;
+  CacheConfig config;
+  config.capacity = capacity;
+  config.ways = 4;
+  config.locators = LOCATORS;
+  for (bool locators : {false, true})
+    {
+      for (const auto &policy : POLICIES)
+        {
+          if (locators && !IsRegisterPolicy (policy.second))
+            {
+              continue;
+            }
+          string name = policy.first + (locators ? " (locators)" : "");
+          SwitchCaches<uint32_t, uint32_t, SwitchCacheHash> caches;
+          VisitCachePolicy<uint32_t, uint32_t, SwitchCacheHash> (
+              policy.second,
+              [&] (auto type) {
+                typedef typename decltype (type)::type Cache;
+                Cache &cache = std::get<Cache> (caches);
+                SetupCache (cache, config);
+                size_t stash = policy.second == CUCKOO ? CUCKOO_STASH : 0;
+                CheckContract (cache, name, capacity + stash);
+              },
+              locators);
+        }
+    }
+}
+
+static void
+TestLruOrder ()
+{
+  LRUCache<uint32_t, uint32_t> cache;
+  cache.SetCapacity (2);
+  uint32_t value;
+  pair<uint32_t, uint32_t> evicted;
+  cache.Put (1, 10);
+  cache.Put (2, 20);
+  cache.Get (1, value);
+  CHECK (cache.Put (3, 30, evicted) && evicted.first == 2,
+         string ("LRU did not evict the least recently used key"));
+  CHECK (cache.Find (1) && cache.Find (3), string ("LRU lost a recent key"));
+}
+
+static void
+TestBloomFilter ()
+{
+  BloomFilter<uint32_t> filter;
+  filter.Setup (1000, 0.01);
+  for (uint32_t key = 1; key <= 1000; ++key)
+    {
+      filter.Put (key);
+    }
+  uint32_t positives = 0;
+  for (uint32_t key = 1; key <= 1000; ++key)
+    {
+      CHECK (filter.Get (key), "Bloom filter lost key " + std::to_string (key));
+      positives += filter.Get (key + 1000000);
+    }
+  CHECK (positives < 50, string ("Bloom filter false-positive rate far above its target"));
+}
+
+static void
+TestRange ()
+{
+  RangeCache<uint32_t, uint32_t> cache;
+  cache.Setup (2);
+  pair<uint32_t, uint32_t> evicted;
+  uint32_t value = 0, first = 0, last = 0;
+  CHECK (!cache.PutRange (10, 19, 100, evicted), string ("Range evicted from an empty cache"));
+  CHECK (cache.Get (15, value) && value == 100, string ("Range missed a key of a range"));
+  CHECK (cache.GetRange (15, first, last) && first == 10 && last == 19,
+         string ("Range reported a wrong range"));
+  CHECK (!cache.Put (20, 100, evicted) && cache.GetRange (20, first, last) && last == 20 &&
+             first == 10,
+         string ("Range did not grow an adjacent entry"));
+  cache.PutRange (30, 39, 300, evicted);
+  CHECK (cache.PutRange (50, 59, 500, evicted) && evicted.first == 10 &&
+             cache.GetEvictedLast () == 20,
+         string ("Range did not evict the whole oldest range"));
+}
+
+static void
+TestLocators ()
+{
+  for (uint32_t locator = 1; locator <= LOCATORS.GetCount (); ++locator)
+    {
+      uint32_t address = LOCATORS.Decode (locator);
+      CHECK (LOCATORS.Encode (address) == locator, "Locator " + std::to_string (locator));
+    }
+
+  // A versioned address keeps its epoch, the last octet, through a locator
+  HostLocators versioned (8, 2, 8, 128);
+  LocatorCache<P4Cache<uint32_t, uint16_t>> cache;
+  CacheConfig config;
+  config.capacity = 16;
+  config.locators = versioned;
+  SetupCache (cache, config);
+  uint32_t value = 0;
+  for (uint32_t epoch : {0, 1, 127})
+    {
+      uint32_t address = (LOCATORS.Decode (LOCATORS.GetCount ()) & 0xffffff00) | (epoch + 1);
+      CHECK (versioned.Decode (versioned.Encode (address)) == address,
+             "Epoch " + std::to_string (epoch) + " lost by its locator");
+      cache.Put (9, address);
+      CHECK (cache.Get (9, value) && value == address,
+             "Epoch " + std::to_string (epoch) + " lost by the cache");
+    }
+  CHECK (versioned.GetCount () == LOCATORS.GetCount () * 128,
+         string ("The epochs are not counted in the locators"));
+}
+
+static void
+TestHashRing ()
+{
+  ConsistentHashRing ring, smaller;
+  ring.Setup (4, 64);
+  smaller.Setup (4, 64);
+  smaller.Remove (2);
+  for (uint32_t key = 0; key < 10000; ++key)
+    {
+      uint32_t owner = ring.GetOwner (key);
+      CHECK (smaller.GetOwner (key) != 2, string ("A removed node still owns keys"));
+      CHECK (owner == 2 || smaller.GetOwner (key) == owner,
+             "Key " + std::to_string (key) + " of a remaining node moved");
+    }
+}
+
+static void
+TestExpiry ()
+{
+  P4Cache<uint32_t, uint32_t> cache;
+  CacheConfig config;
+  config.capacity = 16;
+  config.idleTicks = 2;
+  SetupCache (cache, config);
+  uint32_t value;
+  cache.Put (5, 50);
+  SetCacheClock (cache, 1);
+  CHECK (cache.Get (5, value), string ("An entry expired before its idle timeout"));
+  SetCacheClock (cache, 2);
+  CHECK (cache.Get (5, value), string ("A hit did not refresh the idle timeout"));
+  SetCacheClock (cache, 4);
+  ExpireSlots (cache, 0, cache.GetSlots ());
+  CHECK (!cache.Find (5) && GetExpirations (cache) == 1,
+         string ("An idle entry was not expired"));
+
+  config.idleTicks = 0;
+  config.hardTicks = 3;
+  SetupCache (cache, config);
+  SetCacheClock (cache, UINT16_MAX);
+  cache.Put (6, 60);
+  SetCacheClock (cache, 1);
+  CHECK (cache.Get (6, value), string ("A hard timeout did not survive the clock wrap"));
+  SetCacheClock (cache, 2);
+  CHECK (!cache.Get (6, value), string ("An entry outlived its hard timeout"));
+}
+
+int
+main ()
+{
+  TestContract ();
+  TestLruOrder ();
+  TestBloomFilter ();
+  TestRange ();
+  TestLocators ();
+  TestHashRing ();
+  TestExpiry ();
+  if (g_failures > 0)
+    {
+      std::fprintf (stderr, "%d checks failed\n", g_failures);
+      return 1;
+    }
+  std::printf ("All checks passed\n");
+  return 0;
+}
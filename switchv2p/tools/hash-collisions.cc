@@ -0,0 +1,127 @@
+/*
+ * Reports how many conflict evictions each cache hash policy causes for the
+ * virtual IPs of a placement, and how much a hash costs.
+ *
+ * Container IDs (and thus virtual IPs) are assigned sequentially in placement
+ * order, as SimulationBase::AssignIds does. For every table size the keys are
+ * hashed into the table with one seed per simulated switch, and the number of
+ * distinct occupied slots is compared to what a perfect hash would achieve.
+ */
+
+#include "../include/cache-hash.h"
+#include "tool-args.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+using namespace boost::property_tree;
+using std::pair;
+
+static const char *USAGE =
+    "Usage: hash-collisions --placement=<placement.json> [options]\n"
+    "  --gateways=N       Extra IDs taken by gateway containers (default 0)\n"
+    "  --entries=A,B,...  Table sizes to evaluate (default 16,128,1024,8192)\n"
+    "  --seeds=N          Number of per-switch seeds to average over (default 80)\n"
+    "  --workingSet=W     Hash a random subset of W keys instead of all of them\n";
+
+struct Result
+{
+  double conflictRate;
+  double nsPerHash;
+};
+
+static double
+RandomHashConflictRate (double keys, double entries)
+{
+  double occupied = entries * (1 - std::pow (1 - 1 / entries, keys));
+  return 1 - occupied / std::min (keys, entries);
+}
+
+template <typename Hash>
+static Result
+Evaluate (const vector<uint32_t> &keys, size_t entries, uint32_t seeds)
+{
+  CacheIndex index;
+  index.SetSize (entries);
+  vector<uint32_t> slots (keys.size ());
+  std::mt19937 rng (entries);
+  double conflicts = 0, ns = 0;
+
+  for (uint32_t s = 0; s < seeds; ++s)
+    {
+      // Seed 0 is the switch default (RandomHashFunction=false)
+      uint32_t seed = s == 0 ? 0 : rng ();
+      auto start = std::chrono::steady_clock::now ();
+      for (size_t i = 0; i < keys.size (); ++i)
+        {
+          slots[i] = index.Reduce (Hash::Hash (keys[i], seed));
+        }
+      auto end = std::chrono::steady_clock::now ();
+      ns += std::chrono::duration<double, std::nano> (end - start).count () / keys.size ();
+
+      std::sort (slots.begin (), slots.end ());
+      size_t occupied = std::unique (slots.begin (), slots.end ()) - slots.begin ();
+      conflicts += 1 - occupied / (double) std::min (keys.size (), entries);
+    }
+
+  return Result{conflicts / seeds, ns / seeds};
+}
+
+int
+main (int argc, char *argv[])
+{
+  ToolArgs args (argc, argv, USAGE);
+  string placementFile = args.Get ("placement", "");
+  if (placementFile.empty ())
+    {
+      args.Usage (1);
+    }
+
+  ptree json;
+  read_json (placementFile, json);
+  uint32_t containerCount = args.GetUint ("gateways", 0);
+  for (auto &host : json)
+    {
+      containerCount += host.second.size ();
+    }
+
+  vector<uint32_t> keys (containerCount);
+  for (uint32_t id = 0; id < containerCount; ++id)
+    {
+      keys[id] = id;
+    }
+
+  size_t workingSet = args.GetUint ("workingSet", 0);
+  if (workingSet > 0 && workingSet < keys.size ())
+    {
+      std::mt19937 rng (workingSet);
+      std::shuffle (keys.begin (), keys.end (), rng);
+      keys.resize (workingSet);
+    }
+
+  uint32_t seeds = std::max<uint64_t> (1, args.GetUint ("seeds", 80));
+  printf ("hash,entries,keys,conflict_rate,random_conflict_rate,ns_per_hash\n");
+  for (uint64_t entries : args.GetUintList ("entries", "16,128,1024,8192"))
+    {
+      double random = RandomHashConflictRate (keys.size (), entries);
+      vector<pair<string, Result>> results = {
+          {"crc32", Evaluate<Crc32Hash> (keys, entries, seeds)},
+          {"crc32c", Evaluate<Crc32cHash> (keys, entries, seeds)},
+          {"multiply_shift", Evaluate<MultiplyShiftHash> (keys, entries, seeds)},
+          {"tofino_crc32", Evaluate<TofinoCrc32Hash> (keys, entries, seeds)},
+      };
+
+      for (auto &[name, result] : results)
+        {
+          printf ("%s,%lu,%zu,%.6f,%.6f,%.2f\n", name.c_str (), entries, keys.size (),
+                  result.conflictRate, random, result.nsPerHash);
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef INPUT_FILE_H
+#define INPUT_FILE_H
+
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cerrno>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+using std::string;
+
+/// A dataset file, decompressed on the fly if its name ends with .gz.
+class InputFile : public boost::iostreams::filtering_istream
+{
+public:
+  explicit InputFile (const string &path) : m_file (path, std::ios::binary)
+  {
+    if (!m_file.is_open ())
+      {
+        throw std::system_error (errno, std::generic_category (), path);
+      }
+    if (path.size () > 3 && path.compare (path.size () - 3, 3, ".gz") == 0)
+      {
+        push (boost::iostreams::gzip_decompressor ());
+      }
+    push (m_file);
+  }
+
+  ~InputFile ()
+  {
+    // Drop the chain while m_file is still alive
+    reset ();
+  }
+
+private:
+  std::ifstream m_file;
+};
+
+#endif /* INPUT_FILE_H */
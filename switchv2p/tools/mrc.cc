@@ -0,0 +1,461 @@
+/*
+ * Builds LRU miss-ratio curves for every switch type in one pass over a trace.
+ *
+ * The placement is laid out on leaves as TraceSimulation::ParsePlacement does,
+ * and every flow is walked from its source leaf to its gateway leaf over the
+ * spine and core switches it would cross. Each switch on the way looks up the
+ * destination virtual IP, so every switch gets its own access stream. Stack
+ * distances (Mattson et al., IBM Sys. J. '70) of each stream are computed with
+ * a Fenwick tree over access times. With --rate below 1 only keys whose hash
+ * falls under the rate are tracked, and their distances are scaled by 1/rate
+ * (SHARDS, Waldspurger et al., FAST '15), so very large traces fit in memory.
+ * Sampled curves do not resolve sizes below 1/rate.
+ *
+ * The output is a CSV of the hit ratio of an LRU cache of every size, per
+ * switch type. The curves assume every switch sees the full stream, they do
+ * not model packets that an earlier hit diverts away from the gateway.
+ *
+ * With --budget, the total number of entries of all switches is instead split
+ * over the switch types to minimize the lookups that reach a gateway, and the
+ * per-switch entries of every type are printed.
+ */
+
+#include "../include/cache-hash.h"
+#include "input-file.h"
+#include "placement.h"
+#include "tool-args.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+using namespace boost::property_tree;
+using std::map;
+using std::pair;
+using std::unordered_map;
+
+static const char *USAGE =
+    "Usage: mrc --placement=<placement.json[.gz]> --trace=<trace.csv[.gz]> [options]\n"
+    "  --topology=Clos|Fattree  Network topology (default Clos)\n"
+    "  --ports=N            Ports per switch, half of them face hosts (default 64)\n"
+    "  --core=N             Core switches of a fat-tree (default 16)\n"
+    "  --podWidth=N         Leaves per pod of a fat-tree (default 4)\n"
+    "  --gwLeaves=A,B,...   Gateway leaf indices, one per gateway (default 0)\n"
+    "  --gatewayPerFlowLoadBalancing  Pick the gateway by flow ID instead of by IP range\n"
+    "  --perPacket          One lookup per 1KB segment instead of one per flow\n"
+    "  --rate=R             SHARDS sampling rate, 1 tracks every key (default 1)\n"
+    "  --entries=A,B,...    Cache sizes to report (default 1, 2, 5, 10, ... up to the\n"
+    "                       number of distinct destinations)\n"
+    "  --budget=N           Split N entries over all switches instead of printing curves\n";
+
+static const uint32_t SEGMENT_SIZE = 1024;
+static const char *SWITCH_TYPES[] = {"leaf", "gw_leaf", "gw_spine", "spine", "core"};
+enum SwitchType { LEAF, GW_LEAF, GW_SPINE, SPINE, CORE, SWITCH_TYPES_COUNT };
+
+/// Prefix sums over access times, marking the last access of every key.
+class Fenwick
+{
+public:
+  explicit Fenwick (size_t size) : m_tree (size + 1, 0)
+  {
+  }
+
+  void
+  Add (size_t pos, int32_t delta)
+  {
+    for (++pos; pos < m_tree.size (); pos += pos & -pos)
+      {
+        m_tree[pos] += delta;
+      }
+  }
+
+  /// The sum over [0, pos).
+  int64_t
+  Sum (size_t pos) const
+  {
+    int64_t sum = 0;
+    for (; pos > 0; pos -= pos & -pos)
+      {
+        sum += m_tree[pos];
+      }
+    return sum;
+  }
+
+private:
+  vector<int32_t> m_tree;
+};
+
+struct Topology
+{
+  uint32_t leafCount, podWidth, coresPerSpine;
+  vector<enum SwitchType> types;
+  uint32_t firstSpine, firstCore;
+};
+
+static Topology
+BuildTopology (const ToolArgs &args, uint32_t leafCount, const vector<uint32_t> &gateways)
+{
+  Topology topo;
+  bool fattree = args.Get ("topology", "Clos") == "Fattree";
+  topo.leafCount = leafCount;
+  topo.podWidth = fattree ? args.GetUint ("podWidth", 4) : leafCount;
+  uint32_t coreCount = fattree ? args.GetUint ("core", 16) : 0;
+  topo.coresPerSpine = coreCount / topo.podWidth;
+  topo.firstSpine = leafCount;
+  topo.firstCore = 2 * leafCount;
+
+  vector<bool> gwPods (leafCount / topo.podWidth + 1, false);
+  for (uint32_t leaf : gateways)
+    {
+      gwPods[leaf / topo.podWidth] = true;
+    }
+  for (uint32_t leaf = 0; leaf < leafCount; ++leaf)
+    {
+      bool gw = std::find (gateways.begin (), gateways.end (), leaf) != gateways.end ();
+      topo.types.push_back (gw ? GW_LEAF : LEAF);
+    }
+  for (uint32_t spine = 0; spine < leafCount; ++spine)
+    {
+      topo.types.push_back (gwPods[spine / topo.podWidth] ? GW_SPINE : SPINE);
+    }
+  topo.types.insert (topo.types.end (), coreCount, CORE);
+  return topo;
+}
+
+static uint64_t
+Mix (uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * The switches between a source leaf and a gateway leaf, in order. ECMP picks
+ * are drawn from the flow ID, which spreads flows like per-flow ECMP does.
+ */
+static void
+GetPath (const Topology &topo, uint32_t srcLeaf, uint32_t gwLeaf, uint32_t flowId,
+         vector<uint32_t> &path)
+{
+  path.assign (1, srcLeaf);
+  if (srcLeaf == gwLeaf)
+    {
+      return;
+    }
+
+  uint64_t hash = Mix (flowId);
+  uint32_t srcPod = srcLeaf / topo.podWidth, gwPod = gwLeaf / topo.podWidth;
+  uint32_t spineOffset = hash % topo.podWidth;
+  path.push_back (topo.firstSpine + srcPod * topo.podWidth + spineOffset);
+  if (srcPod != gwPod)
+    {
+      uint32_t core = spineOffset * topo.coresPerSpine + (hash >> 32) % topo.coresPerSpine;
+      path.push_back (topo.firstCore + core);
+      path.push_back (topo.firstSpine + gwPod * topo.podWidth + spineOffset);
+    }
+  path.push_back (gwLeaf);
+}
+
+/// The LRU hit ratio of one switch type at every cache size.
+struct Curve
+{
+  /// hits[s] counts the reuses at a stack distance below s
+  vector<uint64_t> hits;
+  double total, adjustment;
+
+  double
+  HitRatio (uint64_t size) const
+  {
+    if (size == 0 || total + adjustment <= 0)
+      {
+        return 0;
+      }
+    double ratio = (hits[std::min<uint64_t> (size, hits.size () - 1)] + adjustment) /
+                   (total + adjustment);
+    return std::min (std::max (ratio, 0.0), 1.0);
+  }
+};
+
+/// The lookups that reach a gateway, taking the lowest miss ratio on each path.
+static double
+GetGatewayLookups (const vector<Curve> &curves, const map<uint32_t, uint64_t> &pathLookups,
+                   const vector<uint64_t> &sizes)
+{
+  double gatewayLookups = 0;
+  for (auto &[types, lookups] : pathLookups)
+    {
+      double missRatio = 1;
+      for (int type = 0; type < SWITCH_TYPES_COUNT; ++type)
+        {
+          if (types & (1 << type))
+            {
+              missRatio = std::min (missRatio, 1 - curves[type].HitRatio (sizes[type]));
+            }
+        }
+      gatewayLookups += lookups * missRatio;
+    }
+  return gatewayLookups;
+}
+
+/**
+ * Splits \p budget entries over the switches, greedily growing the switch type
+ * that saves the most gateway lookups per entry. Growth is searched over a
+ * geometric grid of sizes, so plateaus in a curve do not stop the search. A
+ * lookup is assumed to miss all the switches on its path if it misses the one
+ * with the lowest miss ratio, as the caches mostly hold the same popular keys.
+ */
+static vector<uint64_t>
+SplitBudget (const vector<Curve> &curves, const vector<uint64_t> &switches,
+             const map<uint32_t, uint64_t> &pathLookups, uint64_t budget, uint64_t maxSize)
+{
+  vector<uint64_t> grid (1, 0);
+  while (grid.back () < maxSize)
+    {
+      grid.push_back (std::min<uint64_t> (std::max (grid.back () + 1, grid.back () * 21 / 20),
+                                          maxSize));
+    }
+
+  vector<uint64_t> sizes (SWITCH_TYPES_COUNT, 0);
+  vector<size_t> steps (SWITCH_TYPES_COUNT, 0);
+  double gatewayLookups = GetGatewayLookups (curves, pathLookups, sizes);
+  while (true)
+    {
+      double bestGain = 0;
+      int bestType = -1;
+      size_t bestStep = 0;
+      for (int type = 0; type < SWITCH_TYPES_COUNT; ++type)
+        {
+          if (switches[type] == 0)
+            {
+              continue;
+            }
+          vector<uint64_t> candidate = sizes;
+          for (size_t step = steps[type] + 1; step < grid.size (); ++step)
+            {
+              uint64_t cost = switches[type] * (grid[step] - sizes[type]);
+              if (cost > budget)
+                {
+                  break;
+                }
+              candidate[type] = grid[step];
+              double gain =
+                  (gatewayLookups - GetGatewayLookups (curves, pathLookups, candidate)) / cost;
+              if (gain > bestGain)
+                {
+                  bestGain = gain;
+                  bestType = type;
+                  bestStep = step;
+                }
+            }
+        }
+      if (bestType < 0)
+        {
+          break;
+        }
+      budget -= switches[bestType] * (grid[bestStep] - sizes[bestType]);
+      sizes[bestType] = grid[bestStep];
+      steps[bestType] = bestStep;
+      gatewayLookups = GetGatewayLookups (curves, pathLookups, sizes);
+    }
+  return sizes;
+}
+
+/// Adds the stack distances of one switch's accesses to \p histogram, scaled by 1/rate.
+static uint64_t
+AddStackDistances (const vector<uint32_t> &accesses, double rate, vector<uint64_t> &histogram)
+{
+  Fenwick marks (accesses.size ());
+  unordered_map<uint32_t, size_t> lastAccess;
+  uint64_t coldMisses = 0;
+  for (size_t t = 0; t < accesses.size (); ++t)
+    {
+      auto it = lastAccess.find (accesses[t]);
+      if (it == lastAccess.end ())
+        {
+          coldMisses++;
+          lastAccess.emplace (accesses[t], t);
+        }
+      else
+        {
+          // Distinct keys touched since the previous access to this one
+          uint64_t distance = marks.Sum (t) - marks.Sum (it->second + 1);
+          size_t bucket = std::llround (distance / rate);
+          if (histogram.size () <= bucket)
+            {
+              histogram.resize (bucket + 1, 0);
+            }
+          histogram[bucket]++;
+          marks.Add (it->second, -1);
+          it->second = t;
+        }
+      marks.Add (t, 1);
+    }
+  return coldMisses;
+}
+
+int
+main (int argc, char *argv[])
+{
+  ToolArgs args (argc, argv, USAGE);
+  string placementFile = args.Get ("placement", ""), traceFile = args.Get ("trace", "");
+  if (placementFile.empty () || traceFile.empty ())
+    {
+      args.Usage (1);
+    }
+  double rate = args.GetDouble ("rate", 1);
+  if (rate <= 0 || rate > 1)
+    {
+      args.Usage (1);
+    }
+  bool perPacket = args.Get ("perPacket", "false") == "true";
+  bool perFlowGateway = args.Get ("gatewayPerFlowLoadBalancing", "false") == "true";
+
+  vector<uint64_t> gwLeaves = args.GetUintList ("gwLeaves", "0");
+  unordered_map<string, uint32_t> ids;
+  vector<uint32_t> gateways;
+  vector<uint32_t> leafOf =
+      PlaceContainers (placementFile, args.GetUint ("ports", 64) / 2, gwLeaves, ids, gateways);
+  if (gateways.empty ())
+    {
+      throw std::runtime_error ("No gateway leaf in the placement");
+    }
+  uint32_t leafCount = *std::max_element (leafOf.begin (), leafOf.end ()) + 1;
+  Topology topo = BuildTopology (args, leafCount, gateways);
+  uint32_t gatewayRange = ids.size () / gateways.size ();
+
+  // Flows in time order: (ts, flowId, source, destination, size)
+  InputFile in (traceFile);
+  vector<std::tuple<uint64_t, uint32_t, uint32_t, uint32_t, uint32_t>> flows;
+  string line;
+  while (std::getline (in, line))
+    {
+      std::istringstream ss (line);
+      vector<string> fields;
+      string field;
+      while (std::getline (ss, field, ','))
+        {
+          fields.push_back (field);
+        }
+      if (fields.size () < 5)
+        {
+          continue;
+        }
+      flows.emplace_back (std::stoull (fields[2]), std::stoul (fields[3]), ids.at (fields[0]),
+                          ids.at (fields[1]), std::stoul (fields[4]));
+    }
+  std::stable_sort (flows.begin (), flows.end (),
+                    [] (const auto &a, const auto &b) { return std::get<0> (a) < std::get<0> (b); });
+
+  // Spatial sampling keeps a key in every stream or in none of them
+  uint32_t threshold = (uint32_t) std::min (rate * 4294967296.0, 4294967295.0);
+  vector<vector<uint32_t>> accesses (topo.types.size ());
+  vector<uint64_t> lookups (SWITCH_TYPES_COUNT, 0);
+  // Lookups per set of switch types on the path, as a bit mask
+  map<uint32_t, uint64_t> pathLookups;
+  vector<uint32_t> path;
+  size_t distinct = 0;
+  vector<bool> seen (ids.size (), false);
+  for (auto &[ts, flowId, src, dst, size] : flows)
+    {
+      uint32_t gwIdx =
+          perFlowGateway
+              ? Crc32Table<0xEDB88320>::Calculate ((const uint8_t *) &flowId, sizeof (flowId)) %
+                    gateways.size ()
+              : std::min<uint32_t> (dst / gatewayRange, gateways.size () - 1);
+      GetPath (topo, leafOf[src], gateways[gwIdx], flowId, path);
+      uint32_t count = perPacket ? std::max<uint32_t> ((size + SEGMENT_SIZE - 1) / SEGMENT_SIZE, 1)
+                                 : 1;
+      bool sampled = Crc32Hash::Hash<uint32_t> (dst, 0x5bd1e995) <= threshold;
+      distinct += seen[dst] ? 0 : 1;
+      seen[dst] = true;
+      uint32_t pathTypes = 0;
+      for (uint32_t sw : path)
+        {
+          pathTypes |= 1 << topo.types[sw];
+          lookups[topo.types[sw]] += count;
+          if (sampled)
+            {
+              accesses[sw].insert (accesses[sw].end (), count, dst);
+            }
+        }
+      pathLookups[pathTypes] += count;
+    }
+
+  vector<vector<uint64_t>> histograms (SWITCH_TYPES_COUNT);
+  vector<uint64_t> sampledLookups (SWITCH_TYPES_COUNT, 0);
+  for (size_t sw = 0; sw < accesses.size (); ++sw)
+    {
+      AddStackDistances (accesses[sw], rate, histograms[topo.types[sw]]);
+      sampledLookups[topo.types[sw]] += accesses[sw].size ();
+      vector<uint32_t> ().swap (accesses[sw]);
+    }
+
+  // SHARDS-adj: the sampled lookups short of rate * lookups are counted as reuses at distance 0
+  vector<Curve> curves (SWITCH_TYPES_COUNT);
+  vector<uint64_t> switches (SWITCH_TYPES_COUNT, 0);
+  for (int type = 0; type < SWITCH_TYPES_COUNT; ++type)
+    {
+      Curve &curve = curves[type];
+      curve.hits.assign (1, 0);
+      for (uint64_t count : histograms[type])
+        {
+          curve.hits.push_back (curve.hits.back () + count);
+        }
+      curve.total = sampledLookups[type];
+      curve.adjustment = rate < 1 ? rate * lookups[type] - curve.total : 0;
+      switches[type] = std::count (topo.types.begin (), topo.types.end (), type);
+    }
+
+  if (args.Get ("budget", "").size () > 0)
+    {
+      vector<uint64_t> sizes = SplitBudget (curves, switches, pathLookups,
+                                            args.GetUint ("budget", 0), std::max<size_t> (distinct, 1));
+      printf ("switch_type,switches,entries,hit_ratio\n");
+      for (int type = 0; type < SWITCH_TYPES_COUNT; ++type)
+        {
+          printf ("%s,%lu,%lu,%.6f\n", SWITCH_TYPES[type], switches[type], sizes[type],
+                  curves[type].HitRatio (sizes[type]));
+        }
+      uint64_t totalLookups = 0;
+      for (auto &[types, count] : pathLookups)
+        {
+          totalLookups += count;
+        }
+      fprintf (stderr, "Estimated gateway lookups: %.0f of %lu\n",
+               GetGatewayLookups (curves, pathLookups, sizes), totalLookups);
+      return 0;
+    }
+
+  vector<uint64_t> entries = args.GetUintList ("entries", "");
+  if (entries.empty ())
+    {
+      for (uint64_t scale = 1; scale <= std::max<size_t> (distinct, 1); scale *= 10)
+        {
+          for (uint64_t step : {1, 2, 5})
+            {
+              entries.push_back (scale * step);
+            }
+        }
+    }
+
+  printf ("switch_type,entries,lookups,hit_ratio\n");
+  for (int type = 0; type < SWITCH_TYPES_COUNT; ++type)
+    {
+      if (lookups[type] == 0)
+        {
+          continue;
+        }
+      for (uint64_t size : entries)
+        {
+          printf ("%s,%lu,%lu,%.6f\n", SWITCH_TYPES[type], size, lookups[type],
+                  curves[type].HitRatio (size));
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "input-file.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <unordered_map>
+#include <vector>
+
+using std::unordered_map;
+using std::vector;
+
+/**
+ * Lays the placement hosts on leaves, adds the gateways and assigns container
+ * IDs in order, as TraceSimulation::ParsePlacement and SimulationBase::AssignIds
+ * do. Returns the leaf of every container ID and sets the gateway leaves. If
+ * \p hostOf is given, it gets the host of every container ID, gateways
+ * counting as hosts of their own.
+ */
+inline vector<uint32_t>
+PlaceContainers (const string &path, uint32_t nodesPerLeaf, const vector<uint64_t> &gwLeaves,
+                 unordered_map<string, uint32_t> &ids, vector<uint32_t> &gateways,
+                 vector<uint32_t> *hostOf = nullptr)
+{
+  InputFile in (path);
+  boost::property_tree::ptree json;
+  boost::property_tree::read_json (in, json);
+  vector<vector<string>> hosts;
+  for (auto &host : json)
+    {
+      vector<string> containers;
+      for (auto &container : host.second)
+        {
+          containers.push_back (container.second.get_value<string> ());
+        }
+      hosts.push_back (containers);
+    }
+
+  vector<uint32_t> leafOf;
+  size_t hostIdx = 0, gwIdx = 0, leafCount = hosts.size () / nodesPerLeaf;
+  uint32_t host = 0;
+  for (uint32_t leaf = 0; leaf < leafCount; ++leaf)
+    {
+      // The last leaf takes the remaining hosts
+      size_t end = leaf + 1 == leafCount ? hosts.size () : hostIdx + nodesPerLeaf;
+      for (; hostIdx < end; ++hostIdx, ++host)
+        {
+          for (const string &container : hosts[hostIdx])
+            {
+              ids[container] = leafOf.size ();
+              leafOf.push_back (leaf);
+              if (hostOf)
+                {
+                  hostOf->push_back (host);
+                }
+            }
+        }
+      for (; gwIdx < gwLeaves.size () && gwLeaves[gwIdx] == leaf; ++gwIdx, ++host)
+        {
+          gateways.push_back (leaf);
+          ids["Gateway" + std::to_string (gwIdx)] = leafOf.size ();
+          leafOf.push_back (leaf);
+          if (hostOf)
+            {
+              hostOf->push_back (host);
+            }
+        }
+    }
+  return leafOf;
+}
+
+#endif /* PLACEMENT_H */
@@ -0,0 +1,83 @@
+#ifndef TOOL_ARGS_H
+#define TOOL_ARGS_H
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::vector;
+
+/**
+ * Minimal --name=value parser for the standalone tools, which cannot use
+ * ns3::CommandLine.
+ */
+class ToolArgs
+{
+public:
+  ToolArgs (int argc, char *argv[], string usage) : m_usage (usage)
+  {
+    for (int i = 1; i < argc; ++i)
+      {
+        string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || arg.rfind ("--", 0) != 0)
+          {
+            Usage (arg == "--help" || arg == "-h" ? 0 : 1);
+          }
+        size_t eq = arg.find ('=');
+        m_values[arg.substr (2, eq == string::npos ? string::npos : eq - 2)] =
+            eq == string::npos ? "true" : arg.substr (eq + 1);
+      }
+  }
+
+  string
+  Get (const string &name, const string &def) const
+  {
+    auto it = m_values.find (name);
+    return it == m_values.end () ? def : it->second;
+  }
+
+  uint64_t
+  GetUint (const string &name, uint64_t def) const
+  {
+    auto it = m_values.find (name);
+    return it == m_values.end () ? def : std::stoull (it->second);
+  }
+
+  double
+  GetDouble (const string &name, double def) const
+  {
+    auto it = m_values.find (name);
+    return it == m_values.end () ? def : std::stod (it->second);
+  }
+
+  vector<uint64_t>
+  GetUintList (const string &name, const string &def) const
+  {
+    vector<uint64_t> values;
+    std::istringstream ss (Get (name, def));
+    string token;
+    while (std::getline (ss, token, ','))
+      {
+        values.push_back (std::stoull (token));
+      }
+    return values;
+  }
+
+  void
+  Usage (int status) const
+  {
+    (status ? std::cerr : std::cout) << m_usage;
+    std::exit (status);
+  }
+
+private:
+  string m_usage;
+  map<string, string> m_values;
+};
+
+#endif /* TOOL_ARGS_H */
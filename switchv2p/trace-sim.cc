@@ -7,8 +7,12 @@
 #include "include/ilp-controller-app-helper.h"
 #include "include/switch-app-helper.h"
 #include "include/p4-switch-app-helper.h"
+#include "include/eviction-tag.h"
+#include "include/epoch-tag.h"
+#include "include/invalidation-tag.h"
 #include "ns3/delay-jitter-estimation.h"
 #include "ns3/hops-tag.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <random>
@@ -36,13 +40,43 @@ TraceSimulation::TraceSimulation (string placementJsonPath, string traceCsvPath,
       m_droppedPackets (0),
       m_totalPacketLatency (0),
       m_totalPacketHops (0),
+      m_admissions (0),
+      m_admissionRejections (0),
+      m_controlPackets (0),
+      m_controlBytes (0),
+      m_steeredPackets (0),
+      m_forwardedVictims (0),
+      m_installedVictims (0),
+      m_victimHits (0),
+      m_victimControlBytes (0),
+      m_staleEntries (0),
+      m_staleHits (0),
+      m_directoryInvalidations (0),
+      m_directoryUpdates (0),
+      m_steeredReceivedPackets (0),
+      m_steeredPacketHops (0),
       m_startTime (Seconds (0)),
       m_stopTime (Seconds (0)),
+      m_lastMappingUpdate (Seconds (0)),
+      m_lastStaleHit (Seconds (0)),
       m_containerToFlows (ParseTrace (traceCsvPath)),
       m_outputPath (outputPath),
-      m_migrationParams (migrationParams)
+      m_directory (m_podCount),
+      m_migrationParams (migrationParams),
+      m_replay (m_podCount, m_podWidth, m_coreCount, simulationParameters.RandomRouting)
 {
   CalculateDestinations ();
+  if (!m_migrationParams.schedule.empty ())
+    {
+      m_migrations = ParseMigrationSchedule (m_migrationParams.schedule);
+    }
+  else if (m_migrationParams.migration)
+    {
+      m_migrations.push_back (MigrationEvent (m_migrationParams.ts, m_migrationParams.containerId,
+                                              m_migrationParams.dstLeaf,
+                                              m_migrationParams.dstHost));
+    }
+  m_migrationStats.resize (m_migrations.size ());
 }
 
 void
@@ -98,6 +132,113 @@ TraceSimulation::ParseTrace (string traceCsvPath)
   return containerToFlows;
 }
 
+vector<MigrationEvent>
+TraceSimulation::ParseMigrationSchedule (string scheduleCsvPath)
+{
+  vector<MigrationEvent> events;
+  ifstream infile (scheduleCsvPath);
+  if (!infile.is_open ())
+    {
+      throw std::system_error (errno, std::generic_category (), scheduleCsvPath);
+    }
+  infile.exceptions (ifstream::badbit);
+
+  string line;
+  while (getline (infile, line))
+    {
+      if (line.empty () || line[0] == '#')
+        continue;
+      istringstream ss (line);
+      vector<string> parsedLine;
+      string token;
+      while (getline (ss, token, ','))
+        parsedLine.push_back (token);
+      parsedLine.resize (std::max<size_t> (parsedLine.size (), 5));
+
+      uint64_t ts = stoull (parsedLine[0]);
+      NS_ABORT_MSG_IF (m_containerToId.count (parsedLine[1]) == 0,
+                       "Unknown container " << parsedLine[1] << " in " << scheduleCsvPath);
+      uint32_t containerId = m_containerToId[parsedLine[1]];
+      MigrationEvent::Type type = MigrationEvent::MIGRATE;
+      if (parsedLine[4] == "create")
+        {
+          type = MigrationEvent::CREATE;
+        }
+      else if (parsedLine[4] == "destroy")
+        {
+          type = MigrationEvent::DESTROY;
+        }
+      else
+        {
+          NS_ABORT_MSG_IF (!parsedLine[4].empty () && parsedLine[4] != "migrate",
+                           "Unknown VM event " << parsedLine[4] << " in " << scheduleCsvPath);
+        }
+      NS_ABORT_MSG_IF (type != MigrationEvent::MIGRATE &&
+                           m_simParameters.SimMode == SimulationParameters::Mode::Bluebird,
+                       "VM create and destroy events are not supported with simMode=Bluebird");
+
+      uint32_t leaf = 0, host = 0;
+      if (type != MigrationEvent::DESTROY)
+        {
+          leaf = stoi (parsedLine[2]);
+          host = stoi (parsedLine[3]);
+          NS_ABORT_MSG_IF (leaf >= m_leafCount || host >= m_containerGroups[leaf].size () ||
+                               std::find (m_gws.begin (), m_gws.end (),
+                                          std::make_pair (leaf, host)) != m_gws.end (),
+                           "No host " << host << " of leaf " << leaf << " to place container "
+                                      << parsedLine[1] << " on");
+        }
+      events.push_back (MigrationEvent (ts, containerId, leaf, host, type));
+    }
+
+  std::stable_sort (events.begin (), events.end (),
+                    [] (const MigrationEvent &a, const MigrationEvent &b) { return a.ts < b.ts; });
+  // A VM whose first event creates it is reserved, it does not run until then. Only a VM that
+  // does not run can be created, and only a running VM can move or be destroyed.
+  set<uint32_t> seen, stopped;
+  for (const MigrationEvent &event : events)
+    {
+      if (seen.insert (event.containerId).second && event.type == MigrationEvent::CREATE)
+        {
+          m_reservedContainers.insert (event.containerId);
+          stopped.insert (event.containerId);
+        }
+      bool running = stopped.count (event.containerId) == 0;
+      NS_ABORT_MSG_IF (event.type == MigrationEvent::CREATE && running,
+                       "Create of container " << event.containerId << " while it runs in "
+                                              << scheduleCsvPath);
+      NS_ABORT_MSG_IF (event.type != MigrationEvent::CREATE && !running,
+                       "Event of container " << event.containerId << " while it does not run in "
+                                             << scheduleCsvPath);
+      if (event.type == MigrationEvent::DESTROY)
+        {
+          stopped.insert (event.containerId);
+        }
+      else if (event.type == MigrationEvent::CREATE)
+        {
+          stopped.erase (event.containerId);
+        }
+    }
+  return events;
+}
+
+void
+TraceSimulation::Run ()
+{
+  if (m_simParameters.SimMode != SimulationParameters::Mode::CacheOnly)
+    {
+      SimulationBase::Run ();
+      return;
+    }
+
+  Configure ();
+  InitializeNodes ();
+  MapContainers ();
+  SetupCacheReplay ();
+  StartSimulation ();
+  StopSimulation ();
+}
+
 void
 TraceSimulation::Configure ()
 {
@@ -123,6 +264,12 @@ TraceSimulation::CreatePtree (unordered_map<uint32_t, T> &map)
 void
 TraceSimulation::StopSimulation ()
 {
+  // Read before the simulator is destroyed
+  uint64_t events = Simulator::GetEventCount ();
+  double simulatedSeconds = Simulator::Now ().GetSeconds ();
+  ptree podSpineEntries, podUniqueSpineEntries, coreEntries, uniqueCoreEntries;
+  CountCachedEntries (m_spines, m_podWidth, podSpineEntries, podUniqueSpineEntries);
+  CountCachedEntries (m_cores, m_coreCount, coreEntries, uniqueCoreEntries);
   SimulationBase::StopSimulation ();
   NS_LOG_INFO ("Total sent packets =  " << m_sentPackets);
   NS_LOG_INFO ("Total receieved packets =  " << m_receivedPackets);
@@ -134,13 +281,99 @@ TraceSimulation::StopSimulation ()
   json.put ("total_gw_packets", m_gwPackets);
   json.put ("total_learning_packets", m_generatedLearning);
   json.put ("total_invalidation_packets", m_generatedInvalidation);
+  json.put ("total_control_packets", m_controlPackets);
+  json.put ("total_control_bytes", m_controlBytes);
+  json.put ("total_steered_packets", m_steeredPackets);
+  json.put ("total_forwarded_victims", m_forwardedVictims);
+  json.put ("total_installed_victims", m_installedVictims);
+  json.put ("total_victim_hits", m_victimHits);
+  json.put ("victim_rehit_rate",
+            std::to_string (m_installedVictims ? double (m_victimHits) / m_installedVictims : 0));
+  json.put ("total_victim_control_bytes", m_victimControlBytes);
+  json.put ("total_simulator_events", events);
+  json.put ("simulator_events_per_second",
+            std::to_string (simulatedSeconds > 0 ? events / simulatedSeconds : 0));
+  json.put ("total_admissions", m_admissions);
+  json.put ("total_admission_rejections", m_admissionRejections);
   json.put ("total_misdelivered_packets", m_misdeliveryCount);
+  json.put ("total_stale_entries", m_staleEntries);
+  json.put ("total_stale_hits", m_staleHits);
+  json.put ("time_to_consistency_us",
+            Max (m_lastStaleHit - m_lastMappingUpdate, Seconds (0)).GetMicroSeconds ());
+  json.put ("directory_bytes", m_directory.GetPeakBytes ());
+  json.put ("total_directory_invalidations", m_directoryInvalidations);
+  json.put ("directory_invalidation_fanout",
+            std::to_string (
+                m_directoryUpdates ? double (m_directoryInvalidations) / m_directoryUpdates : 0));
   json.put ("last_misdelivered_packet", m_lastMisdelivered.As (Time::US));
 
+  // Each VM event of the migration schedule, in time order
+  static const char *eventTypes[] = {"migrate", "create", "destroy"};
+  ptree migrations;
+  for (size_t event = 0; event < m_migrations.size (); ++event)
+    {
+      const MigrationStats &stats = m_migrationStats[event];
+      int64_t convergence = stats.misdelivered ? stats.lastMisdelivered / 1000 -
+                                                     static_cast<int64_t> (m_migrations[event].ts)
+                                               : 0;
+      ptree migration;
+      migration.put ("ts_us", m_migrations[event].ts);
+      migration.put ("container", m_migrations[event].containerId);
+      migration.put ("event", eventTypes[m_migrations[event].type]);
+      migration.put ("misdelivered_packets", stats.misdelivered);
+      migration.put ("convergence_us", std::max<int64_t> (convergence, 0));
+      migration.put ("extra_gateway_packets",
+                     static_cast<int64_t> (stats.gatewayAfter) -
+                         static_cast<int64_t> (stats.gatewayBefore));
+      migrations.push_back (std::make_pair ("", migration));
+    }
+  json.add_child ("migrations", migrations);
+
   json.add_child ("switch_to_processed_packets", CreatePtree (m_switchToProcessedPackets));
   json.add_child ("switch_to_processed_bytes", CreatePtree (m_switchToProcessedBytes));
   json.add_child ("switch_to_hits", CreatePtree (m_switchToCacheHits));
   json.add_child ("switch_to_first_hits", CreatePtree (m_switchToFirstCacheHits));
+  json.add_child ("switch_to_admissions", CreatePtree (m_switchToAdmissions));
+  json.add_child ("switch_to_admission_rejections", CreatePtree (m_switchToAdmissionRejections));
+
+  // Control packets whose oldest mapping waited less than each power of two microseconds
+  ptree flushLatencies;
+  for (size_t bucket = 0; bucket < m_controlFlushLatencies.size (); ++bucket)
+    {
+      flushLatencies.put (std::to_string (1ull << bucket), m_controlFlushLatencies[bucket]);
+    }
+  json.add_child ("control_flush_latency_us", flushLatencies);
+
+  ptree generateProbabilities;
+  for (auto &entry : m_switchToGenerateProbability)
+    {
+      generateProbabilities.add_child (std::to_string (entry.first), entry.second);
+    }
+  json.add_child ("switch_to_generate_probability", generateProbabilities);
+  json.add_child ("pod_to_spine_entries", podSpineEntries);
+  json.add_child ("pod_to_unique_spine_entries", podUniqueSpineEntries);
+  json.put ("core_entries", coreEntries.get<uint64_t> ("0", 0));
+  json.put ("unique_core_entries", uniqueCoreEntries.get<uint64_t> ("0", 0));
+
+  // The cache entries of every switch type, in SwitchType order
+  static const char *switchTypes[] = {"leaf", "gw_leaf", "gw_spine", "spine", "core"};
+  ptree memorySizes;
+  uint64_t totalMemorySize = 0, totalMemoryBytes = 0, totalExpirations = 0;
+  for (auto it = m_switchApps.Begin (); it != m_switchApps.End (); ++it)
+    {
+      Ptr<P4SwitchApp> app = DynamicCast<P4SwitchApp> (*it);
+      if (app)
+        {
+          memorySizes.put (switchTypes[app->GetSwitchType ()], app->GetMemorySize ());
+          totalMemorySize += app->GetMemorySize ();
+          totalMemoryBytes += app->GetMemorySize () * app->GetEntryBytes ();
+          totalExpirations += app->GetExpiredEntries ();
+        }
+    }
+  json.add_child ("switch_type_memory_sizes", memorySizes);
+  json.put ("total_switch_memory_size", totalMemorySize);
+  json.put ("total_switch_memory_bytes", totalMemoryBytes);
+  json.put ("total_expirations", totalExpirations);
 
   uint64_t totalFct = 0, totalFirstPacketLatency = 0;
   for (pair<uint32_t, FlowStats> fsPair : m_flowStats)
@@ -157,6 +390,16 @@ TraceSimulation::StopSimulation ()
             std::to_string (m_totalPacketLatency / static_cast<double> (m_receivedPackets)));
   json.put ("avg_packet_hops",
             std::to_string (m_totalPacketHops / static_cast<double> (m_receivedPackets)));
+  // The path stretch of ExclusiveSpines, steered against unsteered packets
+  uint64_t unsteeredPackets = m_receivedPackets - m_steeredReceivedPackets;
+  json.put ("avg_steered_packet_hops",
+            std::to_string (m_steeredReceivedPackets
+                                ? m_steeredPacketHops / static_cast<double> (m_steeredReceivedPackets)
+                                : 0));
+  json.put ("avg_unsteered_packet_hops",
+            std::to_string (unsteeredPackets ? (m_totalPacketHops - m_steeredPacketHops) /
+                                                   static_cast<double> (unsteeredPackets)
+                                             : 0));
 
   std::ofstream outputFile (m_outputPath);
   write_json (outputFile, json);
@@ -245,6 +488,11 @@ TraceSimulation::SinkRx (Ptr<const Packet> p, const Address &a, const Time &txTi
   if (p->PeekPacketTag (tag))
     {
       m_totalPacketHops += tag.GetHops ();
+      if (m_steeredUids.erase (p->GetUid ()))
+        {
+          m_steeredReceivedPackets++;
+          m_steeredPacketHops += tag.GetHops ();
+        }
     }
 
   PacketStats first = m_flowStats[flowId].first;
@@ -259,9 +507,49 @@ TraceSimulation::SinkRx (Ptr<const Packet> p, const Address &a, const Time &txTi
 }
 
 void
-TraceSimulation::GatewayRx (Ptr<const Packet>, const Address &)
+TraceSimulation::GatewayRx (Ptr<const Packet>, const Address &address)
 {
   m_gwPackets++;
+  if (m_vmEvents.empty () || !Ipv4Address::IsMatchingType (address))
+    {
+      return;
+    }
+
+  auto events = m_vmEvents.find (Ipv4Address::ConvertFrom (address).Get ());
+  if (events == m_vmEvents.end ())
+    {
+      return;
+    }
+  // The windows are around the event, so count the packet when the gateway received it
+  Time received = Simulator::Now ();
+  if (m_simParameters.SimMode != SimulationParameters::Mode::CacheOnly)
+    {
+      received -= MicroSeconds (GatewayApp::PROCESSING_US);
+    }
+  Time window = MicroSeconds (m_migrationParams.window);
+  for (size_t event : events->second)
+    {
+      Time ts = MicroSeconds (m_migrations[event].ts);
+      if (received >= ts - window && received < ts)
+        {
+          m_migrationStats[event].gatewayBefore++;
+        }
+      else if (received >= ts && received < ts + window)
+        {
+          m_migrationStats[event].gatewayAfter++;
+        }
+    }
+}
+
+void
+TraceSimulation::Misdelivered (Ipv4Address vip)
+{
+  auto event = m_vmLastEvent.find (vip.Get ());
+  if (event != m_vmLastEvent.end ())
+    {
+      m_migrationStats[event->second].misdelivered++;
+      m_migrationStats[event->second].lastMisdelivered = Simulator::Now ().ToInteger (Time::NS);
+    }
 }
 
 void
@@ -326,11 +614,167 @@ TraceSimulation::GeneratedInvalidation (Ptr<const Packet>)
   m_generatedInvalidation++;
 }
 
+void
+TraceSimulation::ControlPacket (Ptr<const Packet> packet, Time latency)
+{
+  m_controlPackets++;
+  m_controlBytes += packet->GetSize ();
+  ControlTag tag;
+  if (packet->PeekPacketTag (tag) && tag.GetVictimHops () > 0)
+    {
+      m_victimControlBytes += packet->GetSize ();
+    }
+  size_t bucket = 0;
+  while (latency.GetMicroSeconds () >= (1ll << bucket))
+    {
+      ++bucket;
+    }
+  if (m_controlFlushLatencies.size () <= bucket)
+    {
+      m_controlFlushLatencies.resize (bucket + 1);
+    }
+  m_controlFlushLatencies[bucket]++;
+}
+
 void
 TraceSimulation::ProcessedPacket (Ptr<const Packet> packet, uint32_t switchId)
 {
   m_switchToProcessedPackets[switchId]++;
-  m_switchToProcessedBytes[switchId] += packet->GetSize ();
+  // The mappings a packet carries are a header on the wire, not a part of its payload
+  EvictionTag evictionTag;
+  uint32_t tagBytes = packet->PeekPacketTag (evictionTag) ? evictionTag.GetSerializedSize () : 0;
+  m_switchToProcessedBytes[switchId] += packet->GetSize () + tagBytes;
+}
+
+void
+TraceSimulation::GenerateProbability (uint32_t switchId, double probability)
+{
+  m_switchToGenerateProbability[switchId].put (
+      std::to_string (Simulator::Now ().GetMicroSeconds ()), probability);
+}
+
+void
+TraceSimulation::SteeredPacket (Ptr<const Packet> packet, uint32_t)
+{
+  m_steeredPackets++;
+  m_steeredUids.insert (packet->GetUid ());
+}
+
+void
+TraceSimulation::VictimForwarded (uint32_t)
+{
+  m_forwardedVictims++;
+}
+
+void
+TraceSimulation::VictimInstalled (uint32_t)
+{
+  m_installedVictims++;
+}
+
+void
+TraceSimulation::VictimHit (uint32_t)
+{
+  m_victimHits++;
+}
+
+void
+TraceSimulation::StaleEntry (uint32_t)
+{
+  m_staleEntries++;
+}
+
+void
+TraceSimulation::StaleHit (uint32_t)
+{
+  m_staleHits++;
+  m_lastStaleHit = Simulator::Now ();
+}
+
+void
+TraceSimulation::SourceLearned (uint32_t vip, Ipv4Address switchAddress)
+{
+  m_directory.Record (vip, switchAddress);
+}
+
+void
+TraceSimulation::InvalidateDirectory (uint32_t vip, uint32_t physical)
+{
+  set<uint32_t> switches = m_directory.Take (vip);
+  for (uint32_t switchAddress : switches)
+    {
+      Ptr<Packet> packet = Create<Packet> (64);
+      ControlTag tag;
+      tag.SetLearning (false);
+      tag.AddMapping (std::make_pair (vip, physical));
+      packet->AddPacketTag (tag);
+      if (m_simParameters.SimMode == SimulationParameters::Mode::CacheOnly)
+        {
+          UdpHeader udpHeader;
+          udpHeader.SetSourcePort (P4SwitchApp::SWITCH_PORT);
+          udpHeader.SetDestinationPort (P4SwitchApp::SWITCH_PORT);
+          packet->AddHeader (udpHeader);
+          m_replay.SendFromHost (packet, m_gwAddresses[0], Ipv4Address (switchAddress));
+        }
+      else
+        {
+          DynamicCast<GatewayApp> (m_gatewayApps.Get (0))
+              ->SendTo (packet,
+                        InetSocketAddress (Ipv4Address (switchAddress), P4SwitchApp::SWITCH_PORT));
+        }
+    }
+  m_directoryInvalidations += switches.size ();
+  m_directoryUpdates++;
+}
+
+void
+TraceSimulation::CountCachedEntries (const NodeContainer &switches, uint32_t groupSize,
+                                     ptree &entries, ptree &uniqueEntries)
+{
+  vector<Ptr<P4SwitchApp>> apps;
+  for (auto it = switches.Begin (); it != switches.End (); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNApplications (); ++i)
+        {
+          Ptr<P4SwitchApp> app = DynamicCast<P4SwitchApp> ((*it)->GetApplication (i));
+          if (app)
+            {
+              apps.push_back (app);
+            }
+        }
+    }
+
+  for (uint32_t group = 0; groupSize > 0 && group < apps.size () / groupSize; ++group)
+    {
+      uint64_t groupEntries = 0, groupUniqueEntries = 0;
+      for (auto &mapping : m_virtualToPhysical)
+        {
+          uint32_t copies = 0;
+          for (uint32_t offset = 0; offset < groupSize; ++offset)
+            {
+              copies += apps[group * groupSize + offset]->IsCached (mapping.first);
+            }
+          groupEntries += copies;
+          groupUniqueEntries += copies > 0;
+        }
+      entries.put (std::to_string (group), groupEntries);
+      uniqueEntries.put (std::to_string (group), groupUniqueEntries);
+    }
+}
+
+void
+TraceSimulation::Admission (uint32_t switchId, bool admitted)
+{
+  if (admitted)
+    {
+      m_admissions++;
+      m_switchToAdmissions[switchId]++;
+    }
+  else
+    {
+      m_admissionRejections++;
+      m_switchToAdmissionRejections[switchId]++;
+    }
 }
 
 void
@@ -352,27 +796,94 @@ TraceSimulation::CacheHit (Ptr<const Packet> packet, uint32_t switchId)
 }
 
 void
-TraceSimulation::Migration ()
+TraceSimulation::ScheduleMigrations ()
 {
-  NS_LOG_DEBUG (Simulator::Now () << "MIGRATION. Original src leaf: " << m_migrationSrcLeaf
-                                  << ", host = " << m_migrationSrcHost);
-  // Remove address and container from source
-  Ptr<Node> node = m_nodes[m_migrationSrcLeaf].Get (m_migrationSrcHost);
-  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-  uint32_t iface = ipv4->GetNInterfaces () - 1;
-  ipv4->RemoveAddress (iface, IpUtils::GetContainerVirtualAddress (m_migrationParams.containerId));
-  // Add a dummy address
-  ipv4->AddAddress (iface, Ipv4InterfaceAddress (
-                               IpUtils::GetContainerVirtualAddress (m_containerToId.size () + 1),
-                               IpUtils::GetClassBMask ()));
+  for (vector<SocketHelper> &socketHelpers : m_socketHelpers)
+    {
+      for (SocketHelper &socketHelper : socketHelpers)
+        {
+          socketHelper.m_misdeliveryCallback = MakeCallback (&TraceSimulation::Misdelivered, this);
+        }
+    }
+
+  for (size_t event = 0; event < m_migrations.size (); ++event)
+    {
+      uint32_t containerId = m_migrations[event].containerId;
+      uint32_t vip = IpUtils::GetContainerVirtualAddress (containerId).Get ();
+      if (m_reservedContainers.count (containerId))
+        {
+          // A reserved VM has no host and no mapping until its create event
+          m_vmLocations.emplace (vip, 0);
+          m_virtualToPhysical.erase (vip);
+        }
+      else
+        {
+          m_vmLocations.emplace (vip, m_virtualToPhysical.at (vip));
+        }
+      m_vmEvents[vip].push_back (event);
+      Simulator::Schedule (MicroSeconds (m_migrations[event].ts), &TraceSimulation::Migration,
+                           this, event);
+    }
+}
 
-  // Install the app on the new location
-  node = m_nodes[m_migrationParams.dstLeaf].Get (m_migrationParams.dstHost);
-  ipv4 = node->GetObject<Ipv4> ();
-  iface = ipv4->GetNInterfaces () - 1;
-  ipv4->AddAddress (iface, Ipv4InterfaceAddress (
-                               IpUtils::GetContainerVirtualAddress (m_migrationParams.containerId),
-                               IpUtils::GetClassBMask ()));
+void
+TraceSimulation::Migration (size_t event)
+{
+  const MigrationEvent &migration = m_migrations[event];
+  Ipv4Address vip = IpUtils::GetContainerVirtualAddress (migration.containerId);
+  NS_LOG_DEBUG (Simulator::Now () << " VM event " << migration.type << " of container "
+                                  << migration.containerId << ", leaf = " << migration.dstLeaf
+                                  << ", host = " << migration.dstHost);
+  m_vmLastEvent[vip.Get ()] = event;
+  // The VM stops sending from the host it left, and goes on from its next flow where it runs now
+  size_t nextFlow = 0;
+  auto client = m_vmClients.find (vip.Get ());
+  if (client != m_vmClients.end ())
+    {
+      nextFlow = client->second->Detach ();
+      m_vmClients.erase (client);
+    }
+  else if (m_containerToFlows.count (migration.containerId))
+    {
+      // A VM that did not run skips the flows it missed
+      const vector<Flow> &flows = m_containerToFlows[migration.containerId];
+      uint64_t now = Simulator::Now ().ToInteger (Time::NS);
+      nextFlow = std::lower_bound (flows.begin (), flows.end (), now,
+                                   [] (const Flow &flow, uint64_t ts) { return flow.ts < ts; }) -
+                 flows.begin ();
+    }
+  if (migration.type == MigrationEvent::DESTROY)
+    {
+      m_vmLocations[vip.Get ()] = 0;
+    }
+  else
+    {
+      m_vmLocations[vip.Get ()] =
+          IpUtils::GetNodePhysicalAddress (migration.dstLeaf / m_podWidth,
+                                           migration.dstLeaf % m_podWidth, migration.dstHost)
+              .Get ();
+      // The old host keeps the address and hands the VM's packets back to its tunnel, see
+      // SocketHelper::SocketRecv. The sink of the new host listens on any address.
+      Ptr<Ipv4> ipv4 = m_nodes[migration.dstLeaf].Get (migration.dstHost)->GetObject<Ipv4> ();
+      if (ipv4 && ipv4->GetInterfaceForAddress (vip) == -1)
+        {
+          ipv4->AddAddress (ipv4->GetNInterfaces () - 1,
+                            Ipv4InterfaceAddress (vip, IpUtils::GetClassBMask ()));
+        }
+      if (ipv4 &&
+          m_vmSinkHosts.insert (std::make_pair (migration.dstLeaf, migration.dstHost)).second)
+        {
+          InstallVmSink (migration.dstLeaf, migration.dstHost);
+        }
+      if (ipv4 && m_containerToFlows.count (migration.containerId))
+        {
+          ApplicationContainer clientApps =
+              InstallClient (migration.containerId, migration.dstLeaf, migration.dstHost);
+          DynamicCast<ClientApp> (clientApps.Get (0))->SetNextFlow (nextFlow);
+          clientApps.Start (Seconds (0));
+          clientApps.Stop (m_stopTime - Simulator::Now ());
+        }
+    }
 
   // Update mapping
   Time delay = MicroSeconds (0);
@@ -380,17 +891,68 @@ TraceSimulation::Migration ()
     {
       delay = MicroSeconds (1000);
     }
-  Simulator::Schedule (delay, &TraceSimulation::UpdateMappings, this);
+  Simulator::Schedule (delay, &TraceSimulation::UpdateMappings, this, event);
+}
+
+ApplicationContainer
+TraceSimulation::InstallClient (uint32_t containerId, uint32_t leaf, uint32_t host)
+{
+  Ipv4Address vip = IpUtils::GetContainerVirtualAddress (containerId);
+  ClientAppHelper helper (
+      m_containerToFlows[containerId], vip,
+      IpUtils::GetNodePhysicalAddress (leaf / m_podWidth, leaf % m_podWidth, host),
+      m_migrationParams.migration || m_simParameters.UdpMode);
+  ApplicationContainer clientApps = helper.Install (m_nodes[leaf].Get (host));
+  clientApps.Get (0)->TraceConnectWithoutContext ("Tx",
+                                                  MakeCallback (&TraceSimulation::ClientTx, this));
+  clientApps.Get (0)->TraceConnectWithoutContext (
+      "CongState", MakeCallback (&TraceSimulation::RecordCongState, this));
+  clientApps.Get (0)->TraceConnectWithoutContext ("RxWithDelay",
+                                                  MakeCallback (&TraceSimulation::SinkRx, this));
+  if (m_migrationParams.migration)
+    {
+      m_vmClients[vip.Get ()] = DynamicCast<ClientApp> (clientApps.Get (0));
+    }
+  return clientApps;
 }
 
 void
-TraceSimulation::UpdateMappings ()
+TraceSimulation::InstallVmSink (uint32_t leaf, uint32_t host)
 {
-  m_virtualToPhysical[IpUtils::GetContainerVirtualAddress (m_migrationParams.containerId).Get ()] =
-      IpUtils::GetNodePhysicalAddress (m_migrationParams.dstLeaf / m_podWidth,
-                                       m_migrationParams.dstLeaf % m_podWidth,
-                                       m_migrationParams.dstHost)
-          .Get ();
+  PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory",
+                               InetSocketAddress (Ipv4Address::GetAny (), ClientApp::CLIENT_PORT));
+  ApplicationContainer serverApps = sinkHelper.Install (m_nodes[leaf].Get (host));
+  serverApps.Get (0)->TraceConnectWithoutContext ("RxWithDelay",
+                                                  MakeCallback (&TraceSimulation::SinkRx, this));
+  // Installed during the run, so the times count from now
+  serverApps.Start (Seconds (0));
+  serverApps.Stop (m_stopTime - Simulator::Now ());
+}
+
+void
+TraceSimulation::UpdateMappings (size_t event)
+{
+  const MigrationEvent &migration = m_migrations[event];
+  uint32_t vip = IpUtils::GetContainerVirtualAddress (migration.containerId).Get ();
+  auto mapping = m_virtualToPhysical.find (vip);
+  uint32_t oldPhysical = mapping == m_virtualToPhysical.end () ? 0 : mapping->second;
+  if (migration.type == MigrationEvent::DESTROY)
+    {
+      m_virtualToPhysical.erase (vip);
+    }
+  else
+    {
+      m_virtualToPhysical[vip] =
+          IpUtils::GetNodePhysicalAddress (migration.dstLeaf / m_podWidth,
+                                           migration.dstLeaf % m_podWidth, migration.dstHost)
+              .Get ();
+    }
+  m_mappingEpochs[vip] = (m_mappingEpochs[vip] + 1) % EpochTag::EPOCHS;
+  m_lastMappingUpdate = Simulator::Now ();
+  if (m_migrationParams.cacheDirectory && oldPhysical != 0)
+    {
+      InvalidateDirectory (vip, oldPhysical);
+    }
 }
 
 void
@@ -400,26 +962,19 @@ TraceSimulation::SetupApplications ()
     {
       for (size_t node = 0; node < m_containerGroups[leaf].size (); ++node)
         {
-          if (m_migrationParams.migration && node == m_migrationParams.dstHost &&
-              leaf == m_migrationParams.dstLeaf)
-            {
-              PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory",
-                                           InetSocketAddress (IpUtils::GetContainerVirtualAddress (
-                                                                  m_migrationParams.containerId),
-                                                              ClientApp::CLIENT_PORT));
-              ApplicationContainer serverApps = sinkHelper.Install (
-                  m_nodes[m_migrationParams.dstLeaf].Get (m_migrationParams.dstHost));
-              serverApps.Get (0)->TraceConnectWithoutContext (
-                  "RxWithDelay", MakeCallback (&TraceSimulation::SinkRx, this));
-              serverApps.Start (MicroSeconds (m_migrationParams.ts));
-              serverApps.Stop (m_stopTime);
-            }
-
           for (size_t container = 0; container < m_containerGroups[leaf][node].size (); ++container)
             {
               if (m_containerGroups[leaf][node][container].find ("Gateway") != string::npos)
                 continue;
               uint32_t containerId = m_containerToId[m_containerGroups[leaf][node][container]];
+              if (m_reservedContainers.count (containerId))
+                {
+                  // The placement only reserves the VIP, its create event starts the VM
+                  Ipv4Address vip = IpUtils::GetContainerVirtualAddress (containerId);
+                  Ptr<Ipv4> ipv4 = m_nodes[leaf].Get (node)->GetObject<Ipv4> ();
+                  ipv4->RemoveAddress (ipv4->GetInterfaceForAddress (vip), vip);
+                  continue;
+                }
               if (m_destinations.count (containerId))
                 {
                   PacketSinkHelper sinkHelper (
@@ -440,35 +995,12 @@ TraceSimulation::SetupApplications ()
                                                    leaf / m_podWidth, leaf % m_podWidth, node)
                                                    .Get ()));
                   serverApps.Start (m_startTime);
-
-                  if (m_migrationParams.migration && containerId == m_migrationParams.containerId)
-                    {
-                      NS_LOG_DEBUG ("Container ID = " << containerId << ". Leaf = " << leaf);
-
-                      m_migrationSrcLeaf = leaf;
-                      m_migrationSrcHost = node;
-                      serverApps.Stop (MicroSeconds (m_migrationParams.ts));
-                    }
-                  else
-                    {
-                      serverApps.Stop (m_stopTime);
-                    }
+                  serverApps.Stop (m_stopTime);
                 }
 
               if (m_containerToFlows.count (containerId))
                 {
-                  ClientAppHelper helper (
-                      m_containerToFlows[containerId],
-                      IpUtils::GetContainerVirtualAddress (containerId),
-                      IpUtils::GetNodePhysicalAddress (leaf / m_podWidth, leaf % m_podWidth, node),
-                      m_migrationParams.migration || m_simParameters.UdpMode);
-                  ApplicationContainer clientApps = helper.Install (m_nodes[leaf].Get (node));
-                  clientApps.Get (0)->TraceConnectWithoutContext (
-                      "Tx", MakeCallback (&TraceSimulation::ClientTx, this));
-                  clientApps.Get (0)->TraceConnectWithoutContext (
-                      "CongState", MakeCallback (&TraceSimulation::RecordCongState, this));
-                  clientApps.Get (0)->TraceConnectWithoutContext (
-                      "RxWithDelay", MakeCallback (&TraceSimulation::SinkRx, this));
+                  ApplicationContainer clientApps = InstallClient (containerId, leaf, node);
                   clientApps.Start (m_startTime);
                   clientApps.Stop (m_stopTime);
                 }
@@ -483,55 +1015,7 @@ TraceSimulation::SetupApplications ()
   if (m_simParameters.SimMode == SimulationParameters::Mode::SwitchV2P ||
       m_simParameters.SimMode == SimulationParameters::Mode::LocalLearning)
     {
-      m_switchApps = ApplicationContainer ();
-      set<uint32_t> gatewayPods;
-      std::transform (
-          m_gws.begin (), m_gws.end (), inserter (gatewayPods, gatewayPods.end ()),
-          [this] (const pair<uint32_t, uint32_t> &gwPair) { return gwPair.first / m_podWidth; });
-      for (uint32_t leaf = 0; leaf < m_leafCount; ++leaf)
-        {
-          enum P4SwitchApp::SwitchType switchType = gatewayLeaves.count (leaf)
-                                                        ? P4SwitchApp::SwitchType::GW_LEAF
-                                                        : P4SwitchApp::SwitchType::LEAF;
-
-          P4SwitchAppHelper switchHelper (
-              m_gwAddresses,
-              IpUtils::GetLeafAddress (m_podCount, leaf / m_podWidth, 0, leaf % m_podWidth),
-              switchType, m_simParameters.SimMode, m_podCount, m_virtualToPhysical);
-
-          m_switchApps.Add (switchHelper.Install (m_leaves.Get (leaf)));
-        }
-
-      for (uint32_t spine = 0; spine < m_spineCount; ++spine)
-        {
-          enum P4SwitchApp::SwitchType switchType = gatewayPods.count (spine / m_podWidth)
-                                                        ? P4SwitchApp::SwitchType::GW_SPINE
-                                                        : P4SwitchApp::SwitchType::SPINE;
-
-          P4SwitchAppHelper switchHelper (
-              m_gwAddresses,
-              IpUtils::GetSpineFromLeafAddress (m_podCount, spine / m_podWidth, spine % m_podWidth,
-                                                0),
-              switchType, m_simParameters.SimMode, m_podCount, m_virtualToPhysical);
-          m_switchApps.Add (switchHelper.Install (m_spines.Get (spine)));
-        }
-
-      for (uint32_t core = 0; core < m_coreCount; ++core)
-        {
-          P4SwitchAppHelper switchHelper (m_gwAddresses, IpUtils::GetCoreAddress (0, core),
-                                          P4SwitchApp::SwitchType::CORE, m_simParameters.SimMode,
-                                          m_podCount, m_virtualToPhysical);
-          m_switchApps.Add (switchHelper.Install (m_cores.Get (core)));
-        }
-
-      for (uint32_t i = 0; i < m_switchApps.GetN (); ++i)
-        {
-          m_switchApps.Get (i)->TraceConnectWithoutContext (
-              "GeneratedLearning", MakeCallback (&TraceSimulation::GeneratedLearning, this));
-          m_switchApps.Get (i)->TraceConnectWithoutContext (
-              "GeneratedInvalidation",
-              MakeCallback (&TraceSimulation::GeneratedInvalidation, this));
-        }
+      InstallP4Switches (m_simParameters.SimMode);
     }
   else if (m_simParameters.SimMode == SimulationParameters::Mode::GwCache)
     {
@@ -543,7 +1027,7 @@ TraceSimulation::SetupApplications ()
               m_gwAddresses,
               IpUtils::GetLeafAddress (m_podCount, leaf / m_podWidth, 0, leaf % m_podWidth),
               P4SwitchApp::SwitchType::GW_LEAF, SimulationParameters::Mode::LocalLearning,
-              m_podCount, m_virtualToPhysical);
+              m_podCount, m_coreCount, m_virtualToPhysical, GetHostLocators ());
           m_switchApps.Add (switchHelper.Install (m_leaves.Get (leaf)));
         }
 
@@ -569,8 +1053,8 @@ TraceSimulation::SetupApplications ()
           P4SwitchAppHelper switchHelper (
               m_gwAddresses,
               IpUtils::GetLeafAddress (m_podCount, leaf / m_podWidth, 0, leaf % m_podWidth),
-              P4SwitchApp::SwitchType::LEAF, m_simParameters.SimMode, m_podCount,
-              m_virtualToPhysical);
+              P4SwitchApp::SwitchType::LEAF, m_simParameters.SimMode, m_podCount, m_coreCount,
+              m_virtualToPhysical, GetHostLocators ());
 
           m_switchApps.Add (switchHelper.Install (m_leaves.Get (leaf)));
         }
@@ -585,30 +1069,25 @@ TraceSimulation::SetupApplications ()
       m_switchApps = switchHelper.Install (NodeContainer (m_leaves, m_spines, m_cores));
     }
 
-  for (uint32_t i = 0; i < m_switchApps.GetN (); ++i)
-    {
-      m_switchApps.Get (i)->TraceConnectWithoutContext (
-          "ProcessedPackets", MakeCallback (&TraceSimulation::ProcessedPacket, this));
-      m_switchApps.Get (i)->TraceConnectWithoutContext (
-          "CacheHit", MakeCallback (&TraceSimulation::CacheHit, this));
-    }
+  ConnectSwitchTraces ();
   m_switchApps.Start (m_startTime);
   m_switchApps.Stop (m_stopTime);
 
-  GatewayAppHelper gwHelper (m_virtualToPhysical);
+  GatewayAppHelper gwHelper (m_virtualToPhysical,
+                             m_migrationParams.cacheDirectory ? &m_directory : nullptr);
   NodeContainer gws;
   for (size_t i = 0; i < m_gws.size (); ++i)
     {
       gws.Add (m_nodes[m_gws[i].first].Get (m_gws[i].second));
     }
-  ApplicationContainer gwApps = gwHelper.Install (gws);
+  m_gatewayApps = gwHelper.Install (gws);
   for (size_t i = 0; i < m_gws.size (); ++i)
     {
-      gwApps.Get (i)->TraceConnectWithoutContext ("Rx",
-                                                  MakeCallback (&TraceSimulation::GatewayRx, this));
+      m_gatewayApps.Get (i)->TraceConnectWithoutContext (
+          "Rx", MakeCallback (&TraceSimulation::GatewayRx, this));
     }
-  gwApps.Start (m_startTime);
-  gwApps.Stop (m_stopTime);
+  m_gatewayApps.Start (m_startTime);
+  m_gatewayApps.Stop (m_stopTime);
 
   if (m_simParameters.SimMode == SimulationParameters::Mode::Controller)
     {
@@ -620,10 +1099,7 @@ TraceSimulation::SetupApplications ()
       controllerApps.Stop (m_stopTime);
     }
 
-  if (m_migrationParams.migration)
-    {
-      Simulator::Schedule (MicroSeconds (m_migrationParams.ts), &TraceSimulation::Migration, this);
-    }
+  ScheduleMigrations ();
 
   Config::ConnectWithoutContext ("/NodeList/*/$ns3::TrafficControlLayer/RootQueueDiscList/*/Drop",
                                  MakeCallback (&TraceSimulation::RecordDropQueueDisc, this));
@@ -643,3 +1119,269 @@ TraceSimulation::SetupApplications ()
   Config::ConnectWithoutContext ("/NodeList/*/$ns3::Ipv4L3Protocol/Drop",
                                  MakeCallback (&TraceSimulation::RecordDropIp, this));
 }
+
+void
+TraceSimulation::InstallP4Switches (enum SimulationParameters::Mode simMode)
+{
+  set<uint32_t> gatewayLeaves;
+  std::transform (m_gws.begin (), m_gws.end (), inserter (gatewayLeaves, gatewayLeaves.end ()),
+                  [] (const pair<uint32_t, uint32_t> &gwPair) { return gwPair.first; });
+  set<uint32_t> gatewayPods;
+  std::transform (
+      m_gws.begin (), m_gws.end (), inserter (gatewayPods, gatewayPods.end ()),
+      [this] (const pair<uint32_t, uint32_t> &gwPair) { return gwPair.first / m_podWidth; });
+
+  m_switchApps = ApplicationContainer ();
+  for (uint32_t leaf = 0; leaf < m_leafCount; ++leaf)
+    {
+      enum P4SwitchApp::SwitchType switchType = gatewayLeaves.count (leaf)
+                                                    ? P4SwitchApp::SwitchType::GW_LEAF
+                                                    : P4SwitchApp::SwitchType::LEAF;
+
+      P4SwitchAppHelper switchHelper (
+          m_gwAddresses,
+          IpUtils::GetLeafAddress (m_podCount, leaf / m_podWidth, 0, leaf % m_podWidth),
+          switchType, simMode, m_podCount, m_coreCount, m_virtualToPhysical, GetHostLocators ());
+
+      m_switchApps.Add (switchHelper.Install (m_leaves.Get (leaf)));
+    }
+
+  for (uint32_t spine = 0; spine < m_spineCount; ++spine)
+    {
+      enum P4SwitchApp::SwitchType switchType = gatewayPods.count (spine / m_podWidth)
+                                                    ? P4SwitchApp::SwitchType::GW_SPINE
+                                                    : P4SwitchApp::SwitchType::SPINE;
+
+      P4SwitchAppHelper switchHelper (
+          m_gwAddresses,
+          IpUtils::GetSpineFromLeafAddress (m_podCount, spine / m_podWidth, spine % m_podWidth,
+                                            0),
+          switchType, simMode, m_podCount, m_coreCount, m_virtualToPhysical, GetHostLocators ());
+      m_switchApps.Add (switchHelper.Install (m_spines.Get (spine)));
+    }
+
+  for (uint32_t core = 0; core < m_coreCount; ++core)
+    {
+      P4SwitchAppHelper switchHelper (m_gwAddresses, IpUtils::GetCoreAddress (0, core),
+                                      P4SwitchApp::SwitchType::CORE, simMode, m_podCount,
+                                      m_coreCount, m_virtualToPhysical, GetHostLocators ());
+      m_switchApps.Add (switchHelper.Install (m_cores.Get (core)));
+    }
+
+  for (uint32_t i = 0; i < m_switchApps.GetN (); ++i)
+    {
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "GeneratedLearning", MakeCallback (&TraceSimulation::GeneratedLearning, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "GeneratedInvalidation",
+          MakeCallback (&TraceSimulation::GeneratedInvalidation, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "ControlPacket", MakeCallback (&TraceSimulation::ControlPacket, this));
+    }
+}
+
+void
+TraceSimulation::ConnectSwitchTraces ()
+{
+  for (uint32_t i = 0; i < m_switchApps.GetN (); ++i)
+    {
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "ProcessedPackets", MakeCallback (&TraceSimulation::ProcessedPacket, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "CacheHit", MakeCallback (&TraceSimulation::CacheHit, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "Admission", MakeCallback (&TraceSimulation::Admission, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "GenerateProbability", MakeCallback (&TraceSimulation::GenerateProbability, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "Steered", MakeCallback (&TraceSimulation::SteeredPacket, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "VictimForwarded", MakeCallback (&TraceSimulation::VictimForwarded, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "VictimInstalled", MakeCallback (&TraceSimulation::VictimInstalled, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "VictimHit", MakeCallback (&TraceSimulation::VictimHit, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "StaleEntry", MakeCallback (&TraceSimulation::StaleEntry, this));
+      m_switchApps.Get (i)->TraceConnectWithoutContext (
+          "StaleHit", MakeCallback (&TraceSimulation::StaleHit, this));
+      if (m_migrationParams.cacheDirectory)
+        {
+          m_switchApps.Get (i)->TraceConnectWithoutContext (
+              "SourceLearned", MakeCallback (&TraceSimulation::SourceLearned, this));
+        }
+    }
+}
+
+void
+TraceSimulation::SetupCacheReplay ()
+{
+  // The switches run the SwitchV2P pipeline, the hosts only their tunnel endpoints
+  InstallP4Switches (SimulationParameters::Mode::SwitchV2P);
+  ConnectSwitchTraces ();
+  for (uint32_t i = 0; i < m_switchApps.GetN (); ++i)
+    {
+      Ptr<P4SwitchApp> app = DynamicCast<P4SwitchApp> (m_switchApps.Get (i));
+      if (i < m_leafCount)
+        {
+          m_replay.AddSwitch (app, CacheReplay::LEAF, i);
+        }
+      else if (i < m_leafCount + m_spineCount)
+        {
+          m_replay.AddSwitch (app, CacheReplay::SPINE, i - m_leafCount);
+        }
+      else
+        {
+          m_replay.AddSwitch (app, CacheReplay::CORE, i - m_leafCount - m_spineCount);
+        }
+      app->SetSendCallback (MakeCallback (&CacheReplay::SendFromSwitch, &m_replay));
+    }
+  m_switchApps.Start (m_startTime);
+  m_switchApps.Stop (m_stopTime);
+
+  m_replay.SetHostRxCallback (MakeCallback (&TraceSimulation::ReplayHostRx, this));
+  for (vector<SocketHelper> &socketHelpers : m_socketHelpers)
+    {
+      for (SocketHelper &socketHelper : socketHelpers)
+        {
+          socketHelper.m_sendCallback = MakeCallback (&CacheReplay::SendFromHost, &m_replay);
+        }
+    }
+
+  // Scheduled first, so a VM event runs before the packets of the same time, as it does for the
+  // clients of a packet-level run
+  ScheduleMigrations ();
+
+  UintegerValue packetSize;
+  CreateObject<ClientApp> ()->GetAttribute ("PacketSize", packetSize);
+  m_packetSize = packetSize.Get ();
+  for (auto &[containerId, flows] : m_containerToFlows)
+    {
+      for (const Flow &flow : flows)
+        {
+          Simulator::Schedule (NanoSeconds (flow.ts), &TraceSimulation::ReplayFlow, this,
+                               containerId, flow);
+        }
+    }
+}
+
+void
+TraceSimulation::ReplayFlow (uint32_t containerId, Flow flow)
+{
+  if (m_migrationParams.migration || m_simParameters.UdpMode)
+    {
+      ReplayPacket (containerId, flow.dst, flow.flowId,
+                    m_packetSize + UdpHeader ().GetSerializedSize (), UdpL4Protocol::PROT_NUMBER);
+      return;
+    }
+
+  // A TCP flow is its handshake, the segments and a delayed ACK for every second segment
+  uint32_t headerSize = TcpHeader ().GetSerializedSize ();
+  uint32_t segments = std::max<uint32_t> ((flow.size + SEGMENT_SIZE - 1) / SEGMENT_SIZE, 1);
+  ReplayPacket (containerId, flow.dst, flow.flowId, headerSize, TcpL4Protocol::PROT_NUMBER);
+  ReplayPacket (flow.dst, containerId, flow.flowId, headerSize, TcpL4Protocol::PROT_NUMBER);
+  for (uint32_t i = 0; i < segments; ++i)
+    {
+      uint32_t bytes = std::min (flow.size - i * SEGMENT_SIZE, SEGMENT_SIZE);
+      ReplayPacket (containerId, flow.dst, flow.flowId, bytes + headerSize,
+                    TcpL4Protocol::PROT_NUMBER);
+      if (i % 2 == 1 || i + 1 == segments)
+        {
+          ReplayPacket (flow.dst, containerId, flow.flowId, headerSize,
+                        TcpL4Protocol::PROT_NUMBER);
+        }
+    }
+}
+
+void
+TraceSimulation::ReplayPacket (uint32_t srcContainerId, uint32_t dstContainerId, uint32_t flowId,
+                               uint32_t size, uint8_t protocol)
+{
+  Ipv4Address source = IpUtils::GetContainerVirtualAddress (srcContainerId);
+  auto location = m_vmLocations.find (source.Get ());
+  Ipv4Address physicalAddress (location != m_vmLocations.end ()
+                                   ? location->second
+                                   : m_virtualToPhysical.at (source.Get ()));
+  if (physicalAddress.Get () == 0)
+    {
+      // A destroyed VM sends nothing
+      return;
+    }
+  Ptr<Packet> packet = Create<Packet> (size);
+  DelayJitterEstimation::PrepareTx (packet);
+  packet->AddPacketTag (FlowIdTag (flowId));
+  SourceTag sourceTag;
+  sourceTag.SetSource (physicalAddress);
+  packet->AddPacketTag (sourceTag);
+  packet->AddPacketTag (HopsTag ());
+  ClientTx (packet, flowId);
+
+  Ipv4Header header;
+  header.SetSource (source);
+  header.SetDestination (IpUtils::GetContainerVirtualAddress (dstContainerId));
+  header.SetProtocol (protocol);
+  header.SetTtl (64);
+  header.SetPayloadSize (size);
+  packet->AddHeader (header);
+  m_socketHelpers[m_replay.GetLeaf (physicalAddress)][m_replay.GetHost (physicalAddress)]
+      .VirtualSend (packet, source, header.GetDestination (), Ipv4L3Protocol::PROT_NUMBER);
+}
+
+void
+TraceSimulation::ReplayHostRx (Ptr<Packet> packet, Ipv4Header header, uint32_t leaf,
+                               uint32_t host)
+{
+  UdpHeader udpHeader;
+  packet->RemoveHeader (udpHeader);
+  Ipv4Header innerHeader;
+  packet->RemoveHeader (innerHeader);
+  uint32_t vip = innerHeader.GetDestination ().Get ();
+  auto mapping = m_virtualToPhysical.find (vip);
+
+  if (std::find (m_gws.begin (), m_gws.end (), std::make_pair (leaf, host)) != m_gws.end ())
+    {
+      if (mapping == m_virtualToPhysical.end ())
+        {
+          // The VM was destroyed
+          return;
+        }
+      uint32_t physicalAddress = mapping->second;
+      // GatewayApp::ReceivePacket, without the processing delay
+      if (m_migrationParams.cacheDirectory)
+        {
+          m_directory.RecordResolution (vip, header.GetDestination (), header.GetSource (),
+                                        Ipv4Address (physicalAddress), packet);
+        }
+      header.SetDestination (Ipv4Address (physicalAddress));
+      packet->AddHeader (innerHeader);
+      packet->AddHeader (udpHeader);
+      EvictionTag evictionTag;
+      packet->RemovePacketTag (evictionTag);
+      InvalidationTag invalidationTag;
+      packet->RemovePacketTag (invalidationTag);
+      GatewayRx (packet, innerHeader.GetDestination ());
+      m_replay.SendWithHeader (packet, header);
+      return;
+    }
+
+  // The host delivers to the VMs it runs
+  auto location = m_vmLocations.find (vip);
+  if ((location != m_vmLocations.end () ? location->second : mapping->second) ==
+      header.GetDestination ().Get ())
+    {
+      FlowIdTag flowIdTag;
+      packet->PeekPacketTag (flowIdTag);
+      DelayJitterEstimationTimestampTag tag;
+      packet->PeekPacketTag (tag);
+      SinkRx (packet, InetSocketAddress (innerHeader.GetSource ()), tag.GetTxTime (),
+              Simulator::Now (), flowIdTag.GetFlowId ());
+      return;
+    }
+
+  // The container moved away, the host forwards the packet back into its tunnel
+  innerHeader.SetTtl (innerHeader.GetTtl () - 1);
+  packet->AddHeader (innerHeader);
+  m_socketHelpers[leaf][host].VirtualSend (packet, innerHeader.GetSource (),
+                                           innerHeader.GetDestination (),
+                                           Ipv4L3Protocol::PROT_NUMBER);
+}